@@ -33,6 +33,11 @@
 #          header files
 #   ARGN = proto files
 #
+# PROTOBUF_GENERATE_CPP_DCCL_CODECS (public function)
+#   As PROTOBUF_GENERATE_CPP, but protoc-gen-dccl also writes a
+#   dccl::GeneratedMessageCodec for each message into the .pb.cc
+#   (--dccl_out=codecs:...). Requires enable_units (which builds protoc-gen-dccl).
+#
 #  ====================================================================
 
 
@@ -54,21 +59,32 @@
 
 function(PROTOBUF_GENERATE_CPP SRCS HDRS)
   if(enable_units)
-    protobuf_generate_cpp_internal("True" PROTO_SRCS PROTO_HDRS ${ARGN})
+    protobuf_generate_cpp_internal("True" "" PROTO_SRCS PROTO_HDRS ${ARGN})
   else()
-    protobuf_generate_cpp_internal("False" PROTO_SRCS PROTO_HDRS ${ARGN})
+    protobuf_generate_cpp_internal("False" "" PROTO_SRCS PROTO_HDRS ${ARGN})
   endif()
   set(${SRCS} ${PROTO_SRCS} PARENT_SCOPE)
   set(${HDRS} ${PROTO_HDRS} PARENT_SCOPE)
 endfunction()
 
 function(PROTOBUF_GENERATE_CPP_NO_DCCL SRCS HDRS)
-  protobuf_generate_cpp_internal("False" PROTO_SRCS PROTO_HDRS ${ARGN})
+  protobuf_generate_cpp_internal("False" "" PROTO_SRCS PROTO_HDRS ${ARGN})
+  set(${SRCS} ${PROTO_SRCS} PARENT_SCOPE)
+  set(${HDRS} ${PROTO_HDRS} PARENT_SCOPE)
+endfunction()
+
+function(PROTOBUF_GENERATE_CPP_DCCL_CODECS SRCS HDRS)
+  if(NOT enable_units)
+    message(SEND_ERROR "Error: PROTOBUF_GENERATE_CPP_DCCL_CODECS() requires protoc-gen-dccl (enable_units)")
+    return()
+  endif()
+  protobuf_generate_cpp_internal("True" "codecs:" PROTO_SRCS PROTO_HDRS ${ARGN})
   set(${SRCS} ${PROTO_SRCS} PARENT_SCOPE)
   set(${HDRS} ${PROTO_HDRS} PARENT_SCOPE)
 endfunction()
 
-function(PROTOBUF_GENERATE_CPP_INTERNAL USE_DCCL SRCS HDRS)
+# DCCL_PARAMETERS = prefix for --dccl_out (e.g. "codecs:"), or ""
+function(PROTOBUF_GENERATE_CPP_INTERNAL USE_DCCL DCCL_PARAMETERS SRCS HDRS)
   if(NOT ARGN)
     message(SEND_ERROR "Error: PROTOBUF_GENERATE_CPP() called without any proto files")
     return()
@@ -99,7 +115,9 @@ function(PROTOBUF_GENERATE_CPP_INTERNAL USE_DCCL SRCS HDRS)
     list(APPEND ${HDRS} "${FIL_PATH}/${FIL_WE}.pb.h")
 
     if(USE_DCCL)
-      set(DCCL_PROTOC_ARGS --dccl_out ${dccl_INC_DIR} --plugin ${dccl_EXEC_DIR}/protoc-gen-dccl)
+      set(DCCL_PROTOC_ARGS --dccl_out ${DCCL_PARAMETERS}${dccl_INC_DIR} --plugin ${dccl_EXEC_DIR}/protoc-gen-dccl)
+      # regenerate when the plugin changes
+      set(DCCL_PROTOC_DEPENDS protoc-gen-dccl)
     endif()
 
     add_custom_command(
@@ -107,7 +125,7 @@ function(PROTOBUF_GENERATE_CPP_INTERNAL USE_DCCL SRCS HDRS)
              "${FIL_PATH}/${FIL_WE}.pb.h"
       COMMAND  ${PROTOBUF_PROTOC_EXECUTABLE}
       ARGS --cpp_out ${dccl_INC_DIR} --proto_path ${dccl_INC_DIR} ${dccl_INC_DIR}/dccl/${REL_FIL} -I ${PROTOBUF_INCLUDE_DIRS} -I ${dccl_INC_DIR} ${DCCL_PROTOC_ARGS}
-      DEPENDS ${ABS_FIL}
+      DEPENDS ${ABS_FIL} ${DCCL_PROTOC_DEPENDS}
       COMMENT "Running C++ protocol buffer compiler on ${FIL}"
       VERBATIM )
   endforeach()
@@ -28,6 +28,7 @@
 
 #include <sstream>
 #include <fstream>
+#include <chrono>
 
 
 #include <google/protobuf/descriptor.h>
@@ -37,6 +38,8 @@
 #include <boost/algorithm/string.hpp>
 
 #include "dccl/codec.h"
+#include "dccl/stream_decoder.h"
+#include "dccl/log_file.h"
 #include "dccl/cli_option.h"
 #include "dccl/binary.h"
 
@@ -46,6 +49,8 @@
 // for realpath
 #include <limits.h>
 #include <stdlib.h>
+// for STDIN_FILENO
+#include <unistd.h>
 
 
 enum Action { NO_ACTION, ENCODE, DECODE, ANALYZE, DISP_PROTO };
@@ -75,6 +80,7 @@ namespace dccl
             std::string id_codec;
             bool verbose;
             bool omit_prefix;
+            std::string log;
         };
     }
 }
@@ -83,6 +89,8 @@ namespace dccl
 void analyze(dccl::Codec& dccl, const dccl::tool::Config& cfg);
 void encode(dccl::Codec& dccl, dccl::tool::Config& cfg);
 void decode(dccl::Codec& dccl, const dccl::tool::Config& cfg);
+void print_decoded(dccl::StreamDecoder* decoder, const dccl::tool::Config& cfg);
+void print_decoded(const google::protobuf::Message& msg, const dccl::tool::Config& cfg);
 void disp_proto(dccl::Codec& dccl, const dccl::tool::Config& cfg);
 
         
@@ -193,6 +201,10 @@ void encode(dccl::Codec& dccl, dccl::tool::Config& cfg)
     }
     
     std::string command_line_name = *cfg.message.begin();
+
+    boost::shared_ptr<dccl::LogWriter> log;
+    if(!cfg.log.empty())
+        log.reset(new dccl::LogWriter(cfg.log));
     
     while(!std::cin.eof())
     {
@@ -250,7 +262,13 @@ void encode(dccl::Codec& dccl, dccl::tool::Config& cfg)
         boost::shared_ptr<google::protobuf::Message> msg = dccl::DynamicProtobufManager::new_protobuf_message(desc);
         google::protobuf::TextFormat::ParseFromString(input, msg.get());
 
-        if(msg->IsInitialized())
+        if(msg->IsInitialized() && log)
+        {
+            // timestamped with the time each message is encoded
+            dccl::int64 now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            log->write(&dccl, *msg, now);
+        }
+        else if(msg->IsInitialized())
         {
             std::string encoded;
             dccl.encode(&encoded, *msg);
@@ -299,16 +317,33 @@ void encode(dccl::Codec& dccl, dccl::tool::Config& cfg)
 
 void decode(dccl::Codec& dccl, const dccl::tool::Config& cfg)
 {
-    std::string input;
-    if(cfg.format == BINARY)
+    if(!cfg.log.empty())
+    {
+        dccl::LogReader log(cfg.log);
+        for(std::size_t i = 0, n = log.size(); i < n; ++i)
+        {
+            // decoded in place, from the mapped file
+            const char* begin = log.data(i);
+            const char* end = begin + log.entry(i).size;
+            unsigned id = dccl.id(begin, end);
+            std::map<dccl::int32, const google::protobuf::Descriptor*>::const_iterator it = dccl.loaded().find(id);
+            if(it == dccl.loaded().end())
+                throw(dccl::Exception("Message id " + boost::lexical_cast<std::string>(id) + " has not been loaded."));
+
+            boost::shared_ptr<google::protobuf::Message> msg = dccl::DynamicProtobufManager::new_protobuf_message(it->second);
+            dccl.decode(begin, end, msg.get());
+            print_decoded(*msg, cfg);
+        }
+    }
+    else if(cfg.format == BINARY)
     {
-        std::ifstream fin("/dev/stdin", std::ios::binary);
-        std::ostringstream ostrm;
-        ostrm << fin.rdbuf();
-        input = ostrm.str();
+        // decoded as it is read
+        dccl::StreamDecoder decoder(&dccl, STDIN_FILENO);
+        print_decoded(&decoder, cfg);
     }
     else
     {
+        std::string input;
         while(!std::cin.eof())
         {
             std::string line;
@@ -350,15 +385,43 @@ void decode(dccl::Codec& dccl, const dccl::tool::Config& cfg)
 #endif
             }
         }
+
+        dccl::StreamDecoder decoder(&dccl, input.data(), input.data() + input.size());
+        print_decoded(&decoder, cfg);
     }
+}
 
-    while(!input.empty())
+void print_decoded(dccl::StreamDecoder* decoder, const dccl::tool::Config& cfg)
+{
+    // bytes skipped since a message was last decoded
+    std::size_t skipped = 0;
+    while(!decoder->at_end())
     {
-        boost::shared_ptr<google::protobuf::Message> msg = dccl.decode<boost::shared_ptr<google::protobuf::Message> >(&input);
-        if(!cfg.omit_prefix)
-            std::cout << "|" << msg->GetDescriptor()->full_name() << "| ";
-        std::cout << msg->ShortDebugString() << std::endl;
+        try
+        {
+            boost::shared_ptr<google::protobuf::Message> msg = decoder->next<boost::shared_ptr<google::protobuf::Message> >();
+            if(skipped)
+                std::cerr << "Skipped " << skipped << " byte(s) before the next message" << std::endl;
+            skipped = 0;
+            print_decoded(*msg, cfg);
+        }
+        catch(dccl::Exception& e)
+        {
+            // look for the next message one byte further on
+            if(!skipped)
+                std::cerr << "Failed to decode message at byte " << decoder->position() << ": " << e.what() << std::endl;
+            skipped += decoder->skip(1);
+        }
     }
+    if(skipped)
+        std::cerr << "Skipped " << skipped << " byte(s) at the end" << std::endl;
+}
+
+void print_decoded(const google::protobuf::Message& msg, const dccl::tool::Config& cfg)
+{
+    if(!cfg.omit_prefix)
+        std::cout << "|" << msg.GetDescriptor()->full_name() << "| ";
+    std::cout << msg.ShortDebugString() << std::endl;
 }
 
 void disp_proto(dccl::Codec& dccl, const dccl::tool::Config& cfg)
@@ -406,6 +469,7 @@ void parse_options(int argc, char* argv[], dccl::tool::Config* cfg)
     options.push_back(dccl::Option('m', "message", required_argument, "Message name to encode, decode or analyze."));
     options.push_back(dccl::Option('f', "proto_file", required_argument, ".proto file to load."));
     options.push_back(dccl::Option(0, "format", required_argument, "Format for encode output or decode input: 'bin' (default) is raw binary, 'hex' is ascii-encoded hexadecimal, 'textformat' is a Google Protobuf TextFormat byte string, 'base64' is ascii-encoded base 64."));
+    options.push_back(dccl::Option(0, "log", required_argument, "Log file to write (for encode) or read (for decode) instead of STDOUT/STDIN. Messages are stored with the time they were encoded and an index, and can be read with dccl::LogReader. Overrides --format."));
     options.push_back(dccl::Option('v', "verbose", no_argument, "Display extra debugging information."));
     options.push_back(dccl::Option('o', "omit_prefix", no_argument, "Omit the DCCL type name prefix from the output of decode."));
     options.push_back(dccl::Option('i', "id_codec", required_argument, "(Advanced) name for a nonstandard DCCL ID codec to use"));
@@ -445,6 +509,10 @@ void parse_options(int argc, char* argv[], dccl::tool::Config* cfg)
                         exit(EXIT_FAILURE);
                     }
                 }
+                else if(!strcmp(long_options[option_index].name, "log"))
+                {
+                    cfg->log = optarg;
+                }
                 else
                 {
                     std::cerr << "Try --help for valid options." << std::endl;
@@ -0,0 +1,600 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef GenCodecPlugin20261016H
+#define GenCodecPlugin20261016H
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/cstdint.hpp>
+
+#include <google/protobuf/descriptor.h>
+
+#include "option_extensions.pb.h"
+
+///////////////////////////////////////////////////////////////////////////////////
+// Generation of dccl::GeneratedMessageCodec implementations (see dccl/generated_codec.h)
+// for DCCL3 messages that only use the default field codecs:
+// numeric, bool, enum, embedded (non-repeated) messages and repeated
+// numeric/bool/enum fields. Any other message is left to the default codecs at runtime.
+///////////////////////////////////////////////////////////////////////////////////
+
+namespace dccl
+{
+  namespace codegen
+  {
+    // same as dccl::ceil_log2() (dccl/binary.h), as the plugin does not link against libdccl
+    inline unsigned ceil_log2(boost::uint64_t v)
+    {
+        unsigned r = ((v & (v - 1)) == 0) ? 0 : 1;
+        while (v >>= 1)
+            r++;
+        return r;
+    }
+
+    inline unsigned ceil_log2(double d)
+    { return ceil_log2(static_cast<boost::uint64_t>(std::ceil(d))); }
+
+    // C++ identifier for a protobuf full name (e.g. "foo.Bar" -> "foo_Bar")
+    inline std::string mangle(const std::string& full_name)
+    {
+        std::string s = full_name;
+        boost::replace_all(s, ".", "_");
+        return s;
+    }
+
+    // the C++ type protoc generates for a message or enum (e.g. "::foo::Bar_Baz")
+    template<typename Descriptor>
+      std::string cpp_scoped_name(const Descriptor* desc)
+    {
+        std::string name = desc->name();
+        for(const google::protobuf::Descriptor* containing = desc->containing_type(); containing; containing = containing->containing_type())
+            name = containing->name() + "_" + name;
+
+        std::string package = desc->file()->package();
+        boost::replace_all(package, ".", "::");
+        return "::" + (package.empty() ? "" : package + "::") + name;
+    }
+
+    // the name of the generated accessors for a field (protoc appends "_" to C++ keywords)
+    inline std::string cpp_field_name(const google::protobuf::FieldDescriptor* field)
+    {
+        static const char* keywords[] = {
+            "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break",
+            "case", "catch", "char", "class", "compl", "const", "constexpr", "const_cast", "continue",
+            "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit",
+            "export", "extern", "false", "float", "for", "friend", "goto", "if", "inline", "int", "long",
+            "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator", "or",
+            "or_eq", "private", "protected", "public", "register", "reinterpret_cast", "return", "short",
+            "signed", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "template",
+            "this", "thread_local", "throw", "true", "try", "typedef", "typeid", "typename", "union",
+            "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq" };
+
+        std::string name = field->lowercase_name();
+        for(unsigned i = 0, n = sizeof(keywords) / sizeof(keywords[0]); i < n; ++i)
+        {
+            if(name == keywords[i])
+                return name + "_";
+        }
+        return name;
+    }
+
+    // double constant as C++ source that round trips exactly
+    inline std::string literal(double d)
+    {
+        std::stringstream ss;
+        ss << std::setprecision(17) << d;
+        std::string s = ss.str();
+        if(s.find_first_of(".en") == std::string::npos)
+            s += ".0";
+        return s;
+    }
+
+    /// \brief Writes a dccl::GeneratedMessageCodec for a single DCCL message
+    class MessageCodecGenerator
+    {
+      public:
+        MessageCodecGenerator(const google::protobuf::Descriptor* desc) : desc_(desc) { }
+
+        /// \brief Checks the message (and all its embedded messages) can be generated
+        /// \param reason Set to why not, if not
+        bool check(std::string* reason)
+        {
+            const dccl::DCCLMessageOptions& options = desc_->options().GetExtension(dccl::msg);
+            if(options.codec_version() != 3)
+                return fail(reason, "(dccl.msg).codec_version is not 3");
+            if(options.has_codec())
+                return fail(reason, "(dccl.msg).codec is set");
+            if(options.has_codec_group() && options.codec_group() != "dccl.default3")
+                return fail(reason, "(dccl.msg).codec_group is not dccl.default3");
+
+            std::vector<const google::protobuf::Descriptor*> stack;
+            return check_message(desc_, &stack, reason);
+        }
+
+        /// \brief Writes the codec class and a static object that registers it with dccl::Codec
+        void generate(std::ostream& os)
+        {
+            const std::string class_name = "DCCLGeneratedCodec_" + mangle(desc_->full_name());
+            const std::string type = cpp_scoped_name(desc_);
+
+            os << "// DCCL codec for " << desc_->full_name() << " generated by protoc-gen-dccl\n";
+            os << "namespace\n{\n";
+            os << "class " << class_name << " : public dccl::GeneratedMessageCodec\n{\n";
+            os << "  public:\n";
+            os << "    bool encode(dccl::BitWriter* writer, const google::protobuf::Message& msg, dccl::MessagePart part)\n";
+            os << "    {\n";
+            os << "        const " << type << "* typed_msg = dynamic_cast< const " << type << "* >(&msg);\n";
+            os << "        if(!typed_msg) return false;\n";
+            os << "        if(part == dccl::HEAD) encode_head(writer, *typed_msg);\n";
+            os << "        else encode_body(writer, *typed_msg);\n";
+            os << "        return true;\n";
+            os << "    }\n\n";
+            os << "    bool size(unsigned* bit_size, const google::protobuf::Message& msg, dccl::MessagePart part)\n";
+            os << "    {\n";
+            os << "        const " << type << "* typed_msg = dynamic_cast< const " << type << "* >(&msg);\n";
+            os << "        if(!typed_msg) return false;\n";
+            os << "        *bit_size = (part == dccl::HEAD) ? size_head(*typed_msg) : size_body(*typed_msg);\n";
+            os << "        return true;\n";
+            os << "    }\n\n";
+            os << "    bool decode(dccl::Bitset* bits, google::protobuf::Message* msg, dccl::MessagePart part)\n";
+            os << "    {\n";
+            os << "        " << type << "* typed_msg = dynamic_cast< " << type << "* >(msg);\n";
+            os << "        if(!typed_msg) return false;\n";
+            os << "        if(part == dccl::HEAD) decode_head(bits, typed_msg);\n";
+            os << "        else decode_body(bits, typed_msg);\n";
+            os << "        return true;\n";
+            os << "    }\n\n";
+            os << "    unsigned max_size(dccl::MessagePart part)\n";
+            os << "    { return part == dccl::HEAD ? " << max_size(desc_, HEAD) << " : " << max_size(desc_, BODY) << "; }\n\n";
+            os << "    unsigned min_size(dccl::MessagePart part)\n";
+            os << "    { return part == dccl::HEAD ? " << min_size(desc_, HEAD) << " : " << min_size(desc_, BODY) << "; }\n\n";
+            os << "  private:\n";
+
+            messages_.clear();
+            enums_.clear();
+            std::stringstream functions;
+            generate_functions(desc_, HEAD, "head", functions);
+            generate_functions(desc_, BODY, "body", functions);
+            // embedded messages are added to messages_ as they are found
+            for(unsigned i = 0; i < messages_.size(); ++i)
+                generate_functions(messages_[i], ALL, mangle(messages_[i]->full_name()), functions);
+            for(std::set<const google::protobuf::EnumDescriptor*>::const_iterator it = enums_.begin(), end = enums_.end(); it != end; ++it)
+                generate_enum_functions(*it, functions);
+
+            os << functions.str();
+            os << "};\n\n";
+
+            os << "struct " << class_name << "Registrar\n{\n";
+            os << "    " << class_name << "Registrar()\n";
+            os << "    { dccl::Codec::add_generated_codec(\"" << desc_->full_name() << "\", boost::shared_ptr<dccl::GeneratedMessageCodec>(new " << class_name << ")); }\n";
+            os << "} " << class_name << "_registrar;\n";
+            os << "}\n\n";
+        }
+
+      private:
+        enum Part { HEAD, BODY, ALL };
+
+        static bool fail(std::string* reason, const std::string& why)
+        {
+            *reason = why;
+            return false;
+        }
+
+        static const dccl::DCCLFieldOptions& options(const google::protobuf::FieldDescriptor* field)
+        { return field->options().GetExtension(dccl::field); }
+
+        // fields of `desc` encoded in `part` (all non-omitted fields of embedded messages)
+        static bool included(const google::protobuf::FieldDescriptor* field, Part part)
+        {
+            const dccl::DCCLFieldOptions& field_options = options(field);
+            if(field_options.omit())
+                return false;
+            switch(part)
+            {
+                case HEAD: return field_options.in_head();
+                case BODY: return !field_options.in_head();
+                default: return true;
+            }
+        }
+
+        bool check_message(const google::protobuf::Descriptor* desc,
+                           std::vector<const google::protobuf::Descriptor*>* stack,
+                           std::string* reason)
+        {
+            using google::protobuf::FieldDescriptor;
+
+            if(std::find(stack->begin(), stack->end(), desc) != stack->end())
+                return fail(reason, desc->full_name() + " is recursive");
+
+            stack->push_back(desc);
+            for(int i = 0, n = desc->field_count(); i < n; ++i)
+            {
+                const FieldDescriptor* field = desc->field(i);
+                const dccl::DCCLFieldOptions& field_options = options(field);
+                if(field_options.omit())
+                    continue;
+
+                const std::string name = field->full_name() + ": ";
+                if(field_options.has_codec())
+                    return fail(reason, name + "(dccl.field).codec is set");
+                if(!field->is_repeated() && !field->is_required() && !field->is_optional())
+                    return fail(reason, name + "unsupported label");
+
+                switch(field->cpp_type())
+                {
+                    case FieldDescriptor::CPPTYPE_STRING:
+                        return fail(reason, name + "string and bytes fields are not supported");
+
+                    case FieldDescriptor::CPPTYPE_MESSAGE:
+                        if(field->is_repeated())
+                            return fail(reason, name + "repeated message fields are not supported");
+                        if(!check_message(field->message_type(), stack, reason))
+                            return false;
+                        break;
+
+                    case FieldDescriptor::CPPTYPE_BOOL:
+                    case FieldDescriptor::CPPTYPE_ENUM:
+                        break;
+
+                    default:
+                        if(!field_options.has_min() || !field_options.has_max())
+                            return fail(reason, name + "missing (dccl.field).min or (dccl.field).max");
+                        if(!(field_options.max() >= field_options.min()))
+                            return fail(reason, name + "(dccl.field).max is less than (dccl.field).min");
+                        break;
+                }
+
+                if(field->cpp_type() != FieldDescriptor::CPPTYPE_MESSAGE && value_size(field, field->is_repeated() || field->is_required()) > 64)
+                    return fail(reason, name + "fields larger than 64 bits are not supported");
+            }
+            stack->pop_back();
+            return true;
+        }
+
+        //
+        // sizes (must match the default DCCL3 codecs)
+        //
+
+        // size of a single numeric/bool/enum value
+        static unsigned value_size(const google::protobuf::FieldDescriptor* field, bool required)
+        {
+            const unsigned null_value = required ? 0 : 1;
+            switch(field->cpp_type())
+            {
+                case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+                    return ceil_log2(static_cast<boost::uint64_t>(2 + null_value));
+                case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+                    return ceil_log2((field->enum_type()->value_count() - 1) * std::pow(10.0, options(field).precision()) + 1 + null_value);
+                default:
+                    return ceil_log2((options(field).max() - options(field).min()) * std::pow(10.0, options(field).precision()) + 1 + null_value);
+            }
+        }
+
+        static unsigned repeat_prefix_size(const google::protobuf::FieldDescriptor* field)
+        { return ceil_log2(static_cast<boost::uint64_t>(options(field).max_repeat()) + 1); }
+
+        unsigned max_size(const google::protobuf::Descriptor* desc, Part part)
+        {
+            unsigned u = 0;
+            for(int i = 0, n = desc->field_count(); i < n; ++i)
+            {
+                const google::protobuf::FieldDescriptor* field = desc->field(i);
+                if(!included(field, part))
+                    continue;
+
+                if(field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+                    u += max_size(field->message_type(), ALL) + (field->is_optional() ? 1 : 0);
+                else if(field->is_repeated())
+                    u += repeat_prefix_size(field) + options(field).max_repeat() * value_size(field, true);
+                else
+                    u += value_size(field, field->is_required());
+            }
+            return u;
+        }
+
+        unsigned min_size(const google::protobuf::Descriptor* desc, Part part)
+        {
+            unsigned u = 0;
+            for(int i = 0, n = desc->field_count(); i < n; ++i)
+            {
+                const google::protobuf::FieldDescriptor* field = desc->field(i);
+                if(!included(field, part))
+                    continue;
+
+                if(field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+                    u += field->is_optional() ? 1 : min_size(field->message_type(), ALL);
+                else if(field->is_repeated())
+                    u += repeat_prefix_size(field);
+                else
+                    u += value_size(field, field->is_required());
+            }
+            return u;
+        }
+
+        //
+        // code
+        //
+
+        // C++ statements encoding the single value `value` of `field`
+        void encode_value(const google::protobuf::FieldDescriptor* field, const std::string& value, bool required, const std::string& indent, std::ostream& os)
+        {
+            const unsigned bits = value_size(field, required);
+            const dccl::DCCLFieldOptions& field_options = options(field);
+            switch(field->cpp_type())
+            {
+                case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+                    os << indent << "{\n";
+                    if(required)
+                        os << indent << "    writer->write(" << value << " ? 1 : 0, " << bits << ");\n";
+                    else
+                        os << indent << "    writer->write(" << value << " ? 2 : 1, " << bits << ");\n";
+                    os << indent << "}\n";
+                    break;
+
+                case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+                    os << indent << "{\n";
+                    os << indent << "    dccl::uint64 u = 0;\n";
+                    os << indent << "    " << (required ? "" : "if(") << "dccl::v2::numeric_wire_encode<dccl::int32>(enum_index_" << mangle(field->enum_type()->full_name()) << "(" << value << "), 0.0, "
+                       << literal(field->enum_type()->value_count() - 1) << ", " << field_options.precision() << ", &u)" << (required ? ";\n" : ")\n");
+                    if(!required)
+                        os << indent << "        ++u; // presence\n";
+                    os << indent << "    writer->write(u, " << bits << ");\n";
+                    os << indent << "}\n";
+                    break;
+
+                default:
+                    os << indent << "{\n";
+                    os << indent << "    dccl::uint64 u = 0;\n";
+                    os << indent << "    " << (required ? "" : "if(") << "dccl::v2::numeric_wire_encode< " << wire_type(field) << " >(" << value << ", "
+                       << literal(field_options.min()) << ", " << literal(field_options.max()) << ", " << field_options.precision() << ", &u)" << (required ? ";\n" : ")\n");
+                    if(!required)
+                        os << indent << "        ++u; // presence\n";
+                    os << indent << "    writer->write(u, " << bits << ");\n";
+                    os << indent << "}\n";
+                    break;
+            }
+        }
+
+        // C++ statements decoding a single value of `field` and calling `setter`(value) unless the value is empty
+        void decode_value(const google::protobuf::FieldDescriptor* field, const std::string& setter, bool required, const std::string& indent, std::ostream& os)
+        {
+            const unsigned bits = value_size(field, required);
+            const dccl::DCCLFieldOptions& field_options = options(field);
+
+            std::string wire_value;
+            std::string value_indent = indent;
+            if(required)
+            {
+                wire_value = "read_bits(bits, " + boost::lexical_cast<std::string>(bits) + ")";
+            }
+            else
+            {
+                // zero is the "presence" value
+                os << indent << "{\n";
+                os << indent << "    dccl::uint64 u = read_bits(bits, " << bits << ");\n";
+                os << indent << "    if(u--)\n";
+                wire_value = "u";
+                value_indent += "        ";
+            }
+
+            switch(field->cpp_type())
+            {
+                case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+                    os << value_indent << setter << "(" << wire_value << " != 0);\n";
+                    break;
+
+                case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+                {
+                    const google::protobuf::EnumDescriptor* enum_desc = field->enum_type();
+                    const std::string block_indent = required ? value_indent : value_indent.substr(4);
+                    os << block_indent << "{\n";
+                    os << block_indent << "    dccl::int32 index = dccl::v2::numeric_wire_decode<dccl::int32>(" << wire_value << ", 0.0, " << field_options.precision() << ");\n";
+                    os << block_indent << "    if(index < " << enum_desc->value_count() << ")\n";
+                    os << block_indent << "        " << setter << "(static_cast< " << cpp_scoped_name(enum_desc) << " >(enum_value_" << mangle(enum_desc->full_name()) << "(index)));\n";
+                    os << block_indent << "}\n";
+                    break;
+                }
+
+                default:
+                    os << value_indent << setter << "(dccl::v2::numeric_wire_decode< " << wire_type(field) << " >(" << wire_value << ", " << literal(field_options.min()) << ", " << field_options.precision() << "));\n";
+                    break;
+            }
+
+            if(!required)
+                os << indent << "}\n";
+        }
+
+        static std::string wire_type(const google::protobuf::FieldDescriptor* field)
+        {
+            switch(field->cpp_type())
+            {
+                case google::protobuf::FieldDescriptor::CPPTYPE_INT32: return "dccl::int32";
+                case google::protobuf::FieldDescriptor::CPPTYPE_INT64: return "dccl::int64";
+                case google::protobuf::FieldDescriptor::CPPTYPE_UINT32: return "dccl::uint32";
+                case google::protobuf::FieldDescriptor::CPPTYPE_UINT64: return "dccl::uint64";
+                case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE: return "double";
+                case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT: return "float";
+                default: return "";
+            }
+        }
+
+        // encode_<suffix>, size_<suffix> and decode_<suffix> for the fields of `desc` in `part`
+        void generate_functions(const google::protobuf::Descriptor* desc, Part part, const std::string& suffix, std::ostream& os)
+        {
+            using google::protobuf::FieldDescriptor;
+            const std::string type = cpp_scoped_name(desc);
+
+            std::stringstream encode, size, decode;
+            unsigned fixed_size = 0;
+            for(int i = 0, n = desc->field_count(); i < n; ++i)
+            {
+                const FieldDescriptor* field = desc->field(i);
+                if(!included(field, part))
+                    continue;
+
+                const std::string name = cpp_field_name(field);
+                encode << "        // " << field->name() << "\n";
+                decode << "        // " << field->name() << "\n";
+
+                if(field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE)
+                {
+                    const google::protobuf::Descriptor* embedded = field->message_type();
+                    if(std::find(messages_.begin(), messages_.end(), embedded) == messages_.end())
+                        messages_.push_back(embedded);
+                    const std::string embedded_suffix = mangle(embedded->full_name());
+
+                    // an unset field is encoded as the minimum size of zeros (i.e. a zero presence bit if optional)
+                    const unsigned empty_size = field->is_optional() ? 1 : min_size(embedded, ALL);
+                    encode << "        if(msg.has_" << name << "())\n";
+                    encode << "        {\n";
+                    if(field->is_optional())
+                        encode << "            writer->write(1, 1); // presence\n";
+                    encode << "            encode_" << embedded_suffix << "(writer, msg." << name << "());\n";
+                    encode << "        }\n";
+                    encode << "        else\n";
+                    encode << "            writer->write_zeros(" << empty_size << ");\n";
+
+                    if(field->is_optional())
+                    {
+                        fixed_size += 1;
+                        size << "        if(msg.has_" << name << "())\n";
+                        size << "            bit_size += size_" << embedded_suffix << "(msg." << name << "());\n";
+                    }
+                    else
+                    {
+                        size << "        bit_size += msg.has_" << name << "() ? size_" << embedded_suffix << "(msg." << name << "()) : " << empty_size << ";\n";
+                    }
+
+                    decode << "        {\n";
+                    std::string indent = "            ";
+                    if(field->is_optional())
+                    {
+                        decode << "            if(read_bits(bits, 1)) // presence\n";
+                        decode << "            {\n";
+                        indent += "    ";
+                    }
+                    decode << indent << cpp_scoped_name(embedded) << "* embedded = msg->mutable_" << name << "();\n";
+                    decode << indent << "decode_" << embedded_suffix << "(bits, embedded);\n";
+                    decode << indent << "if(!has_any_field(*embedded)) msg->clear_" << name << "();\n";
+                    if(field->is_optional())
+                        decode << "            }\n";
+                    decode << "        }\n";
+                }
+                else
+                {
+                    if(field->cpp_type() == FieldDescriptor::CPPTYPE_ENUM)
+                        enums_.insert(field->enum_type());
+
+                    if(field->is_repeated())
+                    {
+                        const unsigned prefix = repeat_prefix_size(field);
+                        const unsigned max_repeat = options(field).max_repeat();
+                        encode << "        {\n";
+                        encode << "            const unsigned n = msg." << name << "_size();\n";
+                        encode << "            writer->write(n, " << prefix << ");\n";
+                        encode << "            for(unsigned i = 0, m = std::min<unsigned>(n, " << max_repeat << "); i < m; ++i)\n";
+                        encode_value(field, "msg." + name + "(i)", true, "            ", encode);
+                        encode << "        }\n";
+
+                        fixed_size += prefix;
+                        size << "        bit_size += std::min<unsigned>(msg." << name << "_size(), " << max_repeat << ") * " << value_size(field, true) << ";\n";
+
+                        decode << "        for(dccl::uint64 i = 0, n = read_bits(bits, " << prefix << "); i < n; ++i)\n";
+                        // enumerations decode in their own block
+                        decode_value(field, "msg->add_" + name, true, field->cpp_type() == FieldDescriptor::CPPTYPE_ENUM ? "        " : "            ", decode);
+                    }
+                    else
+                    {
+                        const bool required = field->is_required();
+                        encode << "        if(msg.has_" << name << "())\n";
+                        encode_value(field, "msg." + name + "()", required, "        ", encode);
+                        encode << "        else\n";
+                        encode << "            writer->write_zeros(" << value_size(field, required) << ");\n";
+
+                        fixed_size += value_size(field, required);
+
+                        decode_value(field, "msg->set_" + name, required, "        ", decode);
+                    }
+                }
+            }
+
+            os << "    static void encode_" << suffix << "(dccl::BitWriter* writer, const " << type << "& msg)\n";
+            os << "    {\n" << encode.str() << "    }\n\n";
+            os << "    static unsigned size_" << suffix << "(const " << type << "& msg)\n";
+            os << "    {\n";
+            os << "        unsigned bit_size = " << fixed_size << ";\n";
+            os << size.str();
+            os << "        return bit_size;\n";
+            os << "    }\n\n";
+            os << "    static void decode_" << suffix << "(dccl::Bitset* bits, " << type << "* msg)\n";
+            os << "    {\n" << decode.str() << "    }\n\n";
+        }
+
+        // conversion between enumeration values and their index (as encoded by the default enum codec)
+        void generate_enum_functions(const google::protobuf::EnumDescriptor* enum_desc, std::ostream& os)
+        {
+            const std::string suffix = mangle(enum_desc->full_name());
+            std::set<int> numbers;
+
+            os << "    static dccl::int32 enum_index_" << suffix << "(int value)\n";
+            os << "    {\n";
+            os << "        switch(value)\n";
+            os << "        {\n";
+            for(int i = 0, n = enum_desc->value_count(); i < n; ++i)
+            {
+                // aliases map to the first value with that number
+                if(numbers.insert(enum_desc->value(i)->number()).second)
+                    os << "            case " << enum_desc->value(i)->number() << ": return " << i << ";\n";
+            }
+            os << "            default: return 0;\n";
+            os << "        }\n";
+            os << "    }\n\n";
+
+            os << "    static int enum_value_" << suffix << "(dccl::int32 index)\n";
+            os << "    {\n";
+            os << "        switch(index)\n";
+            os << "        {\n";
+            for(int i = 0, n = enum_desc->value_count(); i < n; ++i)
+                os << "            case " << i << ": return " << enum_desc->value(i)->number() << ";\n";
+            os << "            default: return " << enum_desc->value(0)->number() << ";\n";
+            os << "        }\n";
+            os << "    }\n\n";
+        }
+
+      private:
+        const google::protobuf::Descriptor* desc_;
+        // embedded message types used, in the order found
+        std::vector<const google::protobuf::Descriptor*> messages_;
+        std::set<const google::protobuf::EnumDescriptor*> enums_;
+    };
+  }
+}
+
+#endif
@@ -26,10 +26,13 @@
 #include <sstream>
 #include <set>
 #include <boost/shared_ptr.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
 #include <google/protobuf/io/printer.h>
 #include <google/protobuf/io/zero_copy_stream.h>
 #include "option_extensions.pb.h"
 #include "gen_units_class_plugin.h"
+#include "gen_codec_plugin.h"
 
 std::set<std::string> systems_to_include_;
 std::set<std::string> base_units_to_include_;
@@ -51,6 +54,8 @@ class DCCLGenerator : public google::protobuf::compiler::CodeGenerator {
     void generate_message(const google::protobuf::Descriptor* desc,
                           google::protobuf::compiler::GeneratorContext* generator_context,
                           boost::shared_ptr<std::string> message_unit_system = boost::shared_ptr<std::string>()) const;
+    void generate_message_codec(const google::protobuf::Descriptor* desc,
+                                std::ostream& os) const;
     void generate_field(const google::protobuf::FieldDescriptor* field,
                         google::protobuf::io::Printer* printer,
                         boost::shared_ptr<std::string> message_unit_system) const;
@@ -87,7 +92,12 @@ bool DCCLGenerator::Generate(const google::protobuf::FileDescriptor* file,
     {
         const std::string& filename = file->name();
         filename_h_ = filename.substr(0, filename.find(".proto")) + ".pb.h";
-//        std::string filename_cc = filename.substr(0, filename.find(".proto")) + ".pb.cc";
+        std::string filename_cc = filename.substr(0, filename.find(".proto")) + ".pb.cc";
+
+        // e.g. --dccl_out=codecs:/path/to/out
+        std::vector<std::string> parameters;
+        boost::split(parameters, parameter, boost::is_any_of(","));
+        bool generate_codecs = std::find(parameters.begin(), parameters.end(), "codecs") != parameters.end();
         
         for(int message_i = 0, message_n = file->message_type_count(); message_i < message_n; ++message_i)
         {
@@ -120,6 +130,29 @@ bool DCCLGenerator::Generate(const google::protobuf::FileDescriptor* file,
             include_base_unit_headers(*it, includes_ss);
         }
         include_printer.Print(includes_ss.str().c_str());
+
+        if(generate_codecs)
+        {
+            std::stringstream codecs_ss;
+            for(int message_i = 0, message_n = file->message_type_count(); message_i < message_n; ++message_i)
+                generate_message_codec(file->message_type(message_i), codecs_ss);
+
+            if(!codecs_ss.str().empty())
+            {
+                boost::shared_ptr<google::protobuf::io::ZeroCopyOutputStream> cc_include_output(
+                    generator_context->OpenForInsert(filename_cc, "includes"));
+                google::protobuf::io::Printer cc_include_printer(cc_include_output.get(), '$');
+                cc_include_printer.Print("#include <algorithm>\n"
+                                         "#include \"dccl/codec.h\"\n"
+                                         "#include \"dccl/generated_codec.h\"\n"
+                                         "#include \"dccl/codecs2/field_codec_default.h\"\n");
+
+                boost::shared_ptr<google::protobuf::io::ZeroCopyOutputStream> codecs_output(
+                    generator_context->OpenForInsert(filename_cc, "global_scope"));
+                google::protobuf::io::Printer codecs_printer(codecs_output.get(), '$');
+                codecs_printer.Print(codecs_ss.str().c_str());
+            }
+        }
         
         return true;
     }
@@ -174,6 +207,22 @@ void DCCLGenerator::generate_message(const google::protobuf::Descriptor* desc, g
     }
 }
 
+void DCCLGenerator::generate_message_codec(const google::protobuf::Descriptor* desc, std::ostream& os) const
+{
+    if(desc->options().HasExtension(dccl::msg) && desc->options().GetExtension(dccl::msg).has_id())
+    {
+        dccl::codegen::MessageCodecGenerator generator(desc);
+        std::string reason;
+        if(generator.check(&reason))
+            generator.generate(os);
+        else
+            std::cerr << "protoc-gen-dccl: not generating a codec for " << desc->full_name() << " (" << reason << "), the default codecs will be used" << std::endl;
+    }
+
+    for(int nested_type_i = 0, nested_type_n = desc->nested_type_count(); nested_type_i < nested_type_n; ++nested_type_i)
+        generate_message_codec(desc->nested_type(nested_type_i), os);
+}
+
 void DCCLGenerator::generate_field(const google::protobuf::FieldDescriptor* field, google::protobuf::io::Printer* printer, boost::shared_ptr<std::string> message_unit_system) const
 {
     try
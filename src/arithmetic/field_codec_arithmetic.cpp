@@ -25,14 +25,17 @@
 using dccl::dlog;
 using namespace dccl::logger;
 
-std::map<std::string, dccl::arith::Model> dccl::arith::ModelManager::arithmetic_models_;
+std::map<std::string, boost::shared_ptr<const dccl::arith::Model> > dccl::arith::ModelManager::arithmetic_models_;
+std::mutex dccl::arith::ModelManager::mutex_;
+std::atomic<unsigned> dccl::arith::ModelManager::generation_(0);
+thread_local dccl::arith::ModelContext* dccl::arith::ModelContext::current_ = 0;
 const dccl::arith::Model::symbol_type dccl::arith::Model::OUT_OF_RANGE_SYMBOL;
 const dccl::arith::Model::symbol_type dccl::arith::Model::EOF_SYMBOL;
 const dccl::arith::Model::symbol_type dccl::arith::Model::MIN_SYMBOL;
 const int dccl::arith::Model::CODE_VALUE_BITS;
 const int dccl::arith::Model::FREQUENCY_BITS;
 const dccl::arith::Model::freq_type dccl::arith::Model::MAX_FREQUENCY;
-std::map<std::string, std::map<std::string, dccl::Bitset> > dccl::arith::Model::last_bits_map;
+thread_local std::map<std::string, std::map<std::string, dccl::Bitset> > dccl::arith::Model::last_bits_map;
 
 // shared library load
 extern "C"
@@ -242,3 +245,31 @@ void dccl::arith::Model::update_model(symbol_type symbol, ModelState state)
     dlog.is(DEBUG3) && dlog << "total freq: " << total_freq(state) << std::endl;
                 
 }
+
+dccl::arith::Model& dccl::arith::ModelContext::model(const std::string& name)
+{
+    Entry& entry = models_[name];
+
+    // only look up the shared model again if set_model() has been called since
+    unsigned generation = ModelManager::generation();
+    if(!entry.state || entry.generation != generation)
+    {
+        boost::shared_ptr<const Model> shared = ModelManager::find(name);
+        if(shared != entry.shared)
+        {
+            entry.shared = shared;
+            entry.state.reset(new Model(*shared));
+        }
+        entry.generation = generation;
+    }
+    return *entry.state;
+}
+
+dccl::arith::ModelContext& dccl::arith::ModelContext::current()
+{
+    if(current_)
+        return *current_;
+
+    static thread_local ModelContext thread_default;
+    return thread_default;
+}
@@ -27,6 +27,8 @@
 
 #include <limits>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 
 #include <boost/bimap.hpp>
 #include <boost/lexical_cast.hpp>
@@ -70,8 +72,8 @@ namespace dccl
             static const freq_type MAX_FREQUENCY = (1 << FREQUENCY_BITS) - 1;
 
             
-            // maps message name -> map of field name -> last size (bits)
-            static std::map<std::string, std::map<std::string, Bitset> > last_bits_map;
+            // maps message name -> map of field name -> last size (bits), for the messages encoded on this thread
+            static thread_local std::map<std::string, std::map<std::string, Bitset> > last_bits_map;
 
             
           Model(const protobuf::ArithmeticModel& user)
@@ -115,16 +117,19 @@ namespace dccl
             boost::bimap<symbol_type, freq_type> decoder_cumulative_freqs_;
         };
 
+        /// \brief Holds the models (as given by the user, before any adaptation) shared by all the arithmetic codecs. The state of adaptive models is kept separately, by a ModelContext.
         class ModelManager
         {
           public:
+            /// \brief Add (or replace) the model called model.name(). ModelContexts start adapting the new model from scratch.
             static void set_model(const protobuf::ArithmeticModel& model)
             {
-                Model new_model(model);
-                create_and_validate_model(&new_model);
-                if(arithmetic_models_.count(model.name()))
-                    arithmetic_models_.erase(model.name());
-                arithmetic_models_.insert(std::make_pair(model.name(), new_model));
+                boost::shared_ptr<Model> new_model(new Model(model));
+                create_and_validate_model(new_model.get());
+
+                std::lock_guard<std::mutex> lock(mutex_);
+                arithmetic_models_[model.name()] = new_model;
+                ++generation_;
             }
 
             static void create_and_validate_model(Model* model)
@@ -190,17 +195,72 @@ namespace dccl
             }
             
 
-            static Model& find(const std::string& name)
+            /// \brief The model called `name`, as given to set_model() (i.e. never adapted)
+            static boost::shared_ptr<const Model> find(const std::string& name)
             {
-                std::map<std::string, Model>::iterator it = arithmetic_models_.find(name);
+                std::lock_guard<std::mutex> lock(mutex_);
+                std::map<std::string, boost::shared_ptr<const Model> >::const_iterator it = arithmetic_models_.find(name);
                 if(it == arithmetic_models_.end())
                     throw(Exception("Cannot find model called: " + name));
                 else
                     return it->second;
             }
 
+            /// \brief Incremented by each call to set_model()
+            static unsigned generation()
+            { return generation_.load(std::memory_order_acquire); }
+            
+          private:
+            static std::map<std::string, boost::shared_ptr<const Model> > arithmetic_models_;
+            static std::mutex mutex_;
+            static std::atomic<unsigned> generation_;
+        };
+
+        /// \brief The state of the adaptive models used for one link (or other stream of messages).
+        ///
+        /// Adaptive models change with every message encoded or decoded, so the encoder and decoder on either end of a link must see the same messages in the same order. Give each link its own ModelContext, and make it current (with a ModelContext::Scope) while encoding or decoding that link's messages:
+        /// \code
+        /// dccl::arith::ModelContext::Scope scope(&link_context);
+        /// codec.encode(&bytes, msg);
+        /// \endcode
+        /// Without a Scope, each thread uses a default ModelContext of its own. A ModelContext must only be used by one thread at a time, but different ModelContexts may be used by different threads at once.
+        class ModelContext
+        {
+          public:
+            /// \brief This context's copy of the model called `name`. It starts out as the model given to ModelManager::set_model() (and starts over if set_model() replaces that model).
+            Model& model(const std::string& name);
+
+            /// \brief Forget all adaptation, so that every model starts over (e.g. when the link is restarted)
+            void reset() { models_.clear(); }
+
+            /// \brief The context used by arithmetic codecs on this thread: that of the innermost Scope, or else the thread's default context
+            static ModelContext& current();
+            
+            /// \brief Makes a context current on this thread for the lifetime of the Scope
+            class Scope
+            {
+              public:
+                explicit Scope(ModelContext* context) : previous_(current_) { current_ = context; }
+                ~Scope() { current_ = previous_; }
+              private:
+                Scope(const Scope&);
+                Scope& operator=(const Scope&);
+                ModelContext* previous_;
+            };
+            
           private:
-            static std::map<std::string, Model> arithmetic_models_;
+            struct Entry
+            {
+                Entry() : generation(0) { }
+                // ModelManager::generation() when `shared` was last checked
+                unsigned generation;
+                boost::shared_ptr<const Model> shared;
+                // adapted copy of `shared`
+                boost::shared_ptr<Model> state;
+            };
+            std::map<std::string, Entry> models_;
+
+            static thread_local ModelContext* current_;
         };
         
         
@@ -221,6 +281,31 @@ namespace dccl
               
               Bitset encode_repeated(const std::vector<Model::value_type>& wire_value,
                                      bool update_model)
+              {
+                  Bitset bits;
+                  encode_symbols(wire_value, update_model, &bits);
+                  
+                  if(FieldCodecBase::dccl_field_options().GetExtension(arithmetic).debug_assert())
+                  {
+                      // bit of a hack so I can get at the exact bit field sizes
+                      Model::last_bits_map[FieldCodecBase::this_descriptor()->full_name()][FieldCodecBase::this_field()->name()] = bits;
+                  }
+                  
+                  return bits;
+              }
+
+              // counts the bits emitted by encode_symbols(), for size_repeated()
+              struct BitCounter
+              {
+                  BitCounter() : size(0) { }
+                  void push_back(bool bit) { ++size; }
+                  unsigned size;
+              };
+
+              // run the encoder over `wire_value`, emitting the encoded bits into `bits` (a Bitset or BitCounter)
+              template<typename BitSink>
+              void encode_symbols(const std::vector<Model::value_type>& wire_value,
+                                  bool update_model, BitSink* bits)
               {
                   using dccl::dlog;
                   using namespace dccl::logger;
@@ -230,7 +315,6 @@ namespace dccl
                   uint64 low = 0; // lowest code value (0.0 in decimal version)
                   uint64 high = TOP_VALUE; // highest code value (1.0 in decimal version)
                   int bits_to_follow = 0; // bits to follow with after expanding around half
-                  Bitset bits;
 
                   
                   for(unsigned value_index = 0, n = max_repeat(); value_index < n; ++value_index)
@@ -309,12 +393,12 @@ namespace dccl
                       {
                           if(high<HALF)
                           {
-                              bit_plus_follow(&bits, &bits_to_follow, 0);
+                              bit_plus_follow(bits, &bits_to_follow, 0);
                               dlog.is(DEBUG3) && dlog << "(ArithmeticFieldCodec): completely in [0, 0.5): EXPAND" << std::endl;
                           }
                           else if(low>=HALF)
                           {
-                              bit_plus_follow(&bits, &bits_to_follow, 1);
+                              bit_plus_follow(bits, &bits_to_follow, 1);
                               low -= HALF;
                               high -= HALF;
                               dlog.is(DEBUG3) && dlog << "(ArithmeticFieldCodec): completely in [0.5, 1): EXPAND" << std::endl;
@@ -354,13 +438,13 @@ namespace dccl
                   if(low == 0) // high must be greater than half
                   {
                       if(high != TOP_VALUE || bits_to_follow > 0)
-                          bit_plus_follow(&bits, &bits_to_follow, 0);
+                          bit_plus_follow(bits, &bits_to_follow, 0);
                   }
                   // 0    .     .     .     1
                   //       |                | -- output a single 1
                   else if(high == TOP_VALUE) // 0 < low < half
                   {
-                      bit_plus_follow(&bits, &bits_to_follow, 1);
+                      bit_plus_follow(bits, &bits_to_follow, 1);
                   }
                   // 0    .     .     .     1
                   //     |           |        -- output 01
@@ -368,21 +452,12 @@ namespace dccl
                   else 
                   {
                       bits_to_follow += 1;
-                      bit_plus_follow(&bits, &bits_to_follow, (low < FIRST_QTR) ? 0 : 1);
-                  }
-                  
-                  if(FieldCodecBase::dccl_field_options().GetExtension(arithmetic).debug_assert())
-                  {
-                      // bit of a hack so I can get at the exact bit field sizes
-                      Model::last_bits_map[FieldCodecBase::this_descriptor()->full_name()][FieldCodecBase::this_field()->name()] = bits;
+                      bit_plus_follow(bits, &bits_to_follow, (low < FIRST_QTR) ? 0 : 1);
                   }
-
-                  
-                  return bits;
               }
 
-              
-              void bit_plus_follow(Bitset* bits, int* bits_to_follow, bool bit)
+              template<typename BitSink>
+              void bit_plus_follow(BitSink* bits, int* bits_to_follow, bool bit)
               {
                   bits->push_back(bit);
                   dccl::dlog.is(dccl::logger::DEBUG3) && dccl::dlog << "(ArithmeticFieldCodec): emitted bit: " << bit << std::endl;
@@ -499,8 +574,10 @@ namespace dccl
 
               unsigned size_repeated(const std::vector<Model::value_type>& wire_values)
               {
-                  // we should really cache this for efficiency
-                  return encode_repeated(wire_values, false).size();
+                  // run the encoder without storing the bits
+                  BitCounter counter;
+                  encode_symbols(wire_values, false, &counter);
+                  return counter.size;
               }
             
 
@@ -510,7 +587,8 @@ namespace dccl
               {
                   using dccl::log2;
                   
-                  Model& model = current_model();
+                  boost::shared_ptr<const Model> shared = shared_model();
+                  const Model& model = *shared;
                   
                   // if user doesn't provide out_of_range frequency, set it to max to force this
                   // calculation to return the lowest probability symbol in use
@@ -541,7 +619,8 @@ namespace dccl
               unsigned min_size_repeated()
               {
                   using dccl::log2;
-                  const Model& model = current_model();
+                  boost::shared_ptr<const Model> shared = shared_model();
+                  const Model& model = *shared;
 
                   if(model.user_model().is_adaptive())
                       return 0; // force examining bits from the beginning on decode
@@ -641,13 +720,19 @@ namespace dccl
               
               dccl::int32 max_repeat()
               {
-                  return FieldCodecBase::this_field()->is_repeated() ? FieldCodecBase::dccl_field_options().max_repeat() : 1;
+                  return FieldCodecBase::this_field()->is_repeated() ? FieldCodecBase::field_options().max_repeat : 1;
               }
 
+              // this field's model, as adapted so far by the current ModelContext
               Model& current_model()
               {
-                  std::string name = FieldCodecBase::dccl_field_options().GetExtension(arithmetic).model();
-                  return ModelManager::find(name);
+                  return ModelContext::current().model(FieldCodecBase::dccl_field_options().GetExtension(arithmetic).model());
+              }
+
+              // this field's model, before any adaptation
+              boost::shared_ptr<const Model> shared_model()
+              {
+                  return ModelManager::find(FieldCodecBase::dccl_field_options().GetExtension(arithmetic).model());
               }
               
               
@@ -0,0 +1,121 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLBITREADER20261016H
+#define DCCLBITREADER20261016H
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "dccl/bitset.h"
+#include "dccl/exception.h"
+
+namespace dccl
+{
+    /// \brief A non-owning read cursor over a buffer of encoded bytes.
+    ///
+    /// Bits are read in the same order as they are stored by Bitset::to_byte_string(): starting at the least significant bit of the first byte. The buffer is not copied, so it must remain valid while the BitReader (or any Bitset constructed from it) is in use. Field codecs do not use this directly; instead the top level Bitset is constructed from a BitReader and get_more_bits() calls are satisfied from the buffer in place.
+    class BitReader
+    {
+      public:
+        typedef std::size_t size_type;
+
+        /// \brief Construct a reader over the bytes [begin, end)
+        BitReader(const char* begin, const char* end)
+            : data_(reinterpret_cast<const unsigned char*>(begin)),
+            size_(static_cast<size_type>(end - begin) * BITS_IN_BYTE),
+            pos_(0)
+            { }
+
+        /// \brief Total number of bits in the buffer
+        size_type size() const { return size_; }
+        /// \brief Number of bits read (or skipped) so far
+        size_type position() const { return pos_; }
+        /// \brief Number of bits left to read
+        size_type remaining() const { return size_ - pos_; }
+
+        /// \brief Advance the cursor without reading
+        ///
+        /// \throw Exception Fewer than num_bits remain
+        void skip(size_type num_bits)
+        {
+            check_remaining(num_bits);
+            pos_ += num_bits;
+        }
+
+        /// \brief Read up to 64 bits and return them in the least significant bits of the result
+        ///
+        /// \throw Exception Fewer than num_bits remain or num_bits > 64
+        boost::uint64_t read(unsigned num_bits)
+        {
+            if(num_bits > Bitset::BITS_IN_WORD)
+                throw(Exception("BitReader::read can read at most 64 bits at a time"));
+            check_remaining(num_bits);
+
+            boost::uint64_t out = 0;
+            unsigned got = 0;
+            while(got < num_bits)
+            {
+                const unsigned bit_offset = pos_ % BITS_IN_BYTE;
+                const unsigned take = std::min<unsigned>(BITS_IN_BYTE - bit_offset, num_bits - got);
+                const boost::uint64_t byte = (data_[pos_ / BITS_IN_BYTE] >> bit_offset) & ((1u << take) - 1);
+                out |= byte << got;
+                got += take;
+                pos_ += take;
+            }
+            return out;
+        }
+
+        /// \brief Read bits and add them to the big end of a Bitset
+        ///
+        /// \throw Exception Fewer than num_bits remain
+        void read(size_type num_bits, Bitset* bits)
+        {
+            check_remaining(num_bits);
+            while(num_bits)
+            {
+                const unsigned chunk = std::min<size_type>(num_bits, Bitset::BITS_IN_WORD);
+                bits->append_word(read(chunk), chunk);
+                num_bits -= chunk;
+            }
+        }
+
+      private:
+        enum { BITS_IN_BYTE = 8 };
+
+        void check_remaining(size_type num_bits) const
+        {
+            if(num_bits > remaining())
+                throw(Exception("BitReader: cannot read " + boost::lexical_cast<std::string>(num_bits) + " bits, only " + boost::lexical_cast<std::string>(remaining()) + " remain"));
+        }
+
+      private:
+        const unsigned char* data_;
+        size_type size_;
+        size_type pos_;
+    };
+}
+
+#endif
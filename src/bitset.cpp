@@ -20,13 +20,36 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
 #include "bitset.h"
+#include "bitreader.h"
 #include "dccl/codec.h"
 
 using namespace dccl::logger;
 
+namespace dccl
+{
+    static const char* no_more_bits = "Cannot relinquish_bits - no more bits to give up! Check that all field codecs are always producing (encode) and consuming (decode) the exact same number of bits.";
+}
+
 dccl::Bitset dccl::Bitset::relinquish_bits(size_type num_bits,
                                                            bool final_child)
 {
+    Bitset out;
+    if(!final_child && this->empty())
+    {
+        // nothing is buffered here, so let our source give the bits directly to the child
+        if(parent_)
+        {
+            return parent_->relinquish_bits(num_bits, false);
+        }
+        else if(reader_)
+        {
+            if(reader_->remaining() < num_bits)
+                throw(dccl::Exception(no_more_bits));
+            reader_->read(num_bits, &out);
+            return out;
+        }
+    }
+
     if(final_child || this->size() < num_bits)
     {
         size_type num_parent_bits = (final_child) ? num_bits : num_bits - this->size();
@@ -35,20 +58,50 @@ dccl::Bitset dccl::Bitset::relinquish_bits(size_type num_bits,
             Bitset parent_bits = parent_->relinquish_bits(num_parent_bits, false);
             append(parent_bits);
         }
+        else if(reader_)
+        {
+            if(reader_->remaining() < num_parent_bits)
+                throw(dccl::Exception(no_more_bits));
+            reader_->read(num_parent_bits, this);
+        }
     }
 
-    Bitset out;
     if(!final_child)
     {
-        for(size_type i = 0; i < num_bits; ++i)
-        {
-            if(this->empty())
-                throw(dccl::Exception("Cannot relinquish_bits - no more bits to give up! Check that all field codecs are always producing (encode) and consuming (decode) the exact same number of bits."));
-            
-            out.push_back(this->front());
-            this->pop_front();
-        }
+        if(this->size() < num_bits)
+            throw(dccl::Exception(no_more_bits));
+
+        // the least significant num_bits go to the child
+        out.words_.assign(words_.begin(), words_.begin() + words_needed(num_bits));
+        out.size_ = num_bits;
+        out.clear_unused_bits();
+        this->shift_and_truncate(num_bits);
     }
     return out;
 }
 
+void dccl::Bitset::skip_more_bits(size_type num_bits)
+{
+    if(parent_)
+    {
+        parent_->discard_bits(num_bits);
+    }
+    else if(reader_)
+    {
+        if(reader_->remaining() < num_bits)
+            throw(dccl::Exception(no_more_bits));
+        reader_->skip(num_bits);
+    }
+    else if(num_bits)
+    {
+        throw(dccl::Exception(no_more_bits));
+    }
+}
+
+void dccl::Bitset::discard_bits(size_type num_bits)
+{
+    const size_type buffered_bits = std::min(num_bits, size());
+    shift_and_truncate(buffered_bits);
+    if(num_bits > buffered_bits)
+        skip_more_bits(num_bits - buffered_bits);
+}
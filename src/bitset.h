@@ -22,27 +22,284 @@
 #ifndef DCCLBITSET20120424H
 #define DCCLBITSET20120424H
 
-#include <deque>
+#include <iterator>
 #include <algorithm>
 #include <limits>
 #include <string>
 #include <cstring>
+#include <cstddef>
+#include <stdexcept>
+#include <ostream>
+
+#include <boost/cstdint.hpp>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
 
 #include "exception.h"
 
+// the packed words can be copied to and from byte strings directly when the host byte order matches the encoded (lsb first) order
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define DCCL_BITSET_LITTLE_ENDIAN
+#endif
+
 namespace dccl
 {
-    /// \brief A variable size container of bits (subclassed from std::deque<bool>) with an optional hierarchy. Similar to set::bitset but can be resized at runtime and has the ability to have parent Bitsets that can give bits to their children.
-    /// 
-    /// This is the class used within DCCL hold the encoded message as it is created. The front() of the deque represents the least significant bit (lsb) and the back() is the most significant bit (msb). DCCL messages are encoded and decoded starting with the  lsb and ending at the msb. The hierarchy is used to represent parent bit pools from which the child can pull more bits from to decode. The top level Bitset represents the entire encoded message, whereas the children are the message fields. 
-    class Bitset : public std::deque<bool>
+    class BitReader;
+    class BitWriter;
+
+    /// \brief A variable size container of bits with an optional hierarchy. Similar to set::bitset but can be resized at runtime and has the ability to have parent Bitsets that can give bits to their children.
+    ///
+    /// This is the class used within DCCL hold the encoded message as it is created. The front() of the container represents the least significant bit (lsb) and the back() is the most significant bit (msb). DCCL messages are encoded and decoded starting with the  lsb and ending at the msb. The hierarchy is used to represent parent bit pools from which the child can pull more bits from to decode. The top level Bitset represents the entire encoded message, whereas the children are the message fields. When decoding, the top level Bitset is typically an empty adapter around a BitReader, so that the bits are read from the encoded bytes in place as the fields request them.
+    ///
+    /// The bits are packed into 64-bit words (bit 0 is the lsb of the first word), so that the logical operations, shifts, comparisons and resizes operate on a whole word at a time. The container interface (push_back(), pop_front(), operator[], iterators, etc.) of the former std::deque<bool> base class is retained; element access returns a Bitset::reference proxy rather than a bool&.
+    ///
+    /// Up to 128 bits are stored inline within the Bitset object, so the short Bitsets created for each field value while encoding and decoding do not allocate memory.
+    class Bitset
     {
       public:
+        /// \brief Storage unit for the packed bits
+        typedef boost::uint64_t word_type;
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef bool value_type;
+        typedef bool const_reference;
+
+        enum { BITS_IN_WORD = 64 };
+
+        /// \brief Proxy for a single (mutable) bit within the Bitset
+        class reference
+        {
+          public:
+            operator bool() const
+            { return (*word_ & mask_) != 0; }
+
+            bool operator~() const
+            { return (*word_ & mask_) == 0; }
+
+            reference& operator=(bool x)
+            {
+                if(x) *word_ |= mask_;
+                else *word_ &= ~mask_;
+                return *this;
+            }
+
+            reference& operator=(const reference& x)
+            { return *this = bool(x); }
+
+            reference& flip()
+            {
+                *word_ ^= mask_;
+                return *this;
+            }
+
+          private:
+            friend class Bitset;
+            reference(word_type* word, word_type mask)
+                : word_(word), mask_(mask)
+            { }
+
+            word_type* word_;
+            word_type mask_;
+        };
+
+      private:
+        /// \brief Random access iterator over the bits (from lsb to msb)
+        template<typename BitsetPtr, typename Ref>
+            class iterator_base
+        {
+          public:
+            typedef std::random_access_iterator_tag iterator_category;
+            typedef bool value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef void pointer;
+            typedef Ref reference;
+
+            iterator_base() : bits_(0), i_(0) { }
+            iterator_base(BitsetPtr bits, size_type i) : bits_(bits), i_(i) { }
+
+            // allow iterator -> const_iterator
+            template<typename OtherPtr, typename OtherRef>
+                iterator_base(const iterator_base<OtherPtr, OtherRef>& other)
+                : bits_(other.bits_), i_(other.i_) { }
+
+            Ref operator*() const { return (*bits_)[i_]; }
+            Ref operator[](difference_type n) const { return (*bits_)[i_ + n]; }
+
+            iterator_base& operator++() { ++i_; return *this; }
+            iterator_base& operator--() { --i_; return *this; }
+            iterator_base operator++(int) { iterator_base tmp(*this); ++i_; return tmp; }
+            iterator_base operator--(int) { iterator_base tmp(*this); --i_; return tmp; }
+            iterator_base& operator+=(difference_type n) { i_ += n; return *this; }
+            iterator_base& operator-=(difference_type n) { i_ -= n; return *this; }
+            iterator_base operator+(difference_type n) const { return iterator_base(bits_, i_ + n); }
+            iterator_base operator-(difference_type n) const { return iterator_base(bits_, i_ - n); }
+            difference_type operator-(const iterator_base& rhs) const
+            { return static_cast<difference_type>(i_) - static_cast<difference_type>(rhs.i_); }
+
+            bool operator==(const iterator_base& rhs) const { return i_ == rhs.i_ && bits_ == rhs.bits_; }
+            bool operator!=(const iterator_base& rhs) const { return !(*this == rhs); }
+            bool operator<(const iterator_base& rhs) const { return i_ < rhs.i_; }
+            bool operator>(const iterator_base& rhs) const { return i_ > rhs.i_; }
+            bool operator<=(const iterator_base& rhs) const { return i_ <= rhs.i_; }
+            bool operator>=(const iterator_base& rhs) const { return i_ >= rhs.i_; }
+
+          private:
+            template<typename OtherPtr, typename OtherRef> friend class iterator_base;
+            BitsetPtr bits_;
+            size_type i_;
+        };
+
+        enum { INLINE_WORDS = 2 };
+
+        /// \brief Word storage with room for INLINE_WORDS words inside the object itself, so that Bitsets of up to 128 bits (nearly every field value) never touch the heap. Larger Bitsets (long strings and bytes, whole messages) spill to a heap buffer.
+        class WordStorage
+        {
+          public:
+            WordStorage()
+                : data_(inline_), size_(0), capacity_(INLINE_WORDS)
+            { }
+
+            WordStorage(size_type n, word_type value)
+                : data_(inline_), size_(0), capacity_(INLINE_WORDS)
+            { resize(n, value); }
+
+            WordStorage(const WordStorage& other)
+                : data_(inline_), size_(0), capacity_(INLINE_WORDS)
+            { assign(other.begin(), other.end()); }
+
+            WordStorage& operator=(const WordStorage& other)
+            {
+                if(this != &other)
+                    assign(other.begin(), other.end());
+                return *this;
+            }
+
+            ~WordStorage()
+            {
+                if(!is_inline())
+                    delete[] data_;
+            }
+
+            size_type size() const { return size_; }
+            bool empty() const { return size_ == 0; }
+            /// \brief True if the words are held in the inline buffer (no heap allocation)
+            bool is_inline() const { return data_ == inline_; }
+
+            word_type& operator[](size_type i) { return data_[i]; }
+            const word_type& operator[](size_type i) const { return data_[i]; }
+            word_type& back() { return data_[size_-1]; }
+
+            word_type* begin() { return data_; }
+            word_type* end() { return data_ + size_; }
+            const word_type* begin() const { return data_; }
+            const word_type* end() const { return data_ + size_; }
+
+            void resize(size_type n, word_type value = 0)
+            {
+                reserve(n);
+                if(n > size_)
+                    std::fill(data_ + size_, data_ + n, value);
+                size_ = n;
+            }
+
+            void push_back(word_type value)
+            {
+                reserve(size_ + 1);
+                data_[size_++] = value;
+            }
+
+            void clear() { size_ = 0; }
+
+            void assign(size_type n, word_type value)
+            {
+                size_ = 0;
+                resize(n, value);
+            }
+
+            void assign(const word_type* first, const word_type* last)
+            {
+                const size_type n = last - first;
+                reserve(n);
+                std::copy(first, last, data_);
+                size_ = n;
+            }
+
+            void swap(WordStorage& other)
+            {
+                if(is_inline() && other.is_inline())
+                {
+                    std::swap_ranges(inline_, inline_ + INLINE_WORDS, other.inline_);
+                }
+                else if(is_inline())
+                {
+                    other.swap(*this);
+                    return;
+                }
+                else if(other.is_inline())
+                {
+                    // hand our heap buffer to other and take its inline words
+                    std::copy(other.inline_, other.inline_ + other.size_, inline_);
+                    other.data_ = data_;
+                    other.capacity_ = capacity_;
+                    data_ = inline_;
+                    capacity_ = INLINE_WORDS;
+                }
+                else
+                {
+                    std::swap(data_, other.data_);
+                    std::swap(capacity_, other.capacity_);
+                }
+                std::swap(size_, other.size_);
+            }
+
+            bool operator==(const WordStorage& other) const
+            { return size_ == other.size_ && std::equal(begin(), end(), other.begin()); }
+
+          private:
+            void reserve(size_type n)
+            {
+                if(n <= capacity_)
+                    return;
+
+                const size_type new_capacity = std::max(n, 2*capacity_);
+                word_type* new_data = new word_type[new_capacity];
+                std::copy(data_, data_ + size_, new_data);
+                if(!is_inline())
+                    delete[] data_;
+                data_ = new_data;
+                capacity_ = new_capacity;
+            }
+
+            word_type inline_[INLINE_WORDS];
+            word_type* data_;
+            size_type size_;
+            size_type capacity_;
+        };
+
+      public:
+        typedef iterator_base<Bitset*, reference> iterator;
+        typedef iterator_base<const Bitset*, bool> const_iterator;
+        typedef std::reverse_iterator<iterator> reverse_iterator;
+        typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
         /// \brief Construct an empty Bitset.
         ///
         /// \param parent Pointer to a bitset that should be consider this Bitset's parent for calls to get_more_bits()
         explicit Bitset(Bitset* parent = 0)
-            : parent_(parent)
+            : size_(0),
+            parent_(parent),
+            reader_(0)
+        { }
+
+        /// \brief Construct an empty Bitset that reads from a buffer of encoded bytes (rather than a parent Bitset) for calls to get_more_bits()
+        ///
+        /// \param reader Cursor into the encoded bytes. Bits given to children of this Bitset are consumed from the reader.
+        explicit Bitset(BitReader* reader)
+            : size_(0),
+            parent_(0),
+            reader_(reader)
         { }
 
         /// \brief Construct a Bitset of a certain initial size and value.
@@ -51,20 +308,118 @@ namespace dccl
         /// \param value Initial value of the bits in this Bitset
         /// \param parent Pointer to a bitset that should be consider this Bitset's parent for calls to get_more_bits()
         explicit Bitset(size_type num_bits, unsigned long value = 0, Bitset* parent = 0)
-            : std::deque<bool>(num_bits, false),
-            parent_(parent)
+            : words_(words_needed(num_bits), 0),
+            size_(num_bits),
+            parent_(parent),
+            reader_(0)
             { from(value, num_bits); }
-        
-        ~Bitset() { } 
+
+        ~Bitset() { }
 
         /// \brief Retrieve more bits from the parent Bitset
         ///
         /// Get (and remove) bits from the little end of the parent bitset and add them to the big end of our bitset,
-        /// (the parent will request from their parent if required).
+        /// (the parent will request from their parent or BitReader if required). Parents that hold no bits pass the request straight through rather than copying the bits.
         /// \param num_bits Number of bits to get.
         /// \throw Exception The parent (and up the hierarchy, if applicable) do not have num_bits to give up.
         void get_more_bits(size_type num_bits);
 
+        /// \brief Skip over bits of the parent Bitset (or BitReader) without retrieving them
+        ///
+        /// Removes the bits that get_more_bits(num_bits) would have added to this Bitset, without copying them (for skipping over fields that are not being decoded).
+        /// \param num_bits Number of bits to skip.
+        /// \throw Exception The parent (and up the hierarchy, if applicable) do not have num_bits to give up.
+        void skip_more_bits(size_type num_bits);
+
+        /// \name Container interface
+        //@{
+
+        /// \brief Number of bits in this Bitset
+        size_type size() const { return size_; }
+        /// \brief Whether this Bitset contains no bits
+        bool empty() const { return size_ == 0; }
+        /// \brief Largest possible Bitset
+        size_type max_size() const { return std::numeric_limits<size_type>::max(); }
+
+        /// \brief Resize the Bitset, filling any new most significant bits with `value`
+        void resize(size_type num_bits, bool value = false)
+        {
+            const size_type old_size = size_;
+            words_.resize(words_needed(num_bits), value ? ~word_type(0) : word_type(0));
+            size_ = num_bits;
+
+            if(value && num_bits > old_size && (old_size % BITS_IN_WORD))
+            {
+                // fill remainder of the previously partial last word
+                words_[old_size / BITS_IN_WORD] |= ~word_type(0) << (old_size % BITS_IN_WORD);
+            }
+            clear_unused_bits();
+        }
+
+        /// \brief Remove all bits (size() == 0)
+        void clear()
+        {
+            words_.clear();
+            size_ = 0;
+        }
+
+        reference operator[](size_type n)
+        { return reference(&words_[n / BITS_IN_WORD], bit_mask(n)); }
+        const_reference operator[](size_type n) const
+        { return (words_[n / BITS_IN_WORD] & bit_mask(n)) != 0; }
+
+        reference at(size_type n)
+        { check_range(n); return (*this)[n]; }
+        const_reference at(size_type n) const
+        { check_range(n); return (*this)[n]; }
+
+        reference front() { return (*this)[0]; }
+        const_reference front() const { return (*this)[0]; }
+        reference back() { return (*this)[size_-1]; }
+        const_reference back() const { return (*this)[size_-1]; }
+
+        /// \brief Add a bit to the most significant end
+        void push_back(bool value)
+        {
+            if(size_ % BITS_IN_WORD == 0)
+                words_.push_back(0);
+            ++size_;
+            (*this)[size_-1] = value;
+        }
+
+        /// \brief Remove the most significant bit
+        void pop_back()
+        { resize(size_-1); }
+
+        /// \brief Add a bit to the least significant end (this moves all the other bits up one place)
+        void push_front(bool value)
+        {
+            resize(size_+1);
+            shift_words_left(words_, &words_, 1);
+            words_[0] |= (value ? 1 : 0);
+        }
+
+        /// \brief Remove the least significant bit (this moves all the other bits down one place)
+        void pop_front()
+        { shift_and_truncate(1); }
+
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, size_); }
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, size_); }
+        reverse_iterator rbegin() { return reverse_iterator(end()); }
+        reverse_iterator rend() { return reverse_iterator(begin()); }
+        const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+        const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+        /// \brief Exchange the contents (but not the parent) of two Bitsets
+        void swap(Bitset& other)
+        {
+            words_.swap(other.words_);
+            std::swap(size_, other.size_);
+        }
+        //@}
+
         /// \brief Logical AND in place
         ///
         /// Apply the result of a logical AND of this Bitset and another to this Bitset.
@@ -75,9 +430,9 @@ namespace dccl
         {
             if(rhs.size() != size())
                 throw(dccl::Exception("Bitset operator&= requires this->size() == rhs.size()"));
-                
-            for (size_type i = 0; i != this->size(); ++i)
-                (*this)[i] = (*this)[i] & rhs[i];
+
+            for (size_type i = 0, n = words_.size(); i != n; ++i)
+                words_[i] &= rhs.words_[i];
             return *this;
         }
 
@@ -92,11 +447,11 @@ namespace dccl
             if(rhs.size() != size())
                 throw(dccl::Exception("Bitset operator|= requires this->size() == rhs.size()"));
 
-            for (size_type i = 0; i != this->size(); ++i)
-                (*this)[i] = (*this)[i] | rhs[i];
+            for (size_type i = 0, n = words_.size(); i != n; ++i)
+                words_[i] |= rhs.words_[i];
             return *this;
         }
-            
+
         /// \brief Logical XOR in place
         ///
         /// Apply the result of a logical XOR of this Bitset and another to this Bitset.
@@ -108,14 +463,14 @@ namespace dccl
             if(rhs.size() != size())
                 throw(dccl::Exception("Bitset operator^= requires this->size() == rhs.size()"));
 
-            for (size_type i = 0; i != this->size(); ++i)
-                (*this)[i] = (*this)[i] ^ rhs[i];
+            for (size_type i = 0, n = words_.size(); i != n; ++i)
+                words_[i] ^= rhs.words_[i];
             return *this;
         }
-            
+
 //            Bitset& operator-=(const Bitset& rhs);
-            
-            
+
+
         /// \brief Left shift in place
         ///
         /// Shifts the Bitset to the left and inserts false (0) to the new least significant bits and discards any bits
@@ -124,14 +479,11 @@ namespace dccl
         /// \return  A reference to the resulting Bitset
         Bitset& operator<<=(size_type n)
         {
-            for(size_type i = 0; i < n; ++i)
-            {
-                push_front(false);
-                pop_back();
-            }
+            shift_words_left(words_, &words_, n);
+            clear_unused_bits();
             return *this;
         }
-               
+
         /// \brief Right shift in place
         ///
         /// Shifts the Bitset to the right and inserts false (0) to the new most significant bits and discards any bits
@@ -140,32 +492,50 @@ namespace dccl
         /// \return  A reference to the resulting Bitset
         Bitset& operator>>=(size_type n)
         {
-            for(size_type i = 0; i < n; ++i)
-            {
-                push_back(false);
-                pop_front();
-            }
+            shift_words_right(words_, &words_, n);
+            return *this;
+        }
+
+        /// \brief Right shift in place, discarding the vacated most significant bits
+        ///
+        /// Equivalent to `*this >>= n; resize(size() - n);`, i.e. removes the `n` least significant bits from the Bitset.
+        /// \param n The number of bits to remove from the little end
+        /// \return  A reference to the resulting Bitset
+        /// \throw Exception n > size()
+        Bitset& shift_and_truncate(size_type n)
+        {
+            if(n > size_)
+                throw(dccl::Exception("Bitset shift_and_truncate requires n <= this->size()"));
+
+            shift_words_right(words_, &words_, n);
+            size_ -= n;
+            words_.resize(words_needed(size_));
             return *this;
         }
-            
+
         /// \brief Left shift
         ///
         /// Same as operator<<=() but does not modify this Bitset.
         Bitset operator<<(size_type n) const
-        {    
-            Bitset copy(*this);
-            copy <<= n;
-            return copy;
+        {
+            Bitset out(parent_);
+            out.words_.resize(words_.size());
+            out.size_ = size_;
+            shift_words_left(words_, &out.words_, n);
+            out.clear_unused_bits();
+            return out;
         }
-            
+
         /// \brief Right shift
         ///
         /// Same as operator>>=() but does not modify this Bitset.
         Bitset operator>>(size_type n) const
         {
-            Bitset copy(*this);
-            copy >>= n;
-            return copy;
+            Bitset out(parent_);
+            out.words_.resize(words_.size());
+            out.size_ = size_;
+            shift_words_right(words_, &out.words_, n);
+            return out;
         }
 
         /// \brief Set a bit to a given value
@@ -178,17 +548,17 @@ namespace dccl
             (*this)[n] = val;
             return *this;
         }
-            
+
         /// \brief Set all bits true
         ///
         /// \return A reference to the resulting Bitset
         Bitset& set()
         {
-            for(iterator it = begin(), n = end(); it != n; ++it)
-                *it = true;
+            std::fill(words_.begin(), words_.end(), ~word_type(0));
+            clear_unused_bits();
             return *this;
         }
-            
+
         /// \brief Reset a bit (i.e. set it to false)
         ///
         /// \param n bit to reset
@@ -201,8 +571,7 @@ namespace dccl
         /// \return A reference to the resulting Bitset
         Bitset& reset()
         {
-            for(iterator it = begin(), n = end(); it != n; ++it)
-                *it = false;
+            std::fill(words_.begin(), words_.end(), word_type(0));
             return *this;
         }
 
@@ -212,30 +581,31 @@ namespace dccl
         /// \return A reference to the resulting Bitset
         Bitset& flip(size_type n)
         { return set(n, !(*this)[n]); }
-            
+
         /// \brief Flip (toggle) all bits
         ///
         /// \return A reference to the resulting Bitset
         Bitset& flip()
         {
-            for(size_type i = 0, n = size(); i < n; ++i)
-                flip(i);
+            for(size_type i = 0, n = words_.size(); i < n; ++i)
+                words_[i] = ~words_[i];
+            clear_unused_bits();
             return *this;
         }
-            
+
         /// \brief Test a bit (return its value)
         ///
         /// \param n bit to test
         /// \return value of the bit
         bool test(size_type n) const
         { return (*this)[n]; }
-            
+
         /* bool any() const; */
         /* bool none() const; */
         /* Bitset operator~() const; */
         /* size_type count() const; */
 
-        
+
 
         /// \brief Sets value of the Bitset to the contents of an integer
         ///
@@ -245,12 +615,8 @@ namespace dccl
             void from(IntType value, size_type num_bits = std::numeric_limits<IntType>::digits)
         {
             this->resize(num_bits);
-            for(int i = 0, n = std::min<size_type>(std::numeric_limits<IntType>::digits, size());
-                i < n; ++i)
-            {
-                if(value & (static_cast<IntType>(1) << i))
-                    (*this)[i] = true;
-            }
+            write_bits(0, std::min<size_type>(std::numeric_limits<IntType>::digits, size()),
+                       static_cast<word_type>(value));
         }
 
         /// \brief Sets value of the Bitset to the contents of an unsigned long integer. Equivalent to from<unsigned long>()
@@ -258,7 +624,7 @@ namespace dccl
         {
             from<unsigned long>(value, num_bits);
         }
-        
+
         /// \brief Returns the value of the Bitset as a integer
         ///
         /// \return Value of the bitset
@@ -269,17 +635,55 @@ namespace dccl
             if(size() > static_cast<size_type>(std::numeric_limits<IntType>::digits))
                 throw(Exception("Type IntType cannot represent current bitset (this->size() > std::numeric_limits<IntType>::digits)"));
 
-            IntType out = 0;
-            for(int i = 0, n = size(); i < n; ++i)
+            return static_cast<IntType>(read_bits(0, size()));
+        }
+
+        /// \brief Returns up to 64 bits as an integer
+        ///
+        /// \param offset Index of the first (least significant) bit to read
+        /// \param num_bits Number of bits to read (<= 64)
+        /// \return The bits [offset, offset+num_bits) in the least significant bits of the result
+        /// \throw Exception num_bits > 64 or the range exceeds size()
+        word_type read_bits(size_type offset, unsigned num_bits) const
+        {
+            check_bits_range(offset, num_bits);
+            if(!num_bits)
+                return 0;
+
+            const size_type i = offset / BITS_IN_WORD;
+            const unsigned shift = offset % BITS_IN_WORD;
+            word_type value = words_[i] >> shift;
+            if(shift + num_bits > BITS_IN_WORD)
+                value |= words_[i+1] << (BITS_IN_WORD - shift);
+            return low_bits(value, num_bits);
+        }
+
+        /// \brief Overwrites up to 64 bits with the contents of an integer
+        ///
+        /// \param offset Index of the first (least significant) bit to write
+        /// \param num_bits Number of bits to write (<= 64)
+        /// \param value Integer whose num_bits least significant bits are written (any higher bits are ignored)
+        /// \throw Exception num_bits > 64 or the range exceeds size()
+        void write_bits(size_type offset, unsigned num_bits, word_type value)
+        {
+            check_bits_range(offset, num_bits);
+            if(!num_bits)
+                return;
+
+            value = low_bits(value, num_bits);
+            const size_type i = offset / BITS_IN_WORD;
+            const unsigned shift = offset % BITS_IN_WORD;
+            const word_type mask = low_bits(~word_type(0), num_bits);
+
+            words_[i] = (words_[i] & ~(mask << shift)) | (value << shift);
+            if(shift + num_bits > BITS_IN_WORD)
             {
-                if((*this)[i])
-                    out |= (static_cast<IntType>(1) << i);
+                const unsigned spill = BITS_IN_WORD - shift;
+                words_[i+1] = (words_[i+1] & ~(mask >> spill)) | (value >> spill);
             }
-                
-            return out;
         }
 
-        
+
         /// \brief Returns the value of the Bitset as an unsigned long integer. Equivalent to to<unsigned long>().
         unsigned long to_ulong() const
         {
@@ -290,13 +694,8 @@ namespace dccl
         std::string to_string() const
         {
             std::string s(size(), 0);
-            int i = 0;
-            for(Bitset::const_reverse_iterator it = rbegin(),
-                    n = rend(); it != n; ++it)
-            {
-                s[i] = (*it) ? '1' : '0';
-                ++i;
-            }
+            for(size_type i = 0, n = size(); i < n; ++i)
+                s[n-i-1] = (*this)[i] ? '1' : '0';
             return s;
         }
 
@@ -311,10 +710,8 @@ namespace dccl
         {
             // number of bytes needed is ceil(size() / 8)
             std::string s(this->size()/8 + (this->size()%8 ? 1 : 0), 0);
-                
-            for(size_type i = 0, n = this->size(); i < n; ++i)
-                s[i/8] |= static_cast<char>((*this)[i] << (i%8));
-                
+            if(!s.empty())
+                copy_whole_bytes(&s[0], s.size());
             return s;
         }
 
@@ -333,12 +730,7 @@ namespace dccl
                 throw std::length_error("max_len must be >= len");
             }
 
-            // initialize buffer to all zeroes
-            std::fill_n(buf, len, 0);
-
-            for(size_type i = 0, n = this->size(); i < n; ++i)
-                buf[i/8] |= static_cast<char>((*this)[i] << (i%8));
-
+            copy_whole_bytes(buf, len);
             return len;
         }
 
@@ -347,7 +739,60 @@ namespace dccl
         /// \param s A string container the values where the least signficant byte in string[0] and the most significant byte in string[size()-1]
         void from_byte_string(const std::string& s)
         {
-            from_byte_stream(s.begin(), s.end());
+            clear();
+            append_bytes(s.data(), s.size());
+        }
+
+        /// \brief Adds `num_bytes` bytes to the big end, where data[0] becomes the least significant byte.
+        ///
+        /// When size() is a multiple of 8 the bytes are copied directly into the packed words; otherwise they are shifted into place a word at a time.
+        /// \param data Bytes to add
+        /// \param num_bytes Number of bytes in data
+        void append_bytes(const char* data, size_type num_bytes)
+        {
+            const size_type offset = size_;
+            resize(size_ + num_bytes * 8);
+
+#ifdef DCCL_BITSET_LITTLE_ENDIAN
+            if(offset % 8 == 0)
+            {
+                if(num_bytes)
+                    std::memcpy(reinterpret_cast<char*>(words_.begin()) + offset / 8, data, num_bytes);
+                return;
+            }
+#endif
+            size_type i = 0;
+            for(; i + BYTES_IN_WORD <= num_bytes; i += BYTES_IN_WORD)
+                write_bits(offset + i * 8, BITS_IN_WORD, load_bytes(data + i, BYTES_IN_WORD));
+            if(i < num_bytes)
+                write_bits(offset + i * 8, static_cast<unsigned>((num_bytes - i) * 8), load_bytes(data + i, num_bytes - i));
+        }
+
+        /// \brief Copies `num_bytes` bytes of the Bitset, starting at bit `offset`, into `buf` (the inverse of append_bytes()).
+        ///
+        /// When offset is a multiple of 8 the bytes are copied directly out of the packed words; otherwise they are shifted out a word at a time.
+        /// \param offset Index of the first bit to copy
+        /// \param buf Output buffer of at least num_bytes bytes
+        /// \param num_bytes Number of bytes to copy
+        /// \throw Exception offset + 8*num_bytes exceeds size()
+        void copy_bytes(size_type offset, char* buf, size_type num_bytes) const
+        {
+            if(offset > size_ || num_bytes > (size_ - offset) / 8)
+                throw(Exception("Bitset copy_bytes range exceeds this->size()"));
+
+#ifdef DCCL_BITSET_LITTLE_ENDIAN
+            if(offset % 8 == 0)
+            {
+                if(num_bytes)
+                    std::memcpy(buf, reinterpret_cast<const char*>(words_.begin()) + offset / 8, num_bytes);
+                return;
+            }
+#endif
+            size_type i = 0;
+            for(; i + BYTES_IN_WORD <= num_bytes; i += BYTES_IN_WORD)
+                store_bytes(read_bits(offset + i * 8, BITS_IN_WORD), buf + i, BYTES_IN_WORD);
+            if(i < num_bytes)
+                store_bytes(read_bits(offset + i * 8, static_cast<unsigned>((num_bytes - i) * 8)), buf + i, num_bytes - i);
         }
 
         /// \brief Sets the value of the Bitset to the contents of a byte string, where each character represents 8 bits of the Bitset.
@@ -357,71 +802,220 @@ namespace dccl
         template<typename CharIterator>
         void from_byte_stream(CharIterator begin, CharIterator end)
         {
-            this->resize(std::distance(begin, end) * 8);
-            int i = 0;
-            for(CharIterator it = begin; it != end; ++it)
-            {
-                for(size_type j = 0; j < 8; ++j)
-                    (*this)[i*8+j] = (*it) & (1 << j);
-                ++i;
-            }
+            const size_type num_bytes = std::distance(begin, end);
+            words_.assign(words_needed(num_bytes * 8), 0);
+            size_ = num_bytes * 8;
+
+            size_type i = 0;
+            for(CharIterator it = begin; it != end; ++it, ++i)
+                words_[i / BYTES_IN_WORD] |= static_cast<word_type>(static_cast<unsigned char>(*it)) << (8*(i % BYTES_IN_WORD));
         }
 
         /// \brief Adds the bitset to the little end
         Bitset& prepend(const Bitset& bits)
         {
-            for(const_reverse_iterator it = bits.rbegin(),
-                    n = bits.rend(); it != n; ++it)
-                push_front(*it);
-
+            Bitset out(bits);
+            out.append(*this);
+            swap(out);
             return *this;
         }
 
         /// \brief Adds the bitset to the big end
         Bitset& append(const Bitset& bits)
         {
-            for(const_iterator it = bits.begin(),
-                    n = bits.end(); it != n; ++it)
-                push_back(*it);                
+            if(&bits == this)
+                return append(Bitset(bits));
+
+            const size_type offset = size_;
+            resize(size_ + bits.size_);
 
+            const size_type first_word = offset / BITS_IN_WORD;
+            const unsigned shift = offset % BITS_IN_WORD;
+            for(size_type i = 0, n = bits.words_.size(); i < n; ++i)
+            {
+                words_[first_word + i] |= bits.words_[i] << shift;
+                if(shift && (first_word + i + 1) < words_.size())
+                    words_[first_word + i + 1] |= bits.words_[i] >> (BITS_IN_WORD - shift);
+            }
             return *this;
         }
-            
-            
-      private:            
+
+
+      private:
+        friend class BitReader;
+        friend class BitWriter;
         Bitset relinquish_bits(size_type num_bits, bool final_child);
-            
-      private:            
+        // removes num_bits from the little end of this Bitset, then from the parent or BitReader if more are needed
+        void discard_bits(size_type num_bits);
+
+        // add the `num_bits` (<= 64) least significant bits of `value` to the big end
+        void append_word(word_type value, unsigned num_bits)
+        {
+            if(!num_bits)
+                return;
+
+            const size_type offset = size_;
+            resize(size_ + num_bits);
+            write_bits(offset, num_bits, value);
+        }
+
+        // the `num_bits` (<= 64) least significant bits of value
+        static word_type low_bits(word_type value, unsigned num_bits)
+        {
+#ifdef __BMI2__
+            return _bzhi_u64(value, num_bits);
+#else
+            return (num_bits < BITS_IN_WORD) ? (value & ((word_type(1) << num_bits) - 1)) : value;
+#endif
+        }
+
+        void check_bits_range(size_type offset, unsigned num_bits) const
+        {
+            if(num_bits > BITS_IN_WORD)
+                throw(Exception("Bitset read_bits/write_bits can access at most 64 bits at a time"));
+            if(offset > size_ || num_bits > size_ - offset)
+                throw(Exception("Bitset read_bits/write_bits range exceeds this->size()"));
+        }
+
+        enum { BYTES_IN_WORD = 8 };
+
+        static size_type words_needed(size_type num_bits)
+        { return (num_bits + BITS_IN_WORD - 1) / BITS_IN_WORD; }
+
+        // funnel shift the words of src toward the msb by n bits into *dest (which must be the same length as src, and may be &src)
+        static void shift_words_left(const WordStorage& src, WordStorage* dest, size_type n)
+        {
+            const size_type num_words = src.size();
+            const size_type word_shift = n / BITS_IN_WORD;
+            const unsigned bit_shift = n % BITS_IN_WORD;
+
+            for(size_type i = num_words; i > 0; --i)
+            {
+                const size_type d = i - 1;
+                word_type w = 0;
+                if(d >= word_shift)
+                {
+                    const size_type s = d - word_shift;
+                    w = src[s] << bit_shift;
+                    if(bit_shift && s > 0)
+                        w |= src[s-1] >> (BITS_IN_WORD - bit_shift);
+                }
+                (*dest)[d] = w;
+            }
+        }
+
+        // funnel shift the words of src toward the lsb by n bits into *dest (which must be the same length as src, and may be &src)
+        static void shift_words_right(const WordStorage& src, WordStorage* dest, size_type n)
+        {
+            const size_type num_words = src.size();
+            const size_type word_shift = n / BITS_IN_WORD;
+            const unsigned bit_shift = n % BITS_IN_WORD;
+
+            for(size_type d = 0; d < num_words; ++d)
+            {
+                word_type w = 0;
+                const size_type s = d + word_shift;
+                if(s < num_words)
+                {
+                    w = src[s] >> bit_shift;
+                    if(bit_shift && s + 1 < num_words)
+                        w |= src[s+1] << (BITS_IN_WORD - bit_shift);
+                }
+                (*dest)[d] = w;
+            }
+        }
+
+        static word_type bit_mask(size_type n)
+        { return word_type(1) << (n % BITS_IN_WORD); }
+
+        // keep the bits past size() in the last word zero so that whole words can be compared
+        void clear_unused_bits()
+        {
+            if(size_ % BITS_IN_WORD)
+                words_.back() &= (word_type(1) << (size_ % BITS_IN_WORD)) - 1;
+        }
+
+        char byte(size_type i) const
+        { return static_cast<char>(words_[i / BYTES_IN_WORD] >> (8*(i % BYTES_IN_WORD))); }
+
+        // copy the first len bytes (which may include the partial last byte, since unused bits are zero)
+        void copy_whole_bytes(char* buf, size_type len) const
+        {
+#ifdef DCCL_BITSET_LITTLE_ENDIAN
+            std::memcpy(buf, reinterpret_cast<const char*>(words_.begin()), len);
+#else
+            for(size_type i = 0; i < len; ++i)
+                buf[i] = byte(i);
+#endif
+        }
+
+        // the `num_bytes` (<= 8) bytes at p as a little-endian word
+        static word_type load_bytes(const char* p, size_type num_bytes)
+        {
+            word_type value = 0;
+#ifdef DCCL_BITSET_LITTLE_ENDIAN
+            std::memcpy(&value, p, num_bytes);
+#else
+            for(size_type i = 0; i < num_bytes; ++i)
+                value |= static_cast<word_type>(static_cast<unsigned char>(p[i])) << (8*i);
+#endif
+            return value;
+        }
+
+        // store the `num_bytes` (<= 8) least significant bytes of value at p, lsb first
+        static void store_bytes(word_type value, char* p, size_type num_bytes)
+        {
+#ifdef DCCL_BITSET_LITTLE_ENDIAN
+            std::memcpy(p, &value, num_bytes);
+#else
+            for(size_type i = 0; i < num_bytes; ++i)
+                p[i] = static_cast<char>(value >> (8*i));
+#endif
+        }
+
+        void check_range(size_type n) const
+        {
+            if(n >= size_)
+                throw std::out_of_range("dccl::Bitset::at: index out of range");
+        }
+
+        friend bool operator==(const Bitset& a, const Bitset& b);
+        friend bool operator<(const Bitset& a, const Bitset& b);
+
+      private:
+        WordStorage words_;
+        size_type size_;
         Bitset* parent_;
+        BitReader* reader_;
 
-            
     };
-    
+
     inline bool operator==(const Bitset& a, const Bitset& b)
     {
-        return (a.size() == b.size()) && std::equal(a.begin(), a.end(), b.begin());
+        return (a.size() == b.size()) && (a.words_ == b.words_);
     }
-        
+
     inline bool operator<(const Bitset& a, const Bitset& b)
     {
-        for(int i = (std::max(a.size(), b.size()) - 1); i >= 0; --i)
+        // unused bits in the last word are always zero, so we can compare whole words
+        for(Bitset::size_type i = std::max(a.words_.size(), b.words_.size()); i > 0; --i)
         {
-            bool a_bit = (i < static_cast<int>(a.size())) ? a[i] : 0;
-            bool b_bit = (i < static_cast<int>(b.size())) ? b[i] : 0;
-                
-            if(a_bit > b_bit) return false;
-            else if(a_bit < b_bit) return true;
+            Bitset::word_type a_word = (i <= a.words_.size()) ? a.words_[i-1] : 0;
+            Bitset::word_type b_word = (i <= b.words_.size()) ? b.words_[i-1] : 0;
+
+            if(a_word > b_word) return false;
+            else if(a_word < b_word) return true;
         }
         return false;
-    }                
-        
+    }
+
     inline Bitset operator&(const Bitset& b1, const Bitset& b2)
     {
         Bitset out(b1);
         out &= b2;
         return out;
     }
-        
+
     inline Bitset operator|(const Bitset& b1, const Bitset& b2)
     {
         Bitset out(b1);
@@ -436,7 +1030,7 @@ namespace dccl
         return out;
     }
 
-        
+
     inline std::ostream& operator<<(std::ostream& os, const Bitset& b)
     {
         return (os << b.to_string());
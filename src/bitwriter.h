@@ -0,0 +1,161 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLBITWRITER20261016H
+#define DCCLBITWRITER20261016H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include <boost/cstdint.hpp>
+
+#include "dccl/bitset.h"
+
+namespace dccl
+{
+    /// \brief An append-only writer of bits into a preallocated byte buffer.
+    ///
+    /// Bits are written in the same order as they are stored by Bitset::to_byte_string(): starting at the least significant bit of the first byte. The buffer is not owned by the BitWriter and is not required to be zeroed beforehand; each byte is overwritten when the first bit is written to it. This allows the encoders to write each field directly to its final position in the encoded message.
+    class BitWriter
+    {
+      public:
+        typedef std::size_t size_type;
+
+        /// \brief Construct a writer into the bytes [begin, end)
+        BitWriter(char* begin, char* end)
+            : data_(reinterpret_cast<unsigned char*>(begin)),
+            capacity_(static_cast<size_type>(end - begin) * BITS_IN_BYTE),
+            pos_(0)
+            { }
+
+        /// \brief Number of bits written so far
+        size_type size() const { return pos_; }
+        /// \brief Number of bytes (partially or fully) written so far
+        size_type byte_size() const { return (pos_ + BITS_IN_BYTE - 1) / BITS_IN_BYTE; }
+        /// \brief Total number of bits that the buffer can hold
+        size_type capacity() const { return capacity_; }
+
+        /// \brief Write the `num_bits` (<= 64) least significant bits of `value`
+        ///
+        /// \throw std::length_error The buffer cannot hold num_bits more bits
+        void write(boost::uint64_t value, unsigned num_bits)
+        {
+            check_capacity(num_bits);
+            while(num_bits)
+            {
+                const unsigned bit_offset = pos_ % BITS_IN_BYTE;
+                const unsigned take = std::min<unsigned>(BITS_IN_BYTE - bit_offset, num_bits);
+                const unsigned char chunk = static_cast<unsigned char>(value & ((1u << take) - 1));
+
+                if(bit_offset == 0)
+                    data_[pos_ / BITS_IN_BYTE] = chunk;
+                else
+                    data_[pos_ / BITS_IN_BYTE] |= chunk << bit_offset;
+
+                value = (take < 64) ? (value >> take) : 0;
+                pos_ += take;
+                num_bits -= take;
+            }
+        }
+
+        /// \brief Write all the bits of a Bitset (from lsb to msb)
+        ///
+        /// \throw std::length_error The buffer cannot hold bits.size() more bits
+        void write(const Bitset& bits)
+        {
+            check_capacity(bits.size());
+            if(pos_ % BITS_IN_BYTE == 0)
+            {
+                // byte aligned: copy the whole bytes straight out of the packed words
+                const size_type num_bytes = bits.size() / BITS_IN_BYTE;
+                bits.copy_whole_bytes(reinterpret_cast<char*>(data_ + pos_ / BITS_IN_BYTE), num_bytes);
+                pos_ += num_bytes * BITS_IN_BYTE;
+                if(const unsigned remainder = bits.size() % BITS_IN_BYTE)
+                    write(bits.read_bits(num_bytes * BITS_IN_BYTE, remainder), remainder);
+                return;
+            }
+
+            for(size_type i = 0, n = bits.words_.size(); i < n; ++i)
+            {
+                const unsigned num_bits = (i + 1 < n || bits.size() % Bitset::BITS_IN_WORD == 0) ?
+                    static_cast<unsigned>(Bitset::BITS_IN_WORD) : bits.size() % Bitset::BITS_IN_WORD;
+                write(bits.words_[i], num_bits);
+            }
+        }
+
+        /// \brief Write `num_bytes` bytes (data[0] first), copying them directly when the writer is byte aligned
+        ///
+        /// \throw std::length_error The buffer cannot hold num_bytes more bytes
+        void write_bytes(const char* data, size_type num_bytes)
+        {
+            check_capacity(num_bytes * BITS_IN_BYTE);
+            if(pos_ % BITS_IN_BYTE == 0)
+            {
+                if(num_bytes)
+                    std::memcpy(data_ + pos_ / BITS_IN_BYTE, data, num_bytes);
+                pos_ += num_bytes * BITS_IN_BYTE;
+                return;
+            }
+
+            for(size_type i = 0; i < num_bytes; i += sizeof(boost::uint64_t))
+            {
+                const size_type chunk = std::min<size_type>(num_bytes - i, sizeof(boost::uint64_t));
+                write(Bitset::load_bytes(data + i, chunk), static_cast<unsigned>(chunk * BITS_IN_BYTE));
+            }
+        }
+
+        /// \brief Write `num_bits` zeros
+        ///
+        /// \throw std::length_error The buffer cannot hold num_bits more bits
+        void write_zeros(size_type num_bits)
+        {
+            check_capacity(num_bits);
+            while(num_bits)
+            {
+                const unsigned chunk = std::min<size_type>(num_bits, Bitset::BITS_IN_WORD);
+                write(0, chunk);
+                num_bits -= chunk;
+            }
+        }
+
+        /// \brief Write zeros up to the next byte boundary (if not already on one)
+        void pad_to_byte()
+        { write_zeros(byte_size() * BITS_IN_BYTE - pos_); }
+
+      private:
+        enum { BITS_IN_BYTE = 8 };
+
+        void check_capacity(size_type num_bits) const
+        {
+            if(num_bits > capacity_ - pos_)
+                throw std::length_error("dccl::BitWriter: buffer is too small for the encoded message");
+        }
+
+      private:
+        unsigned char* data_;
+        size_type capacity_;
+        size_type pos_;
+    };
+}
+
+#endif
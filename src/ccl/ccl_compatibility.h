@@ -69,8 +69,7 @@ namespace dccl
                 {
                     // DCCL message
                     bits->get_more_bits(dccl::DefaultIdentifierCodec::min_size());
-                    (*bits) >>= dccl::BITS_IN_BYTE;
-                    bits->resize(dccl::DefaultIdentifierCodec::min_size());
+                    bits->shift_and_truncate(dccl::BITS_IN_BYTE);
                     return dccl::DefaultIdentifierCodec::decode(bits);
                 }
                 else
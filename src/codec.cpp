@@ -20,6 +20,7 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
 #include <algorithm>
+#include <typeinfo>
 
 #include <dlfcn.h> // for shared library loading
 
@@ -42,6 +43,7 @@
 #include "dccl/codecs2/field_codec_default.h"
 #include "dccl/codecs3/field_codec_default.h"
 #include "dccl/field_codec_id.h"
+#include "dccl/internal/work_stealing.h"
 
 #include "dccl/protobuf/option_extensions.pb.h"
 
@@ -71,18 +73,26 @@ dccl::Codec::Codec(const std::string& dccl_id_codec, const std::string& library_
 
     if(!library_path.empty())
         load_library(library_path);
-    // make sure the id codec exists
-    id_codec();
+    // make sure the id codec exists (and resolve it once)
+    current_id_codec();
 }
 
 dccl::Codec::~Codec()
 {
     for(std::vector<void *>::iterator it = dl_handles_.begin(),
             n = dl_handles_.end(); it != n; ++it)
-    {
         unload_library(*it);
+
+    // codecs removed from the FieldCodecManager live on while the loaded messages, the id codec or this thread's
+    // FieldCodecManager cache refer to them, so let go of these before the libraries' code is unmapped
+    id_table_.clear();
+    large_id_table_.clear();
+    id_codec_state_.reset();
+    FieldCodecManager::release_thread_cache();
+    
+    for(std::vector<void *>::iterator it = dl_handles_.begin(),
+            n = dl_handles_.end(); it != n; ++it)
         dlclose(*it);
-    }
 }
 
     
@@ -151,12 +161,15 @@ void dccl::Codec::set_default_codecs()
     }
 }
 
-void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool header_only, Bitset& head_bits, Bitset& body_bits)
+size_t dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool header_only, BitWriter* writer)
 {
     const Descriptor* desc = msg.GetDescriptor();
 
     dlog.is(DEBUG1, ENCODE) && dlog << "Began encoding message of type: " << desc->full_name() << std::endl;    
 
+    // keeps this call's state apart from that of any call already in progress on this thread
+    internal::CodecContext::Scope context_scope;
+
     try
     {
         size_t head_byte_size = 0;
@@ -164,26 +177,30 @@ void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool hea
         if(!msg.IsInitialized() && !header_only)
             throw(Exception("Message is not properly initialized. All `required` fields must be set."));
         
-        if(!id2desc_.count(id(desc)))
-            throw(Exception("Message id " + boost::lexical_cast<std::string>(id(desc)) + " has not been loaded. Call load() before encoding this type."));
+        const unsigned dccl_id = id(desc);
+        boost::shared_ptr<const LoadedMessage> loaded = loaded_message(dccl_id);
+        if(!loaded)
+            throw(Exception("Message id " + boost::lexical_cast<std::string>(dccl_id) + " has not been loaded. Call load() before encoding this type."));
     
-        
-        
-        boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
-        boost::shared_ptr<internal::FromProtoCppTypeBase> helper = internal::TypeHelper::find(desc);
+        const bool is_loaded_type = (loaded->desc == desc);
+        boost::shared_ptr<FieldCodecBase> codec = is_loaded_type ? loaded->codec : FieldCodecManager::find(desc);
 
         if(codec)
         {
             //fixed header
-            id_codec()->field_encode(&head_bits, id(desc), 0);
+            id_codec()->field_encode(writer, dccl_id, 0);
             
             internal::MessageStack msg_stack;
             msg_stack.push(msg.GetDescriptor());
-            codec->base_encode(&head_bits, msg, HEAD);
+
+            GeneratedMessageCodec* generated = is_loaded_type ? loaded->sizes.generated.get() : 0;
+            if(!generated || !generated->encode(writer, msg, HEAD))
+                codec->base_encode(writer, msg, HEAD);
 
             // given header of not even byte size (e.g. 01011), make even byte size (e.g. 00001011)
-            head_byte_size = ceil_bits2bytes(head_bits.size());
-            head_bits.resize(head_byte_size * BITS_IN_BYTE);
+            dlog.is(DEBUG2, ENCODE) && dlog << "Head bytes (bits): " << writer->byte_size() << "(" << writer->size() << ")" << std::endl;
+            writer->pad_to_byte();
+            head_byte_size = writer->byte_size();
 
             if(header_only)
             {
@@ -191,14 +208,23 @@ void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool hea
             }
             else
             {
-                codec->base_encode(&body_bits, msg, BODY);
+                if(!generated || !generated->encode(writer, msg, BODY))
+                    codec->base_encode(writer, msg, BODY);
+                dlog.is(DEBUG2, ENCODE) && dlog << "Body bytes (bits): " << writer->byte_size() - head_byte_size << "(" << writer->size() - head_byte_size*BITS_IN_BYTE << ")" << std::endl;
             }
         }
         else
         {
             throw(Exception("Failed to find (dccl.msg).codec `" + desc->options().GetExtension(dccl::msg).codec() + "`"));
         }
-        
+
+        return head_byte_size;
+    }
+    catch(std::length_error& e)
+    {
+        // output buffer is too small, pass this on to the caller of encode()
+        dlog.is(DEBUG1, ENCODE) && dlog << "Message " << desc->full_name() << " failed to encode. Reason: " << e.what() << std::endl;
+        throw;
     }
     catch(std::exception& e)
     {
@@ -214,36 +240,21 @@ void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool hea
 size_t dccl::Codec::encode(char* bytes, size_t max_len, const google::protobuf::Message& msg, bool header_only /* = false */)
 {
     const Descriptor* desc = msg.GetDescriptor();
-    Bitset head_bits;
-    Bitset body_bits;
-    encode_internal(msg, header_only, head_bits, body_bits);
 
-    size_t head_byte_size = ceil_bits2bytes(head_bits.size());
-    if (max_len < head_byte_size)
-    {
-        throw std::length_error("max_len must be >= head_byte_size");
-    }
-    head_bits.to_byte_string(bytes, head_byte_size);
+    // fields are written directly into `bytes`
+    BitWriter writer(bytes, bytes + max_len);
+    size_t head_byte_size = encode_internal(msg, header_only, &writer);
 
-    dlog.is(DEBUG2, ENCODE) && dlog << "Head bytes (bits): " << head_byte_size << "(" << head_bits.size() << ")" << std::endl;
-    dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Head (bin): " << head_bits << std::endl;
     dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Head (hex): " << hex_encode(bytes, bytes+head_byte_size) << std::endl;
 
     size_t body_byte_size = 0;
     if (!header_only)
     {
-        body_byte_size = ceil_bits2bytes(body_bits.size());
-        if (max_len < (head_byte_size + body_byte_size))
-        {
-            throw std::length_error("max_len must be >= (head_byte_size + body_byte_size)");
-        }
-        body_bits.to_byte_string(bytes+head_byte_size, max_len-head_byte_size);
+        body_byte_size = writer.byte_size() - head_byte_size;
 
-        dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Body (bin): " << body_bits << std::endl;
         dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Body (hex): " << hex_encode(bytes+head_byte_size, bytes+head_byte_size+body_byte_size) << std::endl;
-        dlog.is(DEBUG2, ENCODE) && dlog << "Body bytes (bits): " <<  body_byte_size << "(" << body_bits.size() << ")" <<  std::endl;
 
-        if(!crypto_key_.empty() && !skip_crypto_ids_.count(id(desc))) {
+        if(!crypto_key_.empty() && !loaded_message(id(desc))->skip_crypto) {
             std::string head_bytes(bytes, bytes+head_byte_size);
             std::string body_bytes(bytes+head_byte_size, bytes+head_byte_size+body_byte_size);
             encrypt(&body_bytes, head_bytes);
@@ -262,33 +273,12 @@ size_t dccl::Codec::encode(char* bytes, size_t max_len, const google::protobuf::
 void dccl::Codec::encode(std::string* bytes, const google::protobuf::Message& msg, bool header_only /* = false */)
 {
     const Descriptor* desc = msg.GetDescriptor();
-    Bitset head_bits;
-    Bitset body_bits;
-    encode_internal(msg, header_only, head_bits, body_bits);
-
-    std::string head_bytes = head_bits.to_byte_string();
-
-    dlog.is(DEBUG2, ENCODE) && dlog << "Head bytes (bits): " << head_bytes.size() << "(" << head_bits.size() << ")" << std::endl;
-    dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Head (bin): " << head_bits << std::endl;
-    dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Head (hex): " << hex_encode(head_bytes) << std::endl;
-
-    std::string body_bytes;
-    if (!header_only)
-    {
-        body_bytes = body_bits.to_byte_string();
-
-        dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Body (bin): " << body_bits << std::endl;
-        dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Body (hex): " << hex_encode(body_bytes) << std::endl;
-        dlog.is(DEBUG2, ENCODE) && dlog << "Body bytes (bits): " <<  body_bytes.size() << "(" << body_bits.size() << ")" <<  std::endl;
-
-        if(!crypto_key_.empty() && !skip_crypto_ids_.count(id(desc)))
-            encrypt(&body_bytes, head_bytes);
-
-        dlog.is(logger::DEBUG3, logger::ENCODE) && dlog << "Encrypted Body (hex): " << hex_encode(body_bytes) << std::endl;
-    }
+    
+    // (dccl.msg).max_bytes is an upper bound on the encoded size of any loaded message
+    std::string buffer(desc->options().GetExtension(dccl::msg).max_bytes(), '\0');
+    size_t size = encode(buffer.empty() ? 0 : &buffer[0], buffer.size(), msg, header_only);
 
-    dlog.is(DEBUG1, ENCODE) && dlog << "Successfully encoded message of type: " << desc->full_name() << std::endl;
-    *bytes += head_bytes + body_bytes;
+    bytes->append(buffer, 0, size);
 }
 
 unsigned dccl::Codec::id(const std::string& bytes)
@@ -299,9 +289,9 @@ unsigned dccl::Codec::id(const std::string& bytes)
 
 void dccl::Codec::decode(std::string* bytes, google::protobuf::Message* msg)
 {
-    decode(*bytes, msg);
-    unsigned last_size = size(*msg);
-    bytes->erase(0, last_size);
+    // the end of the message is found while decoding it, so there is no need to size it again
+    std::string::iterator actual_end = decode(bytes->begin(), bytes->end(), msg);
+    bytes->erase(bytes->begin(), actual_end);
 }
 
 void dccl::Codec::decode(const std::string& bytes, google::protobuf::Message* msg, bool header_only /* = false */)
@@ -309,12 +299,155 @@ void dccl::Codec::decode(const std::string& bytes, google::protobuf::Message* ms
     decode(bytes.begin(), bytes.end(), msg, header_only);
 }
 
+void dccl::Codec::decode(const std::string& bytes, google::protobuf::Message* msg, const FieldMask& mask)
+{
+    decode_internal(bytes.begin(), bytes.end(), msg, false, &mask);
+}
+
+std::size_t dccl::Codec::encode_batch(const std::vector<const google::protobuf::Message*>& msgs,
+                                      std::vector<std::string>* bytes,
+                                      unsigned num_threads /* = 0 */,
+                                      std::vector<std::string>* errors /* = 0 */)
+{
+    // each thread only writes to its own elements of these
+    bytes->assign(msgs.size(), std::string());
+    std::vector<std::string> failures(msgs.size());
+    
+    internal::parallel_for(msgs.size(), num_threads, [&](std::size_t i)
+        {
+            try
+            {
+                encode(&(*bytes)[i], *msgs[i]);
+            }
+            catch(std::exception& e)
+            {
+                (*bytes)[i].clear();
+                failures[i] = e.what();
+                // an empty what() would look like success
+                if(failures[i].empty()) failures[i] = "unknown error";
+            }
+        });
+
+    std::size_t failed = msgs.size() - std::count(failures.begin(), failures.end(), std::string());
+    if(errors) errors->swap(failures);
+    return failed;
+}
+
+std::size_t dccl::Codec::decode_batch(const std::vector<std::string>& bytes,
+                                      std::vector<boost::shared_ptr<google::protobuf::Message> >* msgs,
+                                      unsigned num_threads /* = 0 */,
+                                      std::vector<std::string>* errors /* = 0 */)
+{
+    // each thread only writes to its own elements of these
+    msgs->assign(bytes.size(), boost::shared_ptr<google::protobuf::Message>());
+    std::vector<std::string> failures(bytes.size());
+    
+    internal::parallel_for(bytes.size(), num_threads, [&](std::size_t i)
+        {
+            try
+            {
+                (*msgs)[i] = decode<boost::shared_ptr<google::protobuf::Message> >(bytes[i]);
+            }
+            catch(std::exception& e)
+            {
+                (*msgs)[i].reset();
+                failures[i] = e.what();
+                if(failures[i].empty()) failures[i] = "unknown error";
+            }
+        });
+
+    std::size_t failed = bytes.size() - std::count(failures.begin(), failures.end(), std::string());
+    if(errors) errors->swap(failures);
+    return failed;
+}
+
+namespace dccl
+{
+    // the value of an unset (non-repeated, non-message) field, as the field codecs would decode it
+    static boost::any default_field_value(const google::protobuf::FieldDescriptor* field)
+    {
+        using google::protobuf::FieldDescriptor;
+        switch(field->cpp_type())
+        {
+            case FieldDescriptor::CPPTYPE_DOUBLE: return field->default_value_double();
+            case FieldDescriptor::CPPTYPE_FLOAT: return field->default_value_float();
+            case FieldDescriptor::CPPTYPE_INT32: return field->default_value_int32();
+            case FieldDescriptor::CPPTYPE_INT64: return field->default_value_int64();
+            case FieldDescriptor::CPPTYPE_UINT32: return field->default_value_uint32();
+            case FieldDescriptor::CPPTYPE_UINT64: return field->default_value_uint64();
+            case FieldDescriptor::CPPTYPE_BOOL: return field->default_value_bool();
+            case FieldDescriptor::CPPTYPE_ENUM: return field->default_value_enum();
+            case FieldDescriptor::CPPTYPE_STRING: return field->default_value_string();
+            default: return boost::any();
+        }
+    }
+}
+
+boost::any dccl::Codec::decode_field_value(const std::string& bytes, const std::string& field_name)
+{
+    // keeps this call's state apart from that of any call already in progress on this thread
+    internal::CodecContext::Scope context_scope;
+
+    unsigned this_id = peek_id(bytes.data(), bytes.size());
+    
+    boost::shared_ptr<const LoadedMessage> loaded = loaded_message(this_id);
+    if(!loaded)
+        throw(Exception("Message id " + boost::lexical_cast<std::string>(this_id) + " has not been loaded. Call load() before decoding this type."));
+
+    const Descriptor* desc = loaded->desc;
+    const FieldDescriptor* field = desc->FindFieldByName(field_name);
+    if(!field)
+        throw(Exception("Message " + desc->full_name() + " has no field named `" + field_name + "`"));
+    if(field->is_repeated() || field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE)
+        throw(Exception("Field `" + field_name + "` of message " + desc->full_name() + " cannot be decoded on its own: only non-repeated, non-message fields can be"));
+
+    std::map<std::string, internal::FixedLayoutField>::const_iterator it = loaded->fixed_fields.find(field_name);
+    if(it == loaded->fixed_fields.end())
+        throw(Exception("Field `" + field_name + "` of message " + desc->full_name() + " cannot be decoded on its own as it is not always encoded at the same position (it follows a variable size field). Decode the entire message instead."));
+    const internal::FixedLayoutField& fixed_field = it->second;
+
+    const char* data = bytes.data();
+    const size_t head_size_bytes = std::min<size_t>(ceil_bits2bytes(loaded->sizes.id_bits + loaded->sizes.head_max_bits), bytes.size());
+
+    const char* part_begin = data;
+    const char* part_end = data + head_size_bytes;
+    unsigned skip_bits = loaded->sizes.id_bits + fixed_field.offset;
+    std::string body_bytes;
+    if(fixed_field.part == BODY)
+    {
+        part_begin = data + head_size_bytes;
+        part_end = data + bytes.size();
+        skip_bits = fixed_field.offset;
+        
+        if(!crypto_key_.empty() && !loaded->skip_crypto)
+        {
+            std::string head_bytes(data, data + head_size_bytes);
+            body_bytes.assign(part_begin, part_end);
+            decrypt(&body_bytes, head_bytes);
+            part_begin = body_bytes.data();
+            part_end = part_begin + body_bytes.size();
+        }
+    }
+    
+    BitReader reader(part_begin, part_end);
+    reader.skip(skip_bits);
+    Bitset bits(&reader);
+
+    boost::any value;
+    fixed_field.codec->base_decode_field(&bits, &value, desc, field, fixed_field.part);
+    
+    return value.empty() ? default_field_value(field) : value;
+}
+
 // makes sure we can actual encode / decode a message of this descriptor given the loaded FieldCodecs
 // checks all bounds on the message
 void dccl::Codec::load(const google::protobuf::Descriptor* desc)
 {    
     try
     {
+        // `desc` (or its fields) may be new descriptors at the addresses of destroyed ones
+        FieldCodecManager::invalidate_descriptors();
+        
         if(!desc->options().GetExtension(dccl::msg).has_id())
             throw(Exception("Missing message option `(dccl.msg).id`. Specify a unique id (e.g. 3) in the body of your .proto message using \"option (dccl.msg).id = 3\""));
         if(!desc->options().GetExtension(dccl::msg).has_max_bytes())
@@ -326,15 +459,9 @@ void dccl::Codec::load(const google::protobuf::Descriptor* desc)
         boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
 
         unsigned dccl_id = id(desc);
-        unsigned head_size_bits, body_size_bits;
-        codec->base_max_size(&head_size_bits, desc, HEAD);
-        codec->base_max_size(&body_size_bits, desc, BODY);
-
-        unsigned id_bits = 0;
-        id_codec()->field_size(&id_bits, dccl_id, 0);
-        head_size_bits += id_bits;
+        MessageSizes message_sizes = compute_sizes(desc, dccl_id);
         
-        const unsigned byte_size = ceil_bits2bytes(head_size_bits) + ceil_bits2bytes(body_size_bits);
+        const unsigned byte_size = ceil_bits2bytes(message_sizes.head_max_bits + message_sizes.id_bits) + ceil_bits2bytes(message_sizes.body_max_bits);
 
         if(byte_size > desc->options().GetExtension(dccl::msg).max_bytes())
             throw(Exception("Actual maximum size of message exceeds allowed maximum (dccl.max_bytes). Tighten bounds, remove fields, improve codecs, or increase the allowed dccl.max_bytes"));
@@ -347,6 +474,16 @@ void dccl::Codec::load(const google::protobuf::Descriptor* desc)
         else
             id2desc_.insert(std::make_pair(id(desc), desc));
 
+        boost::shared_ptr<LoadedMessage> loaded(new LoadedMessage);
+        loaded->desc = desc;
+        loaded->codec = codec;
+        loaded->sizes = message_sizes;
+        loaded->skip_crypto = skip_crypto_ids_.count(dccl_id);
+        loaded->prototype = DynamicProtobufManager::msg_factory().GetPrototype(desc);
+        compute_fixed_layout(loaded.get());
+
+        loaded_message_entry(dccl_id).set(loaded);
+
         dlog.is(DEBUG1) && dlog << "Successfully validated message of type: " << desc->full_name() << std::endl;
 
     }
@@ -370,10 +507,17 @@ void dccl::Codec::load(const google::protobuf::Descriptor* desc)
 
 void dccl::Codec::unload(const google::protobuf::Descriptor* desc)
 {
+    // `desc` may be destroyed after this
+    FieldCodecManager::invalidate_descriptors();
+
     unsigned dccl_id = id(desc);
     if(id2desc_.count(dccl_id)) 
     {
         id2desc_.erase(dccl_id);
+        if(dccl_id < MAX_TABLE_ID)
+            id_table_[dccl_id].reset();
+        else
+            large_id_table_.erase(dccl_id);
     }
     else
     {
@@ -385,20 +529,37 @@ void dccl::Codec::unload(const google::protobuf::Descriptor* desc)
 
 unsigned dccl::Codec::size(const google::protobuf::Message& msg)
 {
+    // keeps this call's state apart from that of any call already in progress on this thread
+    internal::CodecContext::Scope context_scope;
+
     const Descriptor* desc = msg.GetDescriptor();
 
-    boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
-    
     unsigned dccl_id = id(desc);
-    unsigned head_size_bits;
-    codec->base_size(&head_size_bits, msg, HEAD);
+    boost::shared_ptr<const LoadedMessage> loaded = loaded_message(dccl_id);
+    // loaded messages have their codec and sizes precomputed
+    const MessageSizes* loaded_sizes = (loaded && loaded->desc == desc) ? &loaded->sizes : 0;
+    
+    boost::shared_ptr<FieldCodecBase> codec = loaded_sizes ? loaded->codec : FieldCodecManager::find(desc);
+    GeneratedMessageCodec* generated = loaded_sizes ? loaded_sizes->generated.get() : 0;
+    
+    unsigned head_size_bits = 0;
+    if(loaded_sizes && loaded_sizes->head_min_bits == loaded_sizes->head_max_bits)
+        head_size_bits = loaded_sizes->head_max_bits;
+    else if(!generated || !generated->size(&head_size_bits, msg, HEAD))
+        codec->base_size(&head_size_bits, msg, HEAD);
 
     unsigned id_bits = 0;
-    id_codec()->field_size(&id_bits, dccl_id, 0);
+    if(loaded_sizes)
+        id_bits = loaded_sizes->id_bits;
+    else
+        id_codec()->field_size(&id_bits, dccl_id, 0);
     head_size_bits += id_bits;
     
-    unsigned body_size_bits;
-    codec->base_size(&body_size_bits, msg, BODY);
+    unsigned body_size_bits = 0;
+    if(loaded_sizes && loaded_sizes->body_min_bits == loaded_sizes->body_max_bits)
+        body_size_bits = loaded_sizes->body_max_bits;
+    else if(!generated || !generated->size(&body_size_bits, msg, BODY))
+        codec->base_size(&body_size_bits, msg, BODY);
 
     const unsigned head_size_bytes = ceil_bits2bytes(head_size_bits);
     const unsigned body_size_bytes = ceil_bits2bytes(body_size_bits);
@@ -406,41 +567,291 @@ unsigned dccl::Codec::size(const google::protobuf::Message& msg)
 }
 
 unsigned dccl::Codec::max_size(const google::protobuf::Descriptor* desc) const
+{
+    const MessageSizes message_sizes = sizes(desc, id(desc));
+
+    unsigned id_min_bits = 0, id_max_bits = 0;
+    id_sizes(&id_min_bits, &id_max_bits);
+
+    const unsigned head_size_bytes = ceil_bits2bytes(message_sizes.head_max_bits + id_max_bits);
+    const unsigned body_size_bytes = ceil_bits2bytes(message_sizes.body_max_bits);
+    return head_size_bytes + body_size_bytes;
+}
+
+unsigned dccl::Codec::min_size(const google::protobuf::Descriptor* desc) const
+{
+    const MessageSizes message_sizes = sizes(desc, id(desc));
+
+    unsigned id_min_bits = 0, id_max_bits = 0;
+    id_sizes(&id_min_bits, &id_max_bits);
+
+    const unsigned head_size_bytes = ceil_bits2bytes(message_sizes.head_min_bits + id_min_bits);
+    const unsigned body_size_bytes = ceil_bits2bytes(message_sizes.body_min_bits);
+    return head_size_bytes + body_size_bytes;
+}
+
+dccl::Codec::MessageSizes dccl::Codec::compute_sizes(const google::protobuf::Descriptor* desc, int32 dccl_id) const
 {
     boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
 
-    unsigned head_size_bits;
-    codec->base_max_size(&head_size_bits, desc, HEAD);
+    MessageSizes message_sizes;
+    message_sizes.desc = desc;
+    message_sizes.generation = FieldCodecManager::generation();
 
-    unsigned id_bits = 0;
-    id_codec()->field_max_size(&id_bits, 0);
-    head_size_bits += id_bits;
+    message_sizes.id_bits = 0;
+    id_codec()->field_size(&message_sizes.id_bits, static_cast<uint32>(dccl_id), 0);
+
+    codec->base_max_size(&message_sizes.head_max_bits, desc, HEAD);
+    codec->base_min_size(&message_sizes.head_min_bits, desc, HEAD);
+    codec->base_max_size(&message_sizes.body_max_bits, desc, BODY);
+    codec->base_min_size(&message_sizes.body_min_bits, desc, BODY);
+
+    message_sizes.generated = find_generated_codec(message_sizes);
     
-    unsigned body_size_bits;
-    codec->base_max_size(&body_size_bits, desc, BODY);
+    return message_sizes;
+}
 
-    const unsigned head_size_bytes = ceil_bits2bytes(head_size_bits);
-    const unsigned body_size_bytes = ceil_bits2bytes(body_size_bits);
-    return head_size_bytes + body_size_bytes;
+namespace dccl
+{
+    // whether the fields of `desc` are all encoded by the built-in DCCL3 default codecs
+    static bool uses_default_v3_codecs(const google::protobuf::Descriptor* desc, const std::string& codec_group)
+    {
+        using google::protobuf::FieldDescriptor;
+        for(int i = 0, n = desc->field_count(); i < n; ++i)
+        {
+            const FieldDescriptor* field = desc->field(i);
+            const internal::FieldOptionsSnapshot& options = internal::FieldOptionsSnapshot::find(field);
+            if(options.omit)
+                continue;
+            if(options.has_codec)
+                return false;
+
+            boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(field, true, codec_group);
+            const FieldCodecBase& c = *codec;
+            bool is_default = false;
+            switch(field->cpp_type())
+            {
+                case FieldDescriptor::CPPTYPE_DOUBLE: is_default = typeid(c) == typeid(v3::DefaultNumericFieldCodec<double>); break;
+                case FieldDescriptor::CPPTYPE_FLOAT: is_default = typeid(c) == typeid(v3::DefaultNumericFieldCodec<float>); break;
+                case FieldDescriptor::CPPTYPE_INT32: is_default = typeid(c) == typeid(v3::DefaultNumericFieldCodec<int32>); break;
+                case FieldDescriptor::CPPTYPE_INT64: is_default = typeid(c) == typeid(v3::DefaultNumericFieldCodec<int64>); break;
+                case FieldDescriptor::CPPTYPE_UINT32: is_default = typeid(c) == typeid(v3::DefaultNumericFieldCodec<uint32>); break;
+                case FieldDescriptor::CPPTYPE_UINT64: is_default = typeid(c) == typeid(v3::DefaultNumericFieldCodec<uint64>); break;
+                case FieldDescriptor::CPPTYPE_BOOL: is_default = typeid(c) == typeid(v3::DefaultBoolCodec); break;
+                case FieldDescriptor::CPPTYPE_ENUM: is_default = typeid(c) == typeid(v3::DefaultEnumCodec); break;
+                case FieldDescriptor::CPPTYPE_STRING:
+                    is_default = field->type() == FieldDescriptor::TYPE_BYTES ?
+                        typeid(c) == typeid(v3::DefaultBytesCodec) : typeid(c) == typeid(v3::DefaultStringCodec);
+                    break;
+                case FieldDescriptor::CPPTYPE_MESSAGE:
+                    is_default = typeid(c) == typeid(v3::DefaultMessageCodec) &&
+                        uses_default_v3_codecs(field->message_type(), codec_group);
+                    break;
+            }
+            if(!is_default)
+                return false;
+        }
+        return true;
+    }
 }
 
-unsigned dccl::Codec::min_size(const google::protobuf::Descriptor* desc) const
+namespace dccl
 {
+    // storage for Codec::generated_codecs(); constructed on first use as generated code registers its codecs during static initialization
+    static std::mutex& generated_codecs_mutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+    
+    // only accessed with generated_codecs_mutex() held
+    static boost::shared_ptr<const std::map<std::string, boost::shared_ptr<GeneratedMessageCodec> > >& generated_codecs_registry()
+    {
+        static boost::shared_ptr<const std::map<std::string, boost::shared_ptr<GeneratedMessageCodec> > > registry(new std::map<std::string, boost::shared_ptr<GeneratedMessageCodec> >);
+        return registry;
+    }
+}
+
+boost::shared_ptr<const dccl::Codec::GeneratedCodecs> dccl::Codec::generated_codecs()
+{
+    std::lock_guard<std::mutex> lock(generated_codecs_mutex());
+    return generated_codecs_registry();
+}
+
+template<typename Modify>
+void dccl::Codec::modify_generated_codecs(Modify modify)
+{
+    std::lock_guard<std::mutex> lock(generated_codecs_mutex());
+    boost::shared_ptr<GeneratedCodecs> codecs(new GeneratedCodecs(*generated_codecs_registry()));
+    modify(codecs.get());
+    generated_codecs_registry() = codecs;
+}
+
+void dccl::Codec::add_generated_codec(const std::string& message_name, boost::shared_ptr<GeneratedMessageCodec> codec)
+{
+    modify_generated_codecs([&](GeneratedCodecs* codecs) { (*codecs)[message_name] = codec; });
+}
+
+void dccl::Codec::remove_generated_codec(const std::string& message_name)
+{
+    modify_generated_codecs([&](GeneratedCodecs* codecs) { codecs->erase(message_name); });
+}
+
+boost::shared_ptr<dccl::GeneratedMessageCodec> dccl::Codec::find_generated_codec(const MessageSizes& message_sizes) const
+{
+    const google::protobuf::Descriptor* desc = message_sizes.desc;
+
+    // our own reference, so the codecs may be replaced meanwhile
+    boost::shared_ptr<const GeneratedCodecs> codecs = generated_codecs();
+    GeneratedCodecs::const_iterator it = codecs->find(desc->full_name());
+    if(it == codecs->end())
+        return boost::shared_ptr<GeneratedMessageCodec>();
+
+    // generated code is only valid as long as it is equivalent to the codecs that would otherwise be used
+    const DCCLMessageOptions& msg_options = desc->options().GetExtension(dccl::msg);
+    const std::string codec_group = FieldCodecBase::codec_group(desc);
     boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
+    GeneratedMessageCodec& generated = *it->second;
+    if(msg_options.codec_version() != 3 ||
+       codec_group != Codec::default_codec_name(3) ||
+       typeid(*codec) != typeid(v3::DefaultMessageCodec) ||
+       !uses_default_v3_codecs(desc, codec_group) ||
+       generated.max_size(HEAD) != message_sizes.head_max_bits ||
+       generated.min_size(HEAD) != message_sizes.head_min_bits ||
+       generated.max_size(BODY) != message_sizes.body_max_bits ||
+       generated.min_size(BODY) != message_sizes.body_min_bits)
+    {
+        dlog.is(DEBUG1) && dlog << "Not using the generated codec for " << desc->full_name() << " as it does not match the codecs configured for this message" << std::endl;
+        return boost::shared_ptr<GeneratedMessageCodec>();
+    }
+
+    return it->second;
+}
 
-    unsigned head_size_bits;
-    codec->base_min_size(&head_size_bits, desc, HEAD);
+dccl::GeneratedMessageCodec* dccl::Codec::loaded_generated_codec(const google::protobuf::Descriptor* desc) const
+{
+    boost::shared_ptr<const LoadedMessage> loaded = loaded_message(id(desc));
+    return (loaded && loaded->desc == desc) ? loaded->sizes.generated.get() : 0;
+}
 
-    unsigned id_bits = 0;
-    id_codec()->field_min_size(&id_bits, 0);
-    head_size_bits += id_bits;
+dccl::Codec::MessageSizes dccl::Codec::sizes(const google::protobuf::Descriptor* desc, int32 dccl_id) const
+{
+    boost::shared_ptr<const LoadedMessage> loaded = loaded_message(dccl_id);
+    if(loaded && loaded->desc == desc)
+        return loaded->sizes;
+    else
+        return compute_sizes(desc, dccl_id);
+}
+
+dccl::internal::Snapshot<dccl::Codec::LoadedMessage>& dccl::Codec::loaded_message_entry(int32 dccl_id)
+{
+    if(dccl_id >= 0 && dccl_id < MAX_TABLE_ID)
+    {
+        if(static_cast<size_t>(dccl_id) >= id_table_.size())
+            id_table_.resize(dccl_id + 1);
+        return id_table_[dccl_id];
+    }
+    else
+    {
+        return large_id_table_[dccl_id];
+    }
+}
+
+void dccl::Codec::set_skip_crypto(internal::Snapshot<LoadedMessage>* slot, bool skip_crypto)
+{
+    boost::shared_ptr<const LoadedMessage> current = slot->get();
+    if(!current || current->skip_crypto == skip_crypto)
+        return;
     
-    unsigned body_size_bits;
-    codec->base_min_size(&body_size_bits, desc, BODY);
+    boost::shared_ptr<LoadedMessage> loaded(new LoadedMessage(*current));
+    loaded->skip_crypto = skip_crypto;
+    slot->set(loaded);
+}
 
-    const unsigned head_size_bytes = ceil_bits2bytes(head_size_bits);
-    const unsigned body_size_bytes = ceil_bits2bytes(body_size_bits);
-    return head_size_bytes + body_size_bytes;
+boost::shared_ptr<const dccl::Codec::LoadedMessage> dccl::Codec::refresh(internal::Snapshot<LoadedMessage>* slot) const
+{
+    std::lock_guard<std::recursive_mutex> lock(refresh_mutex_);
+
+    // another thread may have just refreshed it
+    boost::shared_ptr<const LoadedMessage> current = slot->get();
+    if(current->sizes.generation == FieldCodecManager::generation())
+        return current;
+    
+    boost::shared_ptr<LoadedMessage> loaded(new LoadedMessage(*current));
+    loaded->codec = FieldCodecManager::find(loaded->desc);
+    loaded->sizes = compute_sizes(loaded->desc, id(loaded->desc));
+    compute_fixed_layout(loaded.get());
+    slot->set(loaded);
+    return loaded;
+}
+
+void dccl::Codec::compute_fixed_layout(LoadedMessage* loaded) const
+{
+    std::vector<internal::FixedLayoutField> layout;
+    loaded->codec->base_fixed_layout(&layout, loaded->desc, HEAD);
+    loaded->codec->base_fixed_layout(&layout, loaded->desc, BODY);
+
+    loaded->fixed_fields.clear();
+    for(std::vector<internal::FixedLayoutField>::const_iterator it = layout.begin(), end = layout.end(); it != end; ++it)
+        loaded->fixed_fields.insert(std::make_pair(it->field->name(), *it));
+}
+
+void dccl::Codec::id_sizes(unsigned* id_min_bits, unsigned* id_max_bits) const
+{
+    boost::shared_ptr<const IdCodec> id_codec = current_id_codec();
+    *id_min_bits = id_codec->min_bits;
+    *id_max_bits = id_codec->max_bits;
+}
+
+boost::shared_ptr<const dccl::Codec::IdCodec> dccl::Codec::refresh_id_codec() const
+{
+    std::lock_guard<std::recursive_mutex> lock(refresh_mutex_);
+
+    boost::shared_ptr<const IdCodec> current = id_codec_state_.get();
+    if(current && current->generation == FieldCodecManager::generation())
+        return current;
+
+    boost::shared_ptr<IdCodec> id_codec(new IdCodec);
+    id_codec->generation = FieldCodecManager::generation();
+    id_codec->codec = FieldCodecManager::find(google::protobuf::FieldDescriptor::TYPE_UINT32, id_codec_);
+    id_codec->is_default = (typeid(*id_codec->codec) == typeid(DefaultIdentifierCodec));
+    id_codec->min_bits = 0;
+    id_codec->max_bits = 0;
+    id_codec->codec->field_min_size(&id_codec->min_bits, 0);
+    id_codec->codec->field_max_size(&id_codec->max_bits, 0);
+    id_codec_state_.set(id_codec);
+    return id_codec;
+}
+
+unsigned dccl::Codec::peek_id(const char* bytes, size_t size) const
+{
+    boost::shared_ptr<const IdCodec> id_codec = current_id_codec();
+
+    if(size < id_codec->min_bits / BITS_IN_BYTE)
+        throw(Exception("Bytes passed (hex: " + hex_encode(bytes, bytes + size) + ") is too small to be a valid DCCL message"));
+    
+    if(id_codec->is_default)
+    {
+        // [id (7 bits)][0] or [id (15 bits)][1], least significant bit first (see DefaultIdentifierCodec)
+        const unsigned char first = static_cast<unsigned char>(bytes[0]);
+        if(!(first & 1))
+            return first >> 1;
+        else if(size < 2)
+            throw(Exception("Bytes passed (hex: " + hex_encode(bytes, bytes + size) + ") is too small to be a valid DCCL message"));
+        else
+            return (first >> 1) | (static_cast<unsigned>(static_cast<unsigned char>(bytes[1])) << 7);
+    }
+    
+    BitReader reader(bytes, bytes + std::min<size_t>(size, ceil_bits2bytes(id_codec->max_bits)));
+    Bitset fixed_header_bits(&reader);
+
+    Bitset these_bits(&fixed_header_bits);
+    these_bits.get_more_bits(id_codec->min_bits);
+
+    boost::any return_value;
+    id_codec->codec->field_decode(&these_bits, &return_value, 0);
+
+    return boost::any_cast<uint32>(return_value);
 }
 
 
@@ -612,6 +1023,11 @@ void dccl::Codec::set_crypto_passphrase(const std::string& passphrase, const std
 #endif
 
     skip_crypto_ids_ = do_not_encrypt_ids_;
+
+    for(std::vector<internal::Snapshot<LoadedMessage> >::iterator it = id_table_.begin(), end = id_table_.end(); it != end; ++it)
+        set_skip_crypto(&*it, skip_crypto_ids_.count(it - id_table_.begin()));
+    for(std::map<int32, internal::Snapshot<LoadedMessage> >::iterator it = large_id_table_.begin(), end = large_id_table_.end(); it != end; ++it)
+        set_skip_crypto(&it->second, skip_crypto_ids_.count(it->first));
 }
 
 void dccl::Codec::info_all(std::ostream* param_os /*= 0 */) const
@@ -28,12 +28,15 @@
 #include <ostream>
 #include <stdexcept>
 #include <vector>
+#include <mutex>
 
 #include <google/protobuf/descriptor.h>
 
 #include <boost/shared_ptr.hpp>
 
 #include "binary.h"
+#include "bitreader.h"
+#include "bitwriter.h"
 #include "dynamic_protobuf_manager.h"
 #include "logger.h"
 #include "exception.h"
@@ -43,6 +46,9 @@
 #include "codecs2/field_codec_default_message.h"
 #include "codecs3/field_codec_default_message.h"
 #include "field_codec_manager.h"
+#include "generated_codec.h"
+#include "internal/snapshot.h"
+#include "internal/contiguous_bytes.h"
 
 #define DCCL_HAS_CRYPTOPP @DCCL_HAS_CRYPTOPP@
  
@@ -52,6 +58,8 @@ namespace dccl
     class FieldCodec;
   
     /// \brief The Dynamic CCL enCODer/DECoder. This is the main class you will use to load, encode and decode DCCL messages. Many users will not need any other DCCL classes than this one.
+    ///
+    /// Loaded messages may be encoded, decoded and sized by several threads at once using the same Codec (and while codecs are added to or removed from the FieldCodecManager), but load(), unload(), set_crypto_passphrase() and load_library() must not be called while another thread is using the Codec.
     /// \ingroup dccl_api
     class Codec
     {
@@ -85,7 +93,9 @@ namespace dccl
         /// \brief Load any codecs present in the given shared library name. 
         ///
         /// The library is opened and then load_library(void* dl_handle) is called. Any libraries
-        /// loaded this way will be unloaded when Codec is destructed.
+        /// loaded this way will be unloaded when Codec is destructed. Before then, other threads must have stopped
+        /// using this Codec and the library's codecs, and must call FieldCodecManager::release_thread_cache() (or have exited),
+        /// as each thread's FieldCodecManager cache keeps the codecs alive until it is refreshed.
         void load_library(const std::string& library_path);
         
         /// \brief All messages must be explicited loaded and validated (size checks, option extensions checks, etc.) before they can be encoded/decoded. Use this version of load() when the messages used are static (known at compile time).
@@ -178,9 +188,20 @@ namespace dccl
         unsigned id(const std::string& bytes);
 
         /// \brief Provides the DCCL ID given a DCCL type.
+        ///
+        /// \param begin Iterator to the first byte of the encoded message. Bytes stored contiguously (std::string::iterator, std::vector<char>::iterator or const char*) are read in place, other iterators (e.g. std::deque<char>::iterator) are first copied.
+        /// \param end Iterator pointing to the past-the-end character of the message.
         template<typename CharIterator>
         unsigned id(CharIterator begin, CharIterator end);
 
+        /// \brief Provides the DCCL ID of an encoded message, reading only as many bytes as the id takes.
+        ///
+        /// The default (1 or 2 byte) identifier is read directly from the first bytes. Other id codecs (given to the constructor) are decoded using the id codec.
+        /// \param bytes Pointer to the first byte of the encoded message
+        /// \param size Number of bytes available at `bytes`
+        /// \throw Exception if there are too few bytes to contain an id
+        unsigned peek_id(const char* bytes, size_t size) const;
+
         /// \brief Provides the DCCL ID given a DCCL type.
         unsigned id(const google::protobuf::Descriptor* desc) const {
             return desc->options().GetExtension(dccl::msg).id();
@@ -217,7 +238,7 @@ namespace dccl
 
         /// \brief Decode a DCCL message when the type is known at compile time.
         ///
-        /// \param begin Iterator to the first byte of encoded message to decode (must already have been validated)
+        /// \param begin Iterator to the first byte of encoded message to decode (must already have been validated). Bytes stored contiguously (std::string::iterator, std::vector<char>::iterator or const char*) are decoded in place, other iterators (e.g. std::deque<char>::iterator) are first copied.
         /// \param end Iterator pointing to the past-the-end character of the message.
         /// \param msg Pointer to any Google Protobuf Message generated by protoc (i.e. subclass of google::protobuf::Message). The decoded message will be written here.
         /// \param header_only If true, only decode the header (do not try to decrypt (if applicable) and decode the message body)
@@ -241,6 +262,18 @@ namespace dccl
         /// \throw Exception if message cannot be decoded.
         void decode(std::string* bytes, google::protobuf::Message* msg);
 
+        /// \brief Decode only some of the fields of a DCCL message.
+        ///
+        /// The fields not selected by `mask` are skipped over without being decoded or set in `msg` (for variable size fields, only their length prefixes or presence bits are read), so this is much faster than decoding the entire message when only a few fields are needed. For example:
+        /// \code
+        /// codec.decode(bytes, &msg, dccl::FieldMask().add_path("destination").add_path("position.depth"));
+        /// \endcode
+        /// \param bytes encoded message to decode (must already have been validated)
+        /// \param msg Pointer to any Google Protobuf Message generated by protoc (i.e. subclass of google::protobuf::Message). The selected fields will be written here.
+        /// \param mask Fields to decode
+        /// \throw Exception if message cannot be decoded.
+        void decode(const std::string& bytes, google::protobuf::Message* msg, const FieldMask& mask);
+
         /// \brief An alterative form for decoding messages for message types <i>not</i> known at compile-time ("dynamic").
         ///
         /// \tparam GoogleProtobufMessagePointer anything that acts like a pointer (has operator*) to a google::protobuf::Message (smart pointers like boost::shared_ptr included)
@@ -260,6 +293,31 @@ namespace dccl
         template<typename GoogleProtobufMessagePointer>
             GoogleProtobufMessagePointer decode(std::string* bytes);
 
+        /// \brief Decode a single field of an encoded message, without decoding the rest of the message.
+        ///
+        /// This is possible for fields that are always encoded at the same position, which is found when the message is loaded: all the fields of the header, and the fields of the body that are only preceded by fixed size fields (so all fields when every field of the message is fixed size). For example:
+        /// \code
+        /// double depth = codec.decode_field<double>(bytes, "depth");
+        /// \endcode
+        /// \tparam T Type of the field as stored in the Google Protobuf message (e.g. double for a double field, std::string for a string field, const google::protobuf::EnumValueDescriptor* for an enumeration)
+        /// \param bytes encoded message
+        /// \param field_name Name of a (non-repeated, non-message) field of the message
+        /// \throw Exception if the message is not loaded, the field is not at a fixed position, or T is not the type of the field.
+        /// \return The decoded value, or the field's default value if it is not set
+        template<typename T>
+            T decode_field(const std::string& bytes, const std::string& field_name)
+        {
+            boost::any value = decode_field_value(bytes, field_name);
+            try
+            {
+                return boost::any_cast<T>(value);
+            }
+            catch(boost::bad_any_cast& e)
+            {
+                throw(type_error("decoding field " + field_name, typeid(T), value.type()));
+            }
+        }
+
         /// \brief Provides the encoded size (in bytes) of msg. This is useful if you need to know the size of a message before encoding it (encoding it is generally much more expensive than calling this method)
         ///
         /// \param msg Google Protobuf message with DCCL extensions for which the encoded size is requested
@@ -289,6 +347,58 @@ namespace dccl
         unsigned min_size(const google::protobuf::Descriptor* desc) const;
 
         
+        //@}
+
+        /// \name Batch functions
+        //@{
+
+        /// \brief Encode many messages, spread over several threads.
+        ///
+        /// The threads share the messages between them by work stealing, so a few large messages do not hold up the rest. A message that cannot be encoded does not stop the others from being encoded. The threads (other than the calling one) are kept for later batches, so they reuse what they have cached; a batch started while another is running uses only the calling thread.
+        ///
+        /// Messages using adaptive arithmetic models are not supported: each thread adapts its own copy of the models, in whatever order it happens to get the messages, so the result would not match the decoder's models. Encode these one at a time, with a dccl::arith::ModelContext for each link.
+        /// \param msgs Messages to encode (must already have been validated)
+        /// \param bytes The encoded messages are written here, in the same order as `msgs` (and left empty for any message that could not be encoded)
+        /// \param num_threads Number of threads to use, including the calling thread (0 for one per hardware thread)
+        /// \param errors If given, set to the reason each message could not be encoded (in the same order as `msgs`), or an empty string for those that were encoded
+        /// \return Number of messages that could not be encoded
+        std::size_t encode_batch(const std::vector<const google::protobuf::Message*>& msgs,
+                                 std::vector<std::string>* bytes,
+                                 unsigned num_threads = 0,
+                                 std::vector<std::string>* errors = 0);
+
+        /// \brief Decode many messages (of any loaded type), spread over several threads.
+        ///
+        /// The threads share the messages between them by work stealing, so a few large messages do not hold up the rest. A message that cannot be decoded does not stop the others from being decoded. As for encode_batch(), the threads are kept for later batches, and messages using adaptive arithmetic models are not supported.
+        /// \param bytes Encoded messages
+        /// \param msgs The decoded messages are written here, in the same order as `bytes` (and left null for any message that could not be decoded)
+        /// \param num_threads Number of threads to use, including the calling thread (0 for one per hardware thread)
+        /// \param errors If given, set to the reason each message could not be decoded (in the same order as `bytes`), or an empty string for those that were decoded
+        /// \return Number of messages that could not be decoded
+        std::size_t decode_batch(const std::vector<std::string>& bytes,
+                                 std::vector<boost::shared_ptr<google::protobuf::Message> >* msgs,
+                                 unsigned num_threads = 0,
+                                 std::vector<std::string>* errors = 0);
+        
+        //@}
+
+        /// \name Generated Codecs
+        //@{
+
+        /// \brief Register an encoder/decoder written ahead of time for one message type (this is called by code generated by protoc-gen-dccl).
+        ///
+        /// Applies to all Codec instances. The generated codec is used for messages loaded after this call, if the message's fields all use the default DCCL3 field codecs (otherwise it is ignored). May be called while other threads are loading messages.
+        /// \param message_name Full name of the Protobuf message (e.g. "foo.Bar")
+        /// \param codec The generated codec
+        static void add_generated_codec(const std::string& message_name, boost::shared_ptr<GeneratedMessageCodec> codec);
+
+        /// \brief Remove a codec added with add_generated_codec(). Messages loaded after this call use the default message codec.
+        static void remove_generated_codec(const std::string& message_name);
+
+        /// \brief Whether the generated codec (if any) is being used for `desc`
+        bool uses_generated_codec(const google::protobuf::Descriptor* desc) const
+        { return loaded_generated_codec(desc) != 0; }
+        
         //@}
 
         
@@ -314,7 +424,8 @@ namespace dccl
         Codec(const Codec&);
         Codec& operator= (const Codec&);
 
-        void encode_internal(const google::protobuf::Message& msg, bool header_only, Bitset& header_bits, Bitset& body_bits);
+        // writes the encoded (unencrypted) message to `writer`, returning the size of the head in bytes
+        size_t encode_internal(const google::protobuf::Message& msg, bool header_only, BitWriter* writer);
 
         void encrypt(std::string* s, const std::string& nonce);
         void decrypt(std::string* s, const std::string& nonce);
@@ -323,9 +434,124 @@ namespace dccl
 
         boost::shared_ptr<FieldCodecBase> id_codec() const
         {
-            return FieldCodecManager::find(google::protobuf::FieldDescriptor::TYPE_UINT32,
-                                           id_codec_);
+            return current_id_codec()->codec;
         }
+
+        // sizes (in bits) of a message, computed once when the message is loaded
+        struct MessageSizes
+        {
+            const google::protobuf::Descriptor* desc;
+            // FieldCodecManager::generation() when these sizes were computed
+            unsigned generation;
+            // encoded size of this message's id
+            unsigned id_bits;
+            // excluding the id
+            unsigned head_max_bits;
+            unsigned head_min_bits;
+            unsigned body_max_bits;
+            unsigned body_min_bits;
+            // used in place of the message's field codecs, if set
+            boost::shared_ptr<GeneratedMessageCodec> generated;
+        };
+
+        // everything needed to encode or decode a loaded message
+        struct LoadedMessage
+        {
+            LoadedMessage() : desc(0), skip_crypto(false), prototype(0) { }
+            
+            // 0 if no message is loaded with this id
+            const google::protobuf::Descriptor* desc;
+            // message codec, as of sizes.generation
+            boost::shared_ptr<FieldCodecBase> codec;
+            MessageSizes sizes;
+            // id is one of the do_not_encrypt_ids given to set_crypto_passphrase()
+            bool skip_crypto;
+            // used to create new messages of this type when decoding
+            const google::protobuf::Message* prototype;
+            // fields that are always encoded at the same position, by name
+            std::map<std::string, internal::FixedLayoutField> fixed_fields;
+        };
+
+        // ids below this are stored directly in id_table_, indexed by id
+        enum { MAX_TABLE_ID = 1 << 15 };
+        
+        // the message loaded with `dccl_id` (updated if the FieldCodecManager has changed since it was loaded), or null if there isn't one. Holding the pointer keeps this version alive if it is replaced meanwhile.
+        boost::shared_ptr<const LoadedMessage> loaded_message(int32 dccl_id) const
+        {
+            internal::Snapshot<LoadedMessage>* slot = 0;
+            if(dccl_id >= 0 && dccl_id < MAX_TABLE_ID)
+            {
+                if(static_cast<size_t>(dccl_id) < id_table_.size())
+                    slot = &id_table_[dccl_id];
+            }
+            else
+            {
+                std::map<int32, internal::Snapshot<LoadedMessage> >::iterator it = large_id_table_.find(dccl_id);
+                if(it != large_id_table_.end())
+                    slot = &it->second;
+            }
+
+            boost::shared_ptr<const LoadedMessage> loaded;
+            if(slot)
+                loaded = slot->get();
+            if(loaded && loaded->sizes.generation != FieldCodecManager::generation())
+                loaded = refresh(slot);
+            return loaded;
+        }
+
+        template<typename CharIterator>
+            CharIterator decode_internal(CharIterator begin, CharIterator end, google::protobuf::Message* msg, bool header_only, const FieldMask* mask);
+        
+        // decodes one field (see decode_field()), returning its default value if it is not set
+        boost::any decode_field_value(const std::string& bytes, const std::string& field_name);
+        void compute_fixed_layout(LoadedMessage* loaded) const;
+        
+        // the entry for `dccl_id`, creating an empty one if necessary
+        internal::Snapshot<LoadedMessage>& loaded_message_entry(int32 dccl_id);
+        // replaces the loaded message in `slot` with one using the current codecs
+        boost::shared_ptr<const LoadedMessage> refresh(internal::Snapshot<LoadedMessage>* slot) const;
+        void set_skip_crypto(internal::Snapshot<LoadedMessage>* slot, bool skip_crypto);
+        
+        MessageSizes compute_sizes(const google::protobuf::Descriptor* desc, int32 dccl_id) const;
+        // cached sizes for `desc` (recomputed if not loaded or if the codecs have changed since)
+        MessageSizes sizes(const google::protobuf::Descriptor* desc, int32 dccl_id) const;
+
+        // minimum and maximum encoded size of any id
+        void id_sizes(unsigned* id_min_bits, unsigned* id_max_bits) const;
+
+        // the id codec and its sizes
+        struct IdCodec
+        {
+            boost::shared_ptr<FieldCodecBase> codec;
+            // codec is a DefaultIdentifierCodec
+            bool is_default;
+            unsigned min_bits;
+            unsigned max_bits;
+            // FieldCodecManager::generation() when the codec was found
+            unsigned generation;
+        };
+        
+        // the id codec, found again if the FieldCodecManager has changed since it was last found
+        boost::shared_ptr<const IdCodec> current_id_codec() const
+        {
+            boost::shared_ptr<const IdCodec> id_codec = id_codec_state_.get();
+            if(!id_codec || id_codec->generation != FieldCodecManager::generation())
+                id_codec = refresh_id_codec();
+            return id_codec;
+        }
+        boost::shared_ptr<const IdCodec> refresh_id_codec() const;
+
+        typedef std::map<std::string, boost::shared_ptr<GeneratedMessageCodec> > GeneratedCodecs;
+        // the registered generated codecs. Like the FieldCodecManager registry, these are replaced with a modified copy (under a mutex) rather than modified, so that load() may read them on any thread
+        static boost::shared_ptr<const GeneratedCodecs> generated_codecs();
+        // replaces the registered generated codecs with a copy modified by `modify`
+        template<typename Modify>
+            static void modify_generated_codecs(Modify modify);
+
+        // the registered generated codec for `message_sizes.desc`, if it can replace the default codecs
+        boost::shared_ptr<GeneratedMessageCodec> find_generated_codec(const MessageSizes& message_sizes) const;
+        // the generated codec in use for `desc`, or 0 if it isn't loaded or doesn't have one
+        GeneratedMessageCodec* loaded_generated_codec(const google::protobuf::Descriptor* desc) const;
         
       private:
         // SHA256 hash of the crypto passphrase
@@ -336,7 +562,15 @@ namespace dccl
 
         // maps `dccl.id`s onto Message Descriptors
         std::map<int32, const google::protobuf::Descriptor*> id2desc_;
+        // loaded messages with ids below MAX_TABLE_ID, indexed by id (sized to the largest loaded id). Loaded messages are replaced rather than modified when refreshed, as other threads may be encoding or decoding them.
+        mutable std::vector<internal::Snapshot<LoadedMessage> > id_table_;
+        // loaded messages with larger (or negative) ids (only possible with a custom id codec)
+        mutable std::map<int32, internal::Snapshot<LoadedMessage> > large_id_table_;
         std::string id_codec_;
+        mutable internal::Snapshot<IdCodec> id_codec_state_;
+        
+        // serializes refresh() and refresh_id_codec() (recursive as the former may call the latter)
+        mutable std::recursive_mutex refresh_mutex_;
 
         std::vector<void *> dl_handles_;
         
@@ -354,12 +588,12 @@ GoogleProtobufMessagePointer dccl::Codec::decode(const std::string& bytes, bool
 {
     unsigned this_id = id(bytes);
 
-    if(!id2desc_.count(this_id))
+    boost::shared_ptr<const LoadedMessage> loaded = loaded_message(this_id);
+    if(!loaded)
         throw(Exception("Message id " + boost::lexical_cast<std::string>(this_id) + " has not been loaded. Call load() before decoding this type."));
                     
     // ownership of this object goes to the caller of decode()
-    GoogleProtobufMessagePointer msg =
-        dccl::DynamicProtobufManager::new_protobuf_message<GoogleProtobufMessagePointer>(id2desc_.find(this_id)->second);
+    GoogleProtobufMessagePointer msg = GoogleProtobufMessagePointer(loaded->prototype->New());
     decode(bytes, &(*msg), header_only);
     return msg;
 }
@@ -369,11 +603,11 @@ GoogleProtobufMessagePointer dccl::Codec::decode(std::string* bytes)
 {
     unsigned this_id = id(*bytes);
 
-    if(!id2desc_.count(this_id))
+    boost::shared_ptr<const LoadedMessage> loaded = loaded_message(this_id);
+    if(!loaded)
         throw(Exception("Message id " + boost::lexical_cast<std::string>(this_id) + " has not been loaded. Call load() before decoding this type."));
                     
-    GoogleProtobufMessagePointer msg =
-        dccl::DynamicProtobufManager::new_protobuf_message<GoogleProtobufMessagePointer>(id2desc_.find(this_id)->second);
+    GoogleProtobufMessagePointer msg = GoogleProtobufMessagePointer(loaded->prototype->New());
     std::string::iterator new_begin = decode(bytes->begin(), bytes->end(), &(*msg));
     bytes->erase(bytes->begin(), new_begin);
     return msg;
@@ -382,54 +616,46 @@ GoogleProtobufMessagePointer dccl::Codec::decode(std::string* bytes)
 template<typename CharIterator>
 unsigned dccl::Codec::id(CharIterator begin, CharIterator end)
 {
-    unsigned id_min_size = 0, id_max_size = 0;
-    id_codec()->field_min_size(&id_min_size, 0);
-    id_codec()->field_max_size(&id_max_size, 0);
-
-    if(std::distance(begin, end) < (id_min_size / BITS_IN_BYTE))
-        throw(Exception("Bytes passed (hex: " + hex_encode(begin, end) + ") is too small to be a valid DCCL message"));
-
-    Bitset fixed_header_bits;
-    fixed_header_bits.from_byte_stream(begin, begin+(size_t)std::ceil(double(id_max_size) / BITS_IN_BYTE));
-
-    Bitset these_bits(&fixed_header_bits);
-    these_bits.get_more_bits(id_min_size);
-
-    boost::any return_value;
-    id_codec()->field_decode(&these_bits, &return_value, 0);
-
-    return boost::any_cast<uint32>(return_value);
+    internal::ContiguousBytes<CharIterator> bytes(begin, end);
+    return peek_id(bytes.data(), bytes.size());
 }
 
 template <typename CharIterator>
 CharIterator dccl::Codec::decode(CharIterator begin, CharIterator end, google::protobuf::Message* msg, bool header_only /*= false*/)
 {
+    return decode_internal(begin, end, msg, header_only, 0);
+}
+
+template<typename CharIterator>
+CharIterator dccl::Codec::decode_internal(CharIterator begin, CharIterator end, google::protobuf::Message* msg, bool header_only, const FieldMask* mask)
+{
+    // keeps this call's state apart from that of any call already in progress on this thread
+    internal::CodecContext::Scope context_scope;
+
     try
     {
         unsigned this_id = id(begin, end);
         
         dlog.is(logger::DEBUG1, logger::DECODE) && dlog  << "Began decoding message of id: " << this_id << std::endl;
         
-        if(!id2desc_.count(this_id))
+        boost::shared_ptr<const LoadedMessage> loaded = loaded_message(this_id);
+        if(!loaded)
             throw(Exception("Message id " + boost::lexical_cast<std::string>(this_id) + " has not been loaded. Call load() before decoding this type."));
 
         const google::protobuf::Descriptor* desc = msg->GetDescriptor();
 
         dlog.is(logger::DEBUG1, logger::DECODE) && dlog  << "Type name: " << desc->full_name() << std::endl;
 
-        boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
-        boost::shared_ptr<internal::FromProtoCppTypeBase> helper = internal::TypeHelper::find(desc);
+        const bool is_loaded_type = (loaded->desc == desc);
+        boost::shared_ptr<FieldCodecBase> codec = is_loaded_type ? loaded->codec : FieldCodecManager::find(desc);
 
         CharIterator actual_end = end;
         if(codec)
         {
-            unsigned head_size_bits;
-            unsigned body_size_bits;
-            codec->base_max_size(&head_size_bits, desc, HEAD);
-            codec->base_max_size(&body_size_bits, desc, BODY);
-            unsigned id_size = 0;
-            id_codec()->field_size(&id_size, this_id, 0);
-            head_size_bits += id_size;
+            const MessageSizes message_sizes = is_loaded_type ? loaded->sizes : compute_sizes(desc, this_id);
+            const unsigned id_size = message_sizes.id_bits;
+            const unsigned head_size_bits = message_sizes.head_max_bits + id_size;
+            const unsigned body_size_bits = message_sizes.body_max_bits;
 
             unsigned head_size_bytes = ceil_bits2bytes(head_size_bits);
             unsigned body_size_bytes = ceil_bits2bytes(body_size_bits);
@@ -437,22 +663,30 @@ CharIterator dccl::Codec::decode(CharIterator begin, CharIterator end, google::p
             dlog.is(logger::DEBUG2, logger::DECODE) && dlog  << "Head bytes (bits): " << head_size_bytes << "(" << head_size_bits
                                     << "), max body bytes (bits): " << body_size_bytes << "(" << body_size_bits << ")" <<  std::endl;
 
-            CharIterator head_bytes_end = begin + head_size_bytes;
-            dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Head (hex): " << hex_encode(begin, head_bytes_end) << std::endl;
+            // the bytes are decoded in place (unless CharIterator is not contiguous)
+            internal::ContiguousBytes<CharIterator> bytes(begin, end);
+            const size_t num_bytes = bytes.size();
+            const char* data = bytes.data();
+            head_size_bytes = std::min<size_t>(head_size_bytes, num_bytes);
 
-            Bitset head_bits;
-            head_bits.from_byte_stream(begin, head_bytes_end);
-            dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Head (bin): " << head_bits << std::endl;
+            CharIterator head_bytes_end = std::next(begin, head_size_bytes);
+            dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Head (hex): " << hex_encode(begin, head_bytes_end) << std::endl;
 
-            // shift off ID bits
-            head_bits >>= id_size;
+            BitReader head_reader(data, data + head_size_bytes);
+            Bitset head_bits(&head_reader);
 
-            dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Head after ID bits removal (bin): " << head_bits << std::endl;
+            // skip over ID bits
+            head_reader.skip(id_size);
 
             internal::MessageStack msg_stack;
             msg_stack.push(msg->GetDescriptor());
 
-            codec->base_decode(&head_bits, msg, HEAD);
+            // generated codecs always decode the entire message
+            GeneratedMessageCodec* generated = mask ? 0 : message_sizes.generated.get();
+            if(mask)
+                codec->base_decode(&head_bits, msg, HEAD, *mask);
+            else if(!generated || !generated->decode(&head_bits, msg, HEAD))
+                codec->base_decode(&head_bits, msg, HEAD);
             dlog.is(logger::DEBUG2, logger::DECODE) && dlog  << "after header decode, message is: " << *msg << std::endl;
 
 
@@ -465,27 +699,33 @@ CharIterator dccl::Codec::decode(CharIterator begin, CharIterator end, google::p
             {
                 dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Encrypted Body (hex): " << hex_encode(head_bytes_end, end) << std::endl;
 
-                Bitset body_bits;
-                if(!crypto_key_.empty() && !skip_crypto_ids_.count(this_id))
+                const char* body_begin = data + head_size_bytes;
+                const char* body_end = data + num_bytes;
+                std::string body_bytes;
+                if(!crypto_key_.empty() && !loaded->skip_crypto)
                 {
                     std::string head_bytes(begin, head_bytes_end);
-                    std::string body_bytes(head_bytes_end, end);
+                    body_bytes.assign(head_bytes_end, end);
                     decrypt(&body_bytes, head_bytes);
                     dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Body (hex): " << hex_encode(body_bytes) << std::endl;
-                    body_bits.from_byte_stream(body_bytes.begin(), body_bytes.end());
+                    body_begin = body_bytes.data();
+                    body_end = body_begin + body_bytes.size();
                 }
                 else
                 {
                     dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Body (hex): " << hex_encode(head_bytes_end, end) << std::endl;
-                    body_bits.from_byte_stream(head_bytes_end, end);
                 }
 
-                dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Body (bin): " << body_bits << std::endl;
+                BitReader body_reader(body_begin, body_end);
+                Bitset body_bits(&body_reader);
 
-                codec->base_decode(&body_bits, msg, BODY);
+                if(mask)
+                    codec->base_decode(&body_bits, msg, BODY, *mask);
+                else if(!generated || !generated->decode(&body_bits, msg, BODY))
+                    codec->base_decode(&body_bits, msg, BODY);
                 dlog.is(logger::DEBUG2, logger::DECODE) && dlog  << "after header & body decode, message is: " << *msg << std::endl;
 
-                actual_end = end - body_bits.size()/BITS_IN_BYTE;
+                actual_end = std::prev(end, (body_bits.size() + body_reader.remaining())/BITS_IN_BYTE);
             }
         }
         else
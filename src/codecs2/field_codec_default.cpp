@@ -85,27 +85,19 @@ dccl::Bitset dccl::v2::DefaultStringCodec::encode()
 
 dccl::Bitset dccl::v2::DefaultStringCodec::encode(const std::string& wire_value)
 {
-    std::string s = wire_value;
-    if(s.size() > dccl_field_options().max_length())
+    std::string::size_type length = wire_value.size();
+    if(length > field_options().max_length)
     {
-        dccl::dlog.is(DEBUG2) && dccl::dlog << "String " << s <<  " exceeds `dccl.max_length`, truncating" << std::endl;
-        s.resize(dccl_field_options().max_length()); 
+        dccl::dlog.is(DEBUG2) && dccl::dlog << "String " << wire_value <<  " exceeds `dccl.max_length`, truncating" << std::endl;
+        length = field_options().max_length;
     }
         
-            
-    Bitset value_bits;
-    value_bits.from_byte_string(s);
-    
-    Bitset length_bits(min_size(), s.length());
-
-    dccl::dlog.is(DEBUG2) && dccl::dlog << "DefaultStringCodec value_bits: " << value_bits << std::endl;    
+    Bitset length_bits(min_size(), length);
 
-    
     dccl::dlog.is(DEBUG2) && dccl::dlog << "DefaultStringCodec length_bits: " << length_bits << std::endl;    
     
     // adds to MSBs
-    for(int i = 0, n = value_bits.size(); i < n; ++i)
-        length_bits.push_back(value_bits[i]);
+    length_bits.append_bytes(wire_value.data(), length);
 
     dccl::dlog.is(DEBUG2) && dccl::dlog << "DefaultStringCodec created: " << length_bits << std::endl;
     
@@ -131,11 +123,9 @@ std::string dccl::v2::DefaultStringCodec::decode(Bitset* bits)
 
         
         dccl::dlog.is(DEBUG2) && dccl::dlog << "bits after get_more_bits " << *bits << std::endl;    
-        Bitset string_body_bits = *bits;
-        string_body_bits >>= header_length;
-        string_body_bits.resize(bits->size() - header_length);
-    
-        return string_body_bits.to_byte_string();
+        std::string value(value_length, 0);
+        bits->copy_bytes(header_length, &value[0], value_length);
+        return value;
     }
     else
     {
@@ -144,6 +134,12 @@ std::string dccl::v2::DefaultStringCodec::decode(Bitset* bits)
     
 }
 
+void dccl::v2::DefaultStringCodec::skip(Bitset* bits)
+{
+    // `bits` holds the length
+    bits->skip_more_bits(bits->to_ulong()*BITS_IN_BYTE);
+}
+
 unsigned dccl::v2::DefaultStringCodec::size()
 {
     return min_size();
@@ -158,7 +154,7 @@ unsigned dccl::v2::DefaultStringCodec::size(const std::string& wire_value)
 unsigned dccl::v2::DefaultStringCodec::max_size()
 {
     // string length + actual string
-    return min_size() + dccl_field_options().max_length() * BITS_IN_BYTE;
+    return min_size() + field_options().max_length * BITS_IN_BYTE;
 }
 
 unsigned dccl::v2::DefaultStringCodec::min_size()
@@ -169,8 +165,8 @@ unsigned dccl::v2::DefaultStringCodec::min_size()
 
 void dccl::v2::DefaultStringCodec::validate()
 {
-    require(dccl_field_options().has_max_length(), "missing (dccl.field).max_length");
-    require(dccl_field_options().max_length() <= MAX_STRING_LENGTH,
+    require(field_options().has_max_length, "missing (dccl.field).max_length");
+    require(field_options().max_length <= MAX_STRING_LENGTH,
             "(dccl.field).max_length must be <= " + boost::lexical_cast<std::string>(static_cast<int>(MAX_STRING_LENGTH)));
 }
 
@@ -186,14 +182,11 @@ dccl::Bitset dccl::v2::DefaultBytesCodec::encode()
 dccl::Bitset dccl::v2::DefaultBytesCodec::encode(const std::string& wire_value)
 {
     Bitset bits;
-    bits.from_byte_string(wire_value);
-    bits.resize(max_size());
-    
     if(!use_required())
-    {
-        bits <<= 1;
-        bits.set(0, true); // presence bit
-    }
+        bits.push_back(true); // presence bit
+
+    bits.append_bytes(wire_value.data(), std::min<std::string::size_type>(wire_value.size(), field_options().max_length));
+    bits.resize(max_size());
     
     return bits;
 }
@@ -219,11 +212,9 @@ std::string dccl::v2::DefaultBytesCodec::decode(Bitset* bits)
             // grabs more bits to add to the MSBs of `bits`
             bits->get_more_bits(max_size()- min_size());
             
-            Bitset bytes_body_bits = *bits;
-            bytes_body_bits >>= min_size();
-            bytes_body_bits.resize(bits->size() - min_size());
-        
-            return bytes_body_bits.to_byte_string();
+            std::string value(field_options().max_length, 0);
+            bits->copy_bytes(min_size(), &value[0], value.size());
+            return value;
         }
         else
         {
@@ -236,9 +227,16 @@ std::string dccl::v2::DefaultBytesCodec::decode(Bitset* bits)
     }
 }
 
+void dccl::v2::DefaultBytesCodec::skip(Bitset* bits)
+{
+    // `bits` holds the presence bit (if any)
+    if(!use_required() && bits->to_ulong())
+        bits->skip_more_bits(max_size() - min_size());
+}
+
 unsigned dccl::v2::DefaultBytesCodec::max_size()
 {
-    return dccl_field_options().max_length() * BITS_IN_BYTE +
+    return field_options().max_length * BITS_IN_BYTE +
         (use_required() ? 0 : 1); // presence bit?
 }
 
@@ -252,7 +250,7 @@ unsigned dccl::v2::DefaultBytesCodec::min_size()
 
 void dccl::v2::DefaultBytesCodec::validate()
 {
-    require(dccl_field_options().has_max_length(), "missing (dccl.field).max_length");
+    require(field_options().has_max_length, "missing (dccl.field).max_length");
 }
 
 //
@@ -47,6 +47,48 @@ namespace dccl
     /// Goby/DCCL version 2 default field codecs
     namespace v2
     {
+        /// \brief Converts a numeric value to the unsigned integer DefaultNumericFieldCodec puts on the wire (before adding the "presence" value for optional fields). Also used by generated message codecs (see GeneratedMessageCodec).
+        ///
+        /// \return false if the value is outside [min, max] (and so is encoded as zeros)
+        template<typename WireType>
+            bool numeric_wire_encode(WireType value, double min, double max, double precision, dccl::uint64* uint_value)
+        {
+            // round first, before checking bounds
+            WireType wire_value = dccl::round(value, precision);
+
+            // check bounds, if out-of-bounds, send as zeros
+            if(wire_value < min || wire_value > max)
+                return false;
+          
+            wire_value -= dccl::round((WireType)min, precision);
+
+            if (precision < 0) {
+                wire_value /= (WireType)std::pow(10.0, -precision);
+            } else if (precision > 0) {
+                wire_value *= (WireType)std::pow(10.0, precision);
+            }
+
+            *uint_value = boost::numeric_cast<dccl::uint64>(dccl::round(wire_value, 0));
+            return true;
+        }
+
+        /// \brief Inverse of numeric_wire_encode(): converts the unsigned integer (with any "presence" value removed) back to a numeric value.
+        template<typename WireType>
+            WireType numeric_wire_decode(dccl::uint64 uint_value, double min, double precision)
+        {
+            WireType wire_value = (WireType)uint_value;
+
+            if (precision < 0) {
+                wire_value *= (WireType)std::pow(10.0, -precision);
+            } else if (precision > 0) {
+                wire_value /= (WireType)std::pow(10.0, precision);
+            }
+
+            // round values again to properly handle cases where double precision
+            // leads to slightly off values (e.g. 2.099999999 instead of 2.1)
+            return dccl::round(wire_value + dccl::round((WireType)min, precision), precision);
+        }
+        
         /// \brief Provides a basic bounded arbitrary length numeric (double, float, uint32, uint64, int32, int64) encoder.
         ///
         /// Takes ceil(log2((max-min)*10^precision)+1) bits for required fields, ceil(log2((max-min)*10^precision)+2) for optional fields.
@@ -56,19 +98,19 @@ namespace dccl
               protected:
 
               virtual double max()
-              { return FieldCodecBase::dccl_field_options().max(); }
+              { return FieldCodecBase::field_options().max; }
       
               virtual double min()
-              { return FieldCodecBase::dccl_field_options().min(); }
+              { return FieldCodecBase::field_options().min; }
 
               virtual double precision()
-              { return FieldCodecBase::dccl_field_options().precision(); }
+              { return FieldCodecBase::field_options().precision; }
       
               virtual void validate()
               {
-                  FieldCodecBase::require(FieldCodecBase::dccl_field_options().has_min(),
+                  FieldCodecBase::require(FieldCodecBase::field_options().has_min,
                                           "missing (dccl.field).min");
-                  FieldCodecBase::require(FieldCodecBase::dccl_field_options().has_max(),
+                  FieldCodecBase::require(FieldCodecBase::field_options().has_max,
                                           "missing (dccl.field).max");
 
                   validate_numeric_bounds();
@@ -99,40 +141,24 @@ namespace dccl
           
               virtual Bitset encode(const WireType& value)
               {
-                  // round first, before checking bounds
-                  WireType wire_value = dccl::round(value, precision());
-
-                  // check bounds, if out-of-bounds, send as zeros
-                  if(wire_value < min() || wire_value > max())
+                  dccl::uint64 uint_value = 0;
+                  if(!numeric_wire_encode(value, min(), max(), precision(), &uint_value))
                       return Bitset(size());
-          
-                  wire_value -= dccl::round((WireType)min(), precision());
-
-                  if (precision() < 0) {
-                      wire_value /= (WireType)std::pow(10.0, -precision());
-                  } else if (precision() > 0) {
-                      wire_value *= (WireType)std::pow(10.0, precision());
-                  }
-
-                  dccl::uint64 uint_value = boost::numeric_cast<dccl::uint64>(dccl::round(wire_value, 0));
 
                   // "presence" value (0)
                   if(!FieldCodecBase::use_required())
                       uint_value += 1;
 	  
 
-                  Bitset encoded;
-                  encoded.from(uint_value, size());
+                  const unsigned num_bits = size();
+                  Bitset encoded(num_bits);
+                  encoded.write_bits(0, std::min<unsigned>(num_bits, std::numeric_limits<dccl::uint64>::digits), uint_value);
                   return encoded;
               }
           
               virtual WireType decode(Bitset* bits)
               {
-                  // The line below SHOULD BE:
-                  // dccl::uint64 t = bits->to<dccl::uint64>();
-                  // But GCC3.3 requires an explicit template modifier on the method.
-                  // See, e.g., http://gcc.gnu.org/bugzilla/show_bug.cgi?id=10959
-                  dccl::uint64 uint_value = (bits->template to<dccl::uint64>)();
+                  dccl::uint64 uint_value = bits->read_bits(0, bits->size());
 
                   if(!FieldCodecBase::use_required())
                   {
@@ -140,20 +166,7 @@ namespace dccl
                       --uint_value;
                   }
 	  
-                  WireType wire_value = (WireType)uint_value;
-
-                  if (precision() < 0) {
-                      wire_value *= (WireType)std::pow(10.0, -precision());
-                  } else if (precision() > 0) {
-                      wire_value /= (WireType)std::pow(10.0, precision());
-                  }
-
-                  // round values again to properly handle cases where double precision
-                  // leads to slightly off values (e.g. 2.099999999 instead of 2.1)
-                  wire_value = dccl::round(wire_value + dccl::round((WireType)min(), precision()),
-                                           precision());
-
-                  return wire_value;
+                  return numeric_wire_decode<WireType>(uint_value, min(), precision());
               }
 
               unsigned size()
@@ -188,6 +201,7 @@ namespace dccl
             Bitset encode();
             Bitset encode(const std::string& wire_value);
             std::string decode(Bitset* bits);
+            void skip(Bitset* bits);
             unsigned size();
             unsigned size(const std::string& wire_value);
             unsigned max_size();
@@ -206,6 +220,7 @@ namespace dccl
             Bitset encode();
             Bitset encode(const std::string& wire_value);
             std::string decode(Bitset* bits);
+            void skip(Bitset* bits);
             unsigned size();
             unsigned size(const std::string& wire_value);
             unsigned max_size();
@@ -275,17 +290,17 @@ namespace dccl
             }
 
             double max() { 
-                return FieldCodecBase::dccl_field_options().num_days() * SECONDS_IN_DAY;
+                return FieldCodecBase::field_options().num_days * SECONDS_IN_DAY;
             }
 
             double min() { return 0; }
             double precision() 
             {
-                if(!FieldCodecBase::dccl_field_options().has_precision())
+                if(!FieldCodecBase::field_options().has_precision)
                     return 0; // default to second precision
                 else
                 {
-                    return FieldCodecBase::dccl_field_options().precision() + (double)std::log10((double)conversion_factor);
+                    return FieldCodecBase::field_options().precision + (double)std::log10((double)conversion_factor);
                 }
             
             }
@@ -24,6 +24,7 @@
 
 #include "dccl/field_codec.h"
 #include "dccl/field_codec_manager.h"
+#include "dccl/internal/message_plan.h"
 
 #include "dccl/protobuf/option_extensions.pb.h"
 
@@ -37,9 +38,15 @@ namespace dccl
           private:
             
             void any_encode(Bitset* bits, const boost::any& wire_value);
+            void any_encode_direct(BitWriter* writer, const boost::any& wire_value);
+            void any_encode_repeated_direct(BitWriter* writer, const std::vector<boost::any>& wire_values)
+            { any_encode_repeated_each_direct(writer, wire_values); }
             void any_decode(Bitset* bits, boost::any* wire_value); 
+            void skip(Bitset* bits);
             unsigned max_size();
             unsigned min_size();
+            unsigned decode_prefetch_size();
+            void fixed_layout(std::vector<internal::FixedLayoutField>* layout);
             unsigned any_size(const boost::any& wire_value);
 
 
@@ -53,8 +60,28 @@ namespace dccl
             std::string info();
             bool check_field(const google::protobuf::FieldDescriptor* field);
 
+            /// \brief The compiled plan for message `desc` in the current part, compiling it first if necessary (or if `recompile` is set).
+            boost::shared_ptr<const internal::MessagePlan> plan(const google::protobuf::Descriptor* desc, bool recompile = false);
+
             struct Size
             {
+                // fixed size fields don't need to be visited
+                static bool precomputed(const internal::MessagePlanStep& step,
+                                        unsigned* return_value)
+                {
+                    if(step.fixed_size)
+                        *return_value += step.size;
+                    return step.fixed_size;
+                }
+
+                static bool reflected(const boost::shared_ptr<FieldCodecBase>& codec,
+                                      unsigned* return_value,
+                                      const google::protobuf::Message& msg,
+                                      const google::protobuf::FieldDescriptor* field_desc)
+                {
+                    return codec->field_size_reflected(return_value, msg, field_desc);
+                }
+
                 static void repeated(boost::shared_ptr<FieldCodecBase> codec,
                                      unsigned* return_value,
                                      const std::vector<boost::any>& field_values,
@@ -73,18 +100,42 @@ namespace dccl
                 
             };
             
+            // Sink is Bitset or BitWriter
             struct Encoder
             {
+                template<typename Sink>
+                static bool precomputed(const internal::MessagePlanStep& step,
+                                        Sink* return_value)
+                { return false; }
+
+                // the typed path writes directly to the output buffer only
+                template<typename Sink>
+                static bool reflected(const boost::shared_ptr<FieldCodecBase>& codec,
+                                      Sink* return_value,
+                                      const google::protobuf::Message& msg,
+                                      const google::protobuf::FieldDescriptor* field_desc)
+                { return false; }
+
+                static bool reflected(const boost::shared_ptr<FieldCodecBase>& codec,
+                                      BitWriter* return_value,
+                                      const google::protobuf::Message& msg,
+                                      const google::protobuf::FieldDescriptor* field_desc)
+                {
+                    return codec->field_encode_reflected(return_value, msg, field_desc);
+                }
+
+                template<typename Sink>
                 static void repeated(boost::shared_ptr<FieldCodecBase> codec,
-                                     Bitset* return_value,
+                                     Sink* return_value,
                                      const std::vector<boost::any>& field_values,
                                      const google::protobuf::FieldDescriptor* field_desc)
                     {
                         codec->field_encode_repeated(return_value, field_values, field_desc);
                     }
                 
+                template<typename Sink>
                 static void single(boost::shared_ptr<FieldCodecBase> codec,
-                                   Bitset* return_value,
+                                   Sink* return_value,
                                    const boost::any& field_value,
                                    const google::protobuf::FieldDescriptor* field_desc)
                     {
@@ -137,56 +188,54 @@ namespace dccl
             template<typename Action, typename ReturnType>
                 void traverse_descriptor(ReturnType* return_value)
             {
-                const google::protobuf::Descriptor* desc =
-                    FieldCodecBase::this_descriptor();
-                for(int i = 0, n = desc->field_count(); i < n; ++i)
+                boost::shared_ptr<const internal::MessagePlan> message_plan = plan(FieldCodecBase::this_descriptor());
+                for(std::vector<internal::MessagePlanStep>::const_iterator it = message_plan->steps.begin(),
+                        end = message_plan->steps.end(); it != end; ++it)
                 {
-                    const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
-                    
-                    if(!check_field(field_desc))
-                        continue;
-
-                    Action::field(find(field_desc), return_value, field_desc);                    
+                    Action::field(it->codec, return_value, it->field);
                 }
             }
             
 
             template<typename Action, typename ReturnType>
                 ReturnType traverse_const_message(const boost::any& wire_value)
+            {
+                ReturnType return_value = ReturnType();
+                traverse_const_message<Action>(wire_value, &return_value);
+                return return_value;
+            }
+
+            template<typename Action, typename ReturnType>
+                void traverse_const_message(const boost::any& wire_value, ReturnType* return_value)
             {
                 try
                 {
-                    ReturnType return_value = ReturnType();
-       
                     const google::protobuf::Message* msg = boost::any_cast<const google::protobuf::Message*>(wire_value);
-                    const google::protobuf::Descriptor* desc = msg->GetDescriptor();
                     const google::protobuf::Reflection* refl = msg->GetReflection();
-                    for(int i = 0, n = desc->field_count(); i < n; ++i)
+                    boost::shared_ptr<const internal::MessagePlan> message_plan = plan(msg->GetDescriptor());
+                    for(std::vector<internal::MessagePlanStep>::const_iterator it = message_plan->steps.begin(),
+                            end = message_plan->steps.end(); it != end; ++it)
                     {       
-                        const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
-
-                        if(!check_field(field_desc))
+                        if(Action::precomputed(*it, return_value))
                             continue;
-           
-                        boost::shared_ptr<FieldCodecBase> codec = find(field_desc);
-                        boost::shared_ptr<internal::FromProtoCppTypeBase> helper =
-                            internal::TypeHelper::find(field_desc);
-            
-            
+                        
+                        const google::protobuf::FieldDescriptor* field_desc = it->field;
+                        if(Action::reflected(it->codec, return_value, *msg, field_desc))
+                            continue;
+                        
                         if(field_desc->is_repeated())
                         {
                             std::vector<boost::any> field_values;
                             for(int j = 0, m = refl->FieldSize(*msg, field_desc); j < m; ++j)
-                                field_values.push_back(helper->get_repeated_value(field_desc, *msg, j));
+                                field_values.push_back(it->helper->get_repeated_value(field_desc, *msg, j));
                    
-                            Action::repeated(codec, &return_value, field_values, field_desc);
+                            Action::repeated(it->codec, return_value, field_values, field_desc);
                         }
                         else
                         {
-                            Action::single(codec, &return_value, helper->get_value(field_desc, *msg), field_desc);
+                            Action::single(it->codec, return_value, it->helper->get_value(field_desc, *msg), field_desc);
                         }
                     }
-                    return return_value;
                 }
                 catch(boost::bad_any_cast& e)
                 {
@@ -194,6 +243,7 @@ namespace dccl
                 }
                 
             }
+
         };
 
     }
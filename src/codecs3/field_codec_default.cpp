@@ -34,27 +34,19 @@ dccl::Bitset dccl::v3::DefaultStringCodec::encode()
 
 dccl::Bitset dccl::v3::DefaultStringCodec::encode(const std::string& wire_value)
 {
-    std::string s = wire_value;
-    if(s.size() > dccl_field_options().max_length())
+    std::string::size_type length = wire_value.size();
+    if(length > field_options().max_length)
     {
-        dccl::dlog.is(DEBUG2) && dccl::dlog << "String " << s <<  " exceeds `dccl.max_length`, truncating" << std::endl;
-        s.resize(dccl_field_options().max_length()); 
+        dccl::dlog.is(DEBUG2) && dccl::dlog << "String " << wire_value <<  " exceeds `dccl.max_length`, truncating" << std::endl;
+        length = field_options().max_length;
     }
         
-            
-    Bitset value_bits;
-    value_bits.from_byte_string(s);
-    
-    Bitset length_bits(min_size(), s.length());
-
-    dccl::dlog.is(DEBUG2) && dccl::dlog << "DefaultStringCodec value_bits: " << value_bits << std::endl;    
+    Bitset length_bits(min_size(), length);
 
-    
     dccl::dlog.is(DEBUG2) && dccl::dlog << "DefaultStringCodec length_bits: " << length_bits << std::endl;    
     
     // adds to MSBs
-    for(int i = 0, n = value_bits.size(); i < n; ++i)
-        length_bits.push_back(value_bits[i]);
+    length_bits.append_bytes(wire_value.data(), length);
 
     dccl::dlog.is(DEBUG2) && dccl::dlog << "DefaultStringCodec created: " << length_bits << std::endl;
     
@@ -80,11 +72,9 @@ std::string dccl::v3::DefaultStringCodec::decode(Bitset* bits)
 
         
         dccl::dlog.is(DEBUG2) && dccl::dlog << "bits after get_more_bits " << *bits << std::endl;    
-        Bitset string_body_bits = *bits;
-        string_body_bits >>= header_length;
-        string_body_bits.resize(bits->size() - header_length);
-    
-        return string_body_bits.to_byte_string();
+        std::string value(value_length, 0);
+        bits->copy_bytes(header_length, &value[0], value_length);
+        return value;
     }
     else
     {
@@ -93,6 +83,12 @@ std::string dccl::v3::DefaultStringCodec::decode(Bitset* bits)
     
 }
 
+void dccl::v3::DefaultStringCodec::skip(Bitset* bits)
+{
+    // `bits` holds the length
+    bits->skip_more_bits(bits->to_ulong()*BITS_IN_BYTE);
+}
+
 unsigned dccl::v3::DefaultStringCodec::size()
 {
     return min_size();
@@ -107,16 +103,16 @@ unsigned dccl::v3::DefaultStringCodec::size(const std::string& wire_value)
 unsigned dccl::v3::DefaultStringCodec::max_size()
 {
     // string length + actual string
-    return min_size() + dccl_field_options().max_length() * BITS_IN_BYTE;
+    return min_size() + field_options().max_length * BITS_IN_BYTE;
 }
 
 unsigned dccl::v3::DefaultStringCodec::min_size()
 {
-    return dccl::ceil_log2(dccl_field_options().max_length()+1);
+    return dccl::ceil_log2(field_options().max_length+1);
 }
 
 
 void dccl::v3::DefaultStringCodec::validate()
 {
-    require(dccl_field_options().has_max_length(), "missing (dccl.field).max_length");
+    require(field_options().has_max_length, "missing (dccl.field).max_length");
 }
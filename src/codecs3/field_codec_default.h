@@ -62,6 +62,7 @@ namespace dccl
             Bitset encode();
             Bitset encode(const std::string& wire_value);
             std::string decode(Bitset* bits);
+            void skip(Bitset* bits);
             unsigned size();
             unsigned size(const std::string& wire_value);
             unsigned max_size();
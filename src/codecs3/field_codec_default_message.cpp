@@ -43,6 +43,21 @@ void dccl::v3::DefaultMessageCodec::any_encode(Bitset* bits, const boost::any& w
         
     }  
 }
+
+void dccl::v3::DefaultMessageCodec::any_encode_direct(BitWriter* writer, const boost::any& wire_value)
+{
+    if(wire_value.empty())
+    {
+        writer->write_zeros(min_size());
+    }
+    else
+    {
+        if(is_optional())
+            writer->write(true, 1); // presence bit
+
+        traverse_const_message<Encoder>(wire_value, writer);
+    }
+}
   
 
  
@@ -86,28 +101,35 @@ void dccl::v3::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_va
             }
         }        
         
-        const google::protobuf::Descriptor* desc = msg->GetDescriptor();
         const google::protobuf::Reflection* refl = msg->GetReflection();
+        boost::shared_ptr<const internal::MessagePlan> message_plan = plan(msg->GetDescriptor());
+        const FieldMask* mask = decode_mask();
         
-        for(int i = 0, n = desc->field_count(); i < n; ++i)
+        for(std::vector<internal::MessagePlanStep>::const_iterator it = message_plan->steps.begin(),
+                end = message_plan->steps.end(); it != end; ++it)
         {
-        
-            const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
+            const google::protobuf::FieldDescriptor* field_desc = it->field;
+            const boost::shared_ptr<FieldCodecBase>& codec = it->codec;
+            const boost::shared_ptr<internal::FromProtoCppTypeBase>& helper = it->helper;
 
-            if(!check_field(field_desc))
+            // fields not selected by the mask (if any) are skipped over, and embedded messages decode only their selected fields
+            const FieldMask* field_mask = mask ? mask->find(field_desc->name()) : 0;
+            if(mask && !field_mask)
+            {
+                codec->field_skip(bits, field_desc);
                 continue;
+            }
+            DecodeMaskScope scoped_mask((field_mask && !field_mask->all()) ? field_mask : 0);
 
+            if(codec->field_decode_reflected(bits, msg, field_desc))
+                continue;
             
-            boost::shared_ptr<FieldCodecBase> codec = find(field_desc);            
-            boost::shared_ptr<internal::FromProtoCppTypeBase> helper =
-                internal::TypeHelper::find(field_desc);
-
             if(field_desc->is_repeated())
             {   
                 std::vector<boost::any> field_values;
                 if(field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
                 {
-                    unsigned max_repeat = field_desc->options().GetExtension(dccl::field).max_repeat();
+                    unsigned max_repeat = it->max_repeat;
                     for(unsigned j = 0, m = max_repeat; j < m; ++j)
                         field_values.push_back(refl->AddMessage(msg, field_desc));
 
@@ -159,6 +181,41 @@ void dccl::v3::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_va
 }
 
 
+void dccl::v3::DefaultMessageCodec::skip(Bitset* bits)
+{
+    if(is_optional())
+    {
+        if(!bits->to_ulong())
+            return;
+        else
+            bits->pop_front(); // presence bit
+    }
+
+    boost::shared_ptr<const internal::MessagePlan> message_plan = plan(this_descriptor());
+
+    // consecutive fixed size fields are skipped together
+    unsigned fixed_bits = 0;
+    for(std::vector<internal::MessagePlanStep>::const_iterator it = message_plan->steps.begin(),
+            end = message_plan->steps.end(); it != end; ++it)
+    {
+        if(it->fixed_size)
+        {
+            fixed_bits += it->size;
+        }
+        else
+        {
+            Bitset fixed_field_bits(bits);
+            fixed_field_bits.skip_more_bits(fixed_bits);
+            fixed_bits = 0;
+            
+            it->codec->field_skip(bits, it->field);
+        }
+    }
+    
+    Bitset fixed_field_bits(bits);
+    fixed_field_bits.skip_more_bits(fixed_bits);
+}
+
 unsigned dccl::v3::DefaultMessageCodec::max_size()
 {
     unsigned u = 0;
@@ -188,9 +245,39 @@ unsigned dccl::v3::DefaultMessageCodec::min_size()
     }
 }
 
+unsigned dccl::v3::DefaultMessageCodec::decode_prefetch_size()
+{
+    // only the presence bit is needed up front; the fields pull their own bits
+    const unsigned presence_bit = 1;
+    return is_optional() ? presence_bit : 0;
+}
+
+void dccl::v3::DefaultMessageCodec::fixed_layout(std::vector<internal::FixedLayoutField>* layout)
+{
+    boost::shared_ptr<const internal::MessagePlan> message_plan = plan(this_descriptor());
+
+    // fields are at a known offset until the first variable size field
+    unsigned offset = 0;
+    for(std::vector<internal::MessagePlanStep>::const_iterator it = message_plan->steps.begin(),
+            end = message_plan->steps.end(); it != end && it->fixed_size; ++it)
+    {
+        internal::FixedLayoutField field;
+        field.field = it->field;
+        field.codec = it->codec;
+        field.part = part();
+        field.offset = offset;
+        field.size = it->size;
+        layout->push_back(field);
+
+        offset += it->size;
+    }
+}
 
 void dccl::v3::DefaultMessageCodec::validate()
 {
+    // called by Codec::load(), so (re)compile the plans for this message
+    plan(this_descriptor(), true);
+    
     bool b = false;
     traverse_descriptor<Validate>(&b);
 }
@@ -210,15 +297,15 @@ bool dccl::v3::DefaultMessageCodec::check_field(const google::protobuf::FieldDes
     }
     else
     {
-        dccl::DCCLFieldOptions dccl_field_options = field->options().GetExtension(dccl::field);
-        if(dccl_field_options.omit()) // omit
+        const internal::FieldOptionsSnapshot& field_options = internal::FieldOptionsSnapshot::find(field);
+        if(field_options.omit) // omit
         {
             return false;
         }
         else if(internal::MessageStack::current_part() == UNKNOWN) // part not yet explicitly specified
         {
-            if((part() == HEAD && !dccl_field_options.in_head())
-               || (part() == BODY && dccl_field_options.in_head()))
+            if((part() == HEAD && !field_options.in_head)
+               || (part() == BODY && field_options.in_head))
                 return false;
             else
                 return true;
@@ -230,4 +317,42 @@ bool dccl::v3::DefaultMessageCodec::check_field(const google::protobuf::FieldDes
     }    
 }
 
+boost::shared_ptr<const dccl::internal::MessagePlan> dccl::v3::DefaultMessageCodec::plan(const google::protobuf::Descriptor* desc, bool recompile)
+{
+    internal::MessagePlanKey key(desc, part(), internal::MessageStack::current_part(), root_descriptor());
 
+    const internal::MessagePlanCache& plans = FieldCodecManager::plans(this);
+    internal::MessagePlanCache::const_iterator it = plans.find(key);
+    if(!recompile && it != plans.end() && it->second->generation == FieldCodecManager::generation())
+        return it->second;
+    
+    boost::shared_ptr<internal::MessagePlan> new_plan(new internal::MessagePlan);
+    new_plan->part = part();
+    new_plan->generation = FieldCodecManager::generation();
+
+    for(int i = 0, n = desc->field_count(); i < n; ++i)
+    {
+        const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
+        if(!check_field(field_desc))
+            continue;
+
+        internal::MessagePlanStep step;
+        step.field = field_desc;
+        step.codec = find(field_desc);
+        step.helper = internal::TypeHelper::find(field_desc);
+        if(field_desc->is_repeated())
+            step.max_repeat = internal::FieldOptionsSnapshot::find(field_desc).max_repeat;
+
+        unsigned max_sz = 0, min_sz = 0;
+        step.codec->field_max_size(&max_sz, field_desc);
+        step.codec->field_min_size(&min_sz, field_desc);
+        step.fixed_size = (max_sz == min_sz);
+        step.size = max_sz;
+        
+        new_plan->steps.push_back(step);
+    }
+
+    // `plans` is discarded if codecs were added or removed while compiling
+    FieldCodecManager::plans(this)[key] = new_plan;
+    return new_plan;
+}
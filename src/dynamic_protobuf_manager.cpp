@@ -22,6 +22,7 @@
 #include <sstream>
 
 #include "dynamic_protobuf_manager.h"
+#include "field_codec_manager.h"
 #include "logger.h"
 #include "exception.h"
 
@@ -35,6 +36,20 @@ const google::protobuf::FileDescriptor* dccl::DynamicProtobufManager::add_protob
     return return_desc; 
 }
 
+void dccl::DynamicProtobufManager::update_databases()
+{
+    // the descriptors of the old pool are destroyed, so anything cached by their address is stale
+    FieldCodecManager::invalidate_descriptors();
+    delete msg_factory_;
+    delete user_descriptor_pool_;
+    delete merged_database_;
+                
+    merged_database_ = new google::protobuf::MergedDescriptorDatabase(databases_);
+    user_descriptor_pool_ = new google::protobuf::DescriptorPool(merged_database_);
+    msg_factory_ = new google::protobuf::DynamicMessageFactory;
+    msg_factory_->SetDelegateToGeneratedFactory(true);
+}
+
 void dccl::DynamicProtobufManager::enable_disk_source_database()
 {
     if(disk_source_tree_)
@@ -232,14 +232,7 @@ namespace dccl
         }
             
             
-        void update_databases()
-        {
-            delete user_descriptor_pool_;
-            delete merged_database_;
-                
-            merged_database_ = new google::protobuf::MergedDescriptorDatabase(databases_);
-            user_descriptor_pool_ = new google::protobuf::DescriptorPool(merged_database_);
-        }
+        void update_databases();
 
         void enable_disk_source_database();
             
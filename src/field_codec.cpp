@@ -25,12 +25,6 @@
 #include "exception.h"
 #include "dccl/codec.h"
 
-dccl::MessagePart dccl::FieldCodecBase::part_ =
-    dccl::UNKNOWN;
-
-const google::protobuf::Message* dccl::FieldCodecBase::root_message_ = 0;
-const google::protobuf::Descriptor* dccl::FieldCodecBase::root_descriptor_ = 0;
-
 using dccl::dlog;
 using namespace dccl::logger;
 
@@ -53,6 +47,17 @@ void dccl::FieldCodecBase::base_encode(Bitset* bits,
 
 }
 
+void dccl::FieldCodecBase::base_encode(BitWriter* writer,
+                                       const google::protobuf::Message& field_value,
+                                       MessagePart part)
+{
+    BaseRAII scoped_globals(part, &field_value);
+
+    field_encode(writer,
+                 internal::TypeHelper::find(field_value.GetDescriptor())->get_value(field_value),
+                 0);
+}
+
 void dccl::FieldCodecBase::field_encode(Bitset* bits,
                                         const boost::any& field_value,
                                         const google::protobuf::FieldDescriptor* field)
@@ -67,10 +72,27 @@ void dccl::FieldCodecBase::field_encode(Bitset* bits,
     
     Bitset new_bits;
     any_encode(&new_bits, wire_value);
-    disp_size(field, new_bits, msg_handler.field_.size());
+    disp_size(field, new_bits.size(), context().field.size());
     bits->append(new_bits);
 }
 
+void dccl::FieldCodecBase::field_encode(BitWriter* writer,
+                                        const boost::any& field_value,
+                                        const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    if(field)
+        dlog.is(DEBUG2, ENCODE) && dlog << "Starting encode for field: " << field->DebugString() << std::flush;
+
+    boost::any wire_value;
+    field_pre_encode(&wire_value, field_value);
+
+    BitWriter::size_type start = writer->size();
+    any_encode_direct(writer, wire_value);
+    disp_size(field, writer->size() - start, context().field.size());
+}
+
 void dccl::FieldCodecBase::field_encode_repeated(Bitset* bits,
                                                  const std::vector<boost::any>& field_values,
                                                  const google::protobuf::FieldDescriptor* field)
@@ -82,11 +104,63 @@ void dccl::FieldCodecBase::field_encode_repeated(Bitset* bits,
     
     Bitset new_bits;
     any_encode_repeated(&new_bits, wire_values);
-    disp_size(field, new_bits, msg_handler.field_.size(), wire_values.size());
+    disp_size(field, new_bits.size(), context().field.size(), wire_values.size());
     bits->append(new_bits);
 }
 
-            
+void dccl::FieldCodecBase::field_encode_repeated(BitWriter* writer,
+                                                 const std::vector<boost::any>& field_values,
+                                                 const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    std::vector<boost::any> wire_values;
+    field_pre_encode_repeated(&wire_values, field_values);
+
+    BitWriter::size_type start = writer->size();
+    any_encode_repeated_direct(writer, wire_values);
+    disp_size(field, writer->size() - start, context().field.size(), wire_values.size());
+}
+
+
+bool dccl::FieldCodecBase::field_encode_reflected(BitWriter* writer,
+                                                  const google::protobuf::Message& msg,
+                                                  const google::protobuf::FieldDescriptor* field)
+{
+    if(!has_reflected_path(field))
+        return false;
+    
+    internal::MessageStack msg_handler(field);
+
+    dlog.is(DEBUG2, ENCODE) && dlog << "Starting typed encode for field: " << field->DebugString() << std::flush;
+
+    BitWriter::size_type start = writer->size();
+    if(field->is_repeated())
+    {
+        reflected_encode_repeated(writer, msg, field);
+        disp_size(field, writer->size() - start, context().field.size(), msg.GetReflection()->FieldSize(msg, field));
+    }
+    else
+    {
+        reflected_encode(writer, msg, field);
+        disp_size(field, writer->size() - start, context().field.size());
+    }
+    return true;
+}
+
+bool dccl::FieldCodecBase::field_size_reflected(unsigned* bit_size,
+                                                const google::protobuf::Message& msg,
+                                                const google::protobuf::FieldDescriptor* field)
+{
+    if(!has_reflected_path(field))
+        return false;
+
+    internal::MessageStack msg_handler(field);
+
+    *bit_size += field->is_repeated() ? reflected_size_repeated(msg, field) : reflected_size(msg, field);
+    return true;
+}
+
 void dccl::FieldCodecBase::base_size(unsigned* bit_size,
                                      const google::protobuf::Message& msg,
                                      MessagePart part)
@@ -135,6 +209,17 @@ void dccl::FieldCodecBase::base_decode(Bitset* bits,
     field_decode(bits, &value, 0);
 }
 
+void dccl::FieldCodecBase::base_decode(Bitset* bits,
+                                       google::protobuf::Message* field_value,
+                                       MessagePart part,
+                                       const FieldMask& mask)
+{
+    BaseRAII scoped_globals(part, field_value);
+    DecodeMaskScope scoped_mask(&mask);
+    boost::any value(field_value);
+    field_decode(bits, &value, 0);
+}
+
 
 void dccl::FieldCodecBase::field_decode(Bitset* bits,
                                         boost::any* field_value,
@@ -155,9 +240,7 @@ void dccl::FieldCodecBase::field_decode(Bitset* bits,
     
     Bitset these_bits(bits);
 
-    unsigned bits_to_transfer = 0;
-    field_min_size(&bits_to_transfer, field);
-    these_bits.get_more_bits(bits_to_transfer);    
+    these_bits.get_more_bits(decode_prefetch_size());
     
     dlog.is(DEBUG2, DECODE) && dlog  << "... using these bits: " << these_bits << std::endl;
 
@@ -168,6 +251,34 @@ void dccl::FieldCodecBase::field_decode(Bitset* bits,
     field_post_decode(wire_value, field_value);  
 }
 
+bool dccl::FieldCodecBase::field_decode_reflected(Bitset* bits,
+                                                  google::protobuf::Message* msg,
+                                                  const google::protobuf::FieldDescriptor* field)
+{
+    if(!has_reflected_path(field))
+        return false;
+
+    internal::MessageStack msg_handler(field);
+
+    if(!bits)
+        throw(Exception("Decode called with NULL Bitset"));
+
+    dlog.is(DEBUG2, DECODE) && dlog << "Starting typed decode for field: " << field->DebugString() << std::flush;
+
+    Bitset these_bits(bits);
+    if(field->is_repeated())
+    {
+        these_bits.get_more_bits(decode_prefetch_size_repeated());
+        reflected_decode_repeated(&these_bits, msg, field);
+    }
+    else
+    {
+        these_bits.get_more_bits(decode_prefetch_size());
+        reflected_decode(&these_bits, msg, field);
+    }
+    return true;
+}
+
 void dccl::FieldCodecBase::field_decode_repeated(Bitset* bits,
                                                  std::vector<boost::any>* field_values,
                                                  const google::protobuf::FieldDescriptor* field)
@@ -184,9 +295,7 @@ void dccl::FieldCodecBase::field_decode_repeated(Bitset* bits,
     
     Bitset these_bits(bits);
     
-    unsigned bits_to_transfer = 0;
-    field_min_size(&bits_to_transfer, field);
-    these_bits.get_more_bits(bits_to_transfer);
+    these_bits.get_more_bits(decode_prefetch_size_repeated());
     
     dlog.is(DEBUG2, DECODE) && dlog  << "using these " <<
         these_bits.size() << " bits: " << these_bits << std::endl;
@@ -199,6 +308,66 @@ void dccl::FieldCodecBase::field_decode_repeated(Bitset* bits,
 }
 
 
+void dccl::FieldCodecBase::field_skip(Bitset* bits,
+                                      const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    if(!bits)
+        throw(Exception("Skip called with NULL Bitset"));
+
+    Bitset these_bits(bits);
+    if(field && field->is_repeated())
+    {
+        these_bits.get_more_bits(decode_prefetch_size_repeated());
+        skip_repeated(&these_bits);
+    }
+    else
+    {
+        these_bits.get_more_bits(decode_prefetch_size());
+        skip(&these_bits);
+    }
+}
+
+void dccl::FieldCodecBase::skip(Bitset* bits)
+{
+    if(max_size() == min_size())
+    {
+        bits->skip_more_bits(max_size() - bits->size());
+    }
+    else
+    {
+        // messages are decoded into a scratch message
+        boost::any wire_value;
+        boost::shared_ptr<google::protobuf::Message> scratch;
+        if(this_field() && this_field()->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+        {
+            scratch = DynamicProtobufManager::new_protobuf_message(this_field()->message_type());
+            wire_value = scratch.get();
+        }
+        any_decode(bits, &wire_value);
+    }
+}
+
+// same layout as any_decode_repeated()
+void dccl::FieldCodecBase::skip_repeated(Bitset* repeated_bits)
+{
+    unsigned wire_vector_size = field_options().max_repeat;    
+    if(codec_version() > 2)
+    {
+        Bitset size_bits(repeated_bits);        
+        size_bits.get_more_bits(repeated_vector_field_size(field_options().max_repeat));
+        wire_vector_size = size_bits.to_ulong();
+    }
+
+    for(unsigned i = 0, n = wire_vector_size; i < n; ++i)
+    {
+        Bitset these_bits(repeated_bits);        
+        these_bits.get_more_bits(decode_prefetch_size());        
+        skip(&these_bits);
+    }
+}
+
 void dccl::FieldCodecBase::base_max_size(unsigned* bit_size,
                                          const google::protobuf::Descriptor* desc,
                                          MessagePart part)
@@ -279,7 +448,7 @@ void dccl::FieldCodecBase::field_validate(bool* b,
 {
     internal::MessageStack msg_handler(field);
 
-    if(field && dccl_field_options().in_head() && variable_size())
+    if(field && field_options().in_head && variable_size())
         throw(Exception("Variable size codec used in header - header fields must be encoded with fixed size codec."));
     
     validate();
@@ -299,6 +468,38 @@ void dccl::FieldCodecBase::base_info(std::ostream* os, const google::protobuf::D
 }
 
 
+void dccl::FieldCodecBase::base_fixed_layout(std::vector<internal::FixedLayoutField>* layout, const google::protobuf::Descriptor* desc, MessagePart part)
+{
+    BaseRAII scoped_globals(part, desc);
+
+    internal::MessageStack msg_handler;
+    if(desc)
+        msg_handler.push(desc);
+    else
+        throw(Exception("Fixed layout called with NULL Descriptor"));
+
+    fixed_layout(layout);
+}
+
+void dccl::FieldCodecBase::base_decode_field(Bitset* bits, boost::any* field_value,
+                                             const google::protobuf::Descriptor* desc,
+                                             const google::protobuf::FieldDescriptor* field,
+                                             MessagePart part)
+{
+    BaseRAII scoped_globals(part, desc);
+
+    internal::MessageStack msg_handler;
+    if(desc)
+        msg_handler.push(desc);
+    else
+        throw(Exception("Decode field called with NULL Descriptor"));
+
+    if(!field || field->is_repeated())
+        throw(Exception("Decode field requires a non-repeated field"));
+    
+    field_decode(bits, field_value, field);
+}
+
 void dccl::FieldCodecBase::field_info(std::ostream* os,
                                       const google::protobuf::FieldDescriptor* field)
 {
@@ -310,7 +511,7 @@ void dccl::FieldCodecBase::field_info(std::ostream* os,
     
     std::string name = ((this_field()) ? boost::lexical_cast<std::string>(this_field()->number()) + ". " + this_field()->name() : this_descriptor()->full_name());
     if(this_field() && this_field()->is_repeated())
-        name += "[" + boost::lexical_cast<std::string>(dccl_field_options().max_repeat()) + "]";
+        name += "[" + boost::lexical_cast<std::string>(field_options().max_repeat) + "]";
     
     
     if(!this_field() || this_field()->type() == google::protobuf::FieldDescriptor::TYPE_MESSAGE)
@@ -343,7 +544,7 @@ void dccl::FieldCodecBase::field_info(std::ostream* os,
     int width = this_field() ? full_width-name.size() : full_width-name.size()+spaces;
     ss << indent << name <<
         std::setfill('.') << std::setw(std::max(1, width)) << range.str()
-       << " {" << (this_field() ? FieldCodecManager::find(this_field(), has_codec_group(), codec_group())->name() : FieldCodecManager::find(root_descriptor_)->name()) << "}";
+       << " {" << (this_field() ? FieldCodecManager::find(this_field(), has_codec_group(), codec_group())->name() : FieldCodecManager::find(root_descriptor())->name()) << "}";
 
     
     
@@ -383,13 +584,13 @@ void dccl::FieldCodecBase::any_encode_repeated(dccl::Bitset* bits, const std::ve
 {
     // out_bits = [field_values[2]][field_values[1]][field_values[0]]
 
-    unsigned wire_vector_size = dccl_field_options().max_repeat();
+    unsigned wire_vector_size = field_options().max_repeat;
 
     // for DCCL3 and beyond, add a prefix numeric field giving the vector size (rather than always going to max_repeat
     if(codec_version() > 2)
     {
-        wire_vector_size = std::min((int)dccl_field_options().max_repeat(), (int)wire_values.size());    
-        Bitset size_bits(repeated_vector_field_size(dccl_field_options().max_repeat()), wire_values.size());
+        wire_vector_size = std::min((int)field_options().max_repeat, (int)wire_values.size());    
+        Bitset size_bits(repeated_vector_field_size(field_options().max_repeat), wire_values.size());
         bits->append(size_bits);
     }    
 
@@ -406,15 +607,34 @@ void dccl::FieldCodecBase::any_encode_repeated(dccl::Bitset* bits, const std::ve
 }
 
 
+void dccl::FieldCodecBase::any_encode_repeated_each_direct(BitWriter* writer, const std::vector<boost::any>& wire_values)
+{
+    unsigned wire_vector_size = field_options().max_repeat;
+
+    if(codec_version() > 2)
+    {
+        wire_vector_size = std::min((int)field_options().max_repeat, (int)wire_values.size());
+        writer->write(wire_values.size(), repeated_vector_field_size(field_options().max_repeat));
+    }
+
+    for(unsigned i = 0, n = wire_vector_size; i < n; ++i)
+    {
+        if(i < wire_values.size())
+            any_encode_direct(writer, wire_values[i]);
+        else
+            any_encode_direct(writer, boost::any());
+    }
+}
+
 
 void dccl::FieldCodecBase::any_decode_repeated(Bitset* repeated_bits, std::vector<boost::any>* wire_values)
 {
 
-    unsigned wire_vector_size = dccl_field_options().max_repeat();    
+    unsigned wire_vector_size = field_options().max_repeat;    
     if(codec_version() > 2)
     {
         Bitset size_bits(repeated_bits);        
-        size_bits.get_more_bits(repeated_vector_field_size(dccl_field_options().max_repeat()));
+        size_bits.get_more_bits(repeated_vector_field_size(field_options().max_repeat));
 
         wire_vector_size = size_bits.to_ulong();
     }
@@ -424,7 +644,7 @@ void dccl::FieldCodecBase::any_decode_repeated(Bitset* repeated_bits, std::vecto
     for(unsigned i = 0, n = wire_vector_size; i < n; ++i)
     {
         Bitset these_bits(repeated_bits);        
-        these_bits.get_more_bits(min_size());        
+        these_bits.get_more_bits(decode_prefetch_size());        
         any_decode(&these_bits, &(*wire_values)[i]);
     }
 }
@@ -432,12 +652,12 @@ void dccl::FieldCodecBase::any_decode_repeated(Bitset* repeated_bits, std::vecto
 unsigned dccl::FieldCodecBase::any_size_repeated(const std::vector<boost::any>& wire_values)
 {
     unsigned out = 0;
-    unsigned wire_vector_size = dccl_field_options().max_repeat();
+    unsigned wire_vector_size = field_options().max_repeat;
 
     if(codec_version() > 2)
     {
-        wire_vector_size = std::min((int)dccl_field_options().max_repeat(), (int)wire_values.size());    
-        out += repeated_vector_field_size(dccl_field_options().max_repeat());
+        wire_vector_size = std::min((int)field_options().max_repeat, (int)wire_values.size());    
+        out += repeated_vector_field_size(field_options().max_repeat);
     }    
 
     for(unsigned i = 0, n = wire_vector_size; i < n; ++i)
@@ -452,24 +672,57 @@ unsigned dccl::FieldCodecBase::any_size_repeated(const std::vector<boost::any>&
 
 unsigned dccl::FieldCodecBase::max_size_repeated()
 {    
-    if(!dccl_field_options().has_max_repeat())
+    if(!field_options().has_max_repeat)
         throw(Exception("Missing (dccl.field).max_repeat option on `repeated` field: " + this_field()->DebugString()));
     else if(codec_version() > 2)
-        return repeated_vector_field_size(dccl_field_options().max_repeat()) + max_size() * dccl_field_options().max_repeat();
+        return repeated_vector_field_size(field_options().max_repeat) + max_size() * field_options().max_repeat;
     else
-        return max_size() * dccl_field_options().max_repeat();
+        return max_size() * field_options().max_repeat;
 }
 
 unsigned dccl::FieldCodecBase::min_size_repeated()
 {    
-    if(!dccl_field_options().has_max_repeat())
+    if(!field_options().has_max_repeat)
         throw(Exception("Missing (dccl.field).max_repeat option on `repeated` field " + this_field()->DebugString()));
     else if(codec_version() > 2)
-        return repeated_vector_field_size(dccl_field_options().max_repeat());    
+        return repeated_vector_field_size(field_options().max_repeat);    
     else
-        return min_size() * dccl_field_options().max_repeat();
+        return min_size() * field_options().max_repeat;
 }
 
+unsigned dccl::FieldCodecBase::decode_prefetch_size_repeated()
+{
+    // version 3 only needs the vector size prefix up front. Version 2 has a fixed number of elements, so a codec that prefetches less than min_size() (e.g. the default message codec) prefetches that for each element; any other codec (including those with their own repeated layout, such as RepeatedTypedFieldCodec) gets min_size_repeated() as before
+    if(codec_version() > 2 || decode_prefetch_size() == min_size())
+        return min_size_repeated();
+    else
+        return decode_prefetch_size() * field_options().max_repeat;
+}
+
+void dccl::FieldCodecBase::reflected_encode(BitWriter* writer, const google::protobuf::Message& msg,
+                                            const google::protobuf::FieldDescriptor* field)
+{ throw(Exception("Codec " + name() + " has no typed (reflected) encode")); }
+
+void dccl::FieldCodecBase::reflected_encode_repeated(BitWriter* writer, const google::protobuf::Message& msg,
+                                                     const google::protobuf::FieldDescriptor* field)
+{ throw(Exception("Codec " + name() + " has no typed (reflected) repeated encode")); }
+
+unsigned dccl::FieldCodecBase::reflected_size(const google::protobuf::Message& msg,
+                                              const google::protobuf::FieldDescriptor* field)
+{ throw(Exception("Codec " + name() + " has no typed (reflected) size")); }
+
+unsigned dccl::FieldCodecBase::reflected_size_repeated(const google::protobuf::Message& msg,
+                                                       const google::protobuf::FieldDescriptor* field)
+{ throw(Exception("Codec " + name() + " has no typed (reflected) repeated size")); }
+
+void dccl::FieldCodecBase::reflected_decode(Bitset* bits, google::protobuf::Message* msg,
+                                            const google::protobuf::FieldDescriptor* field)
+{ throw(Exception("Codec " + name() + " has no typed (reflected) decode")); }
+
+void dccl::FieldCodecBase::reflected_decode_repeated(Bitset* repeated_bits, google::protobuf::Message* msg,
+                                                     const google::protobuf::FieldDescriptor* field)
+{ throw(Exception("Codec " + name() + " has no typed (reflected) repeated decode")); }
+
 void dccl::FieldCodecBase::any_pre_encode_repeated(std::vector<boost::any>* wire_values, const std::vector<boost::any>& field_values)
 {
     for(std::vector<boost::any>::const_iterator it = field_values.begin(),
@@ -498,19 +751,19 @@ void dccl::FieldCodecBase::any_post_decode_repeated(
 // FieldCodecBase private
 //
 
-void dccl::FieldCodecBase::disp_size(const google::protobuf::FieldDescriptor* field, const Bitset& new_bits, int depth, int vector_size /* = -1 */)
+void dccl::FieldCodecBase::disp_size(const google::protobuf::FieldDescriptor* field, unsigned bit_size, int depth, int vector_size /* = -1 */)
 {
-    if(!root_descriptor_)
+    if(!root_descriptor())
         return;
 
     if(dlog.is(INFO, SIZE))
     {   
-        std::string name = ((field) ? field->name() : root_descriptor_->full_name());
+        std::string name = ((field) ? field->name() : root_descriptor()->full_name());
         if(vector_size >= 0)
             name +=  "[" + boost::lexical_cast<std::string>(vector_size) +  "]";
 
         
-        dlog << std::string(depth, '|') << name << std::setfill('.') << std::setw(40-name.size()-depth) << new_bits.size() << std::endl;
+        dlog << std::string(depth, '|') << name << std::setfill('.') << std::setw(40-name.size()-depth) << bit_size << std::endl;
         
         if(!field)
             dlog << std::endl;
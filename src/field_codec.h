@@ -38,11 +38,18 @@
 #include "internal/type_helper.h"
 #include "internal/field_codec_message_stack.h"
 #include "dccl/binary.h"
+#include "dccl/bitwriter.h"
+#include "dccl/field_mask.h"
 
 namespace dccl
 {
     class Codec;
 
+    namespace internal
+    {
+        struct FixedLayoutField;
+    }
+
     /// \brief Provides a base class for defining DCCL field encoders / decoders. Most users who wish to define custom encoders/decoders will use the RepeatedTypedFieldCodec, TypedFieldCodec or its children (e.g. TypedFixedFieldCodec) instead of directly inheriting from this class.
     class FieldCodecBase
     {
@@ -73,7 +80,10 @@ namespace dccl
         ///
         /// \return FieldDescriptor for the current field or 0 if this codec is encoding the base message.
         const google::protobuf::FieldDescriptor* this_field() const 
-        { return !internal::MessageStack::field_.empty() ? internal::MessageStack::field_.back() : 0; }
+        {
+            const std::vector<const google::protobuf::FieldDescriptor*>& field = context().field;
+            return !field.empty() ? field.back() : 0;
+        }
             
         /// \brief Returns the Descriptor (message schema meta-data) for the immediate parent Message
         ///
@@ -89,18 +99,26 @@ namespace dccl
         /// returns Descriptor for Foo if this_field() == FieldDescriptor for bar
         /// returns Descriptor for FooBar if this_field() == FieldDescriptor for baz
         static const google::protobuf::Descriptor* this_descriptor()
-        { return !internal::MessageStack::desc_.empty() ? internal::MessageStack::desc_.back() : 0; }
+        {
+            const std::vector<const google::protobuf::Descriptor*>& desc = context().desc;
+            return !desc.empty() ? desc.back() : 0;
+        }
 
         // currently encoded or (partially) decoded root message
         static const google::protobuf::Message* root_message()
-        { return root_message_; }
+        { return context().root_message; }
+
+        // descriptor of the currently encoded, decoded (or validated, etc.) root message
+        static const google::protobuf::Descriptor* root_descriptor()
+        { return context().root_descriptor; }
 
         static bool has_codec_group()
         {
-            if(root_descriptor_)
+            const google::protobuf::Descriptor* root_desc = root_descriptor();
+            if(root_desc)
             {
-                return root_descriptor_->options().GetExtension(dccl::msg).has_codec_group() ||
-                    root_descriptor_->options().GetExtension(dccl::msg).has_codec_version();
+                return root_desc->options().GetExtension(dccl::msg).has_codec_group() ||
+                    root_desc->options().GetExtension(dccl::msg).has_codec_version();
             }
             else
                 return false;
@@ -109,13 +127,21 @@ namespace dccl
         static std::string codec_group(const google::protobuf::Descriptor* desc);
 
         static std::string codec_group()
-        { return codec_group(root_descriptor_); }
+        { return codec_group(root_descriptor()); }
 
         static int codec_version()
-        { return root_descriptor_->options().GetExtension(dccl::msg).codec_version(); }
+        { return root_descriptor()->options().GetExtension(dccl::msg).codec_version(); }
+
+        /// \brief Fields of the message currently being decoded that are to be decoded (the others are to be skipped with field_skip()), or 0 to decode all fields. This is only used by message codecs.
+        static const FieldMask* decode_mask()
+        { return context().decode_mask; }
             
         /// \brief the part of the message currently being encoded (head or body).
-        static MessagePart part() { return part_; }
+        static MessagePart part() { return context().part; }
+
+        /// \brief State of the encode, decode, etc. call in progress on this thread (from which this_field(), this_descriptor(), part(), root_message(), etc. are read)
+        static internal::CodecContext& context()
+        { return internal::CodecContext::current(); }
             
         //@}
 
@@ -140,6 +166,15 @@ namespace dccl
                          const google::protobuf::Message& msg,
                          MessagePart part);
 
+        /// \brief Encode this part (body or head) of the base message directly into a byte buffer
+        ///
+        /// \param writer BitWriter to write the encoded bits to (starting at its current position)
+        /// \param msg DCCL Message to encode
+        /// \param part Part of the message to encode
+        void base_encode(BitWriter* writer,
+                         const google::protobuf::Message& msg,
+                         MessagePart part);
+
         /// \brief Calculate the size (in bits) of a part of the base message when it is encoded
         ///
         /// \param bit_size Pointer to unsigned integer to store the result.
@@ -156,6 +191,17 @@ namespace dccl
                          google::protobuf::Message* msg,
                          MessagePart part);
 
+        /// \brief Decode only the selected fields of part of a message, skipping over the others
+        ///
+        /// \param bits Pointer to a Bitset containing bits to decode. The least significant bits will be consumed first. Any bits not consumed will remain in `bits` after this method returns.
+        /// \param msg DCCL Message to <i>merge</i> the decoded fields into.
+        /// \param part part of the Message to decode
+        /// \param mask Fields to decode
+        void base_decode(Bitset* bits,
+                         google::protobuf::Message* msg,
+                         MessagePart part,
+                         const FieldMask& mask);
+
         /// \brief Calculate the maximum size of a message given its Descriptor alone (no data)
         ///
         /// \param bit_size Pointer to unsigned integer to store calculated maximum size in bits.
@@ -182,6 +228,25 @@ namespace dccl
         /// \param desc Descriptor to get information on. Use google::protobuf::Message::GetDescriptor() or MyProtobufType::descriptor() to get this object.
         /// \param part the part of the Message to act on.
         void base_info(std::ostream* os, const google::protobuf::Descriptor* desc, MessagePart part);
+
+        /// \brief Find the fields of this part of the message that are always encoded at the same position (those preceded only by fixed size fields)
+        ///
+        /// \param layout Pointer to a vector to append the fields (in encoding order) to
+        /// \param desc Descriptor of the message
+        /// \param part part of the Message
+        void base_fixed_layout(std::vector<internal::FixedLayoutField>* layout, const google::protobuf::Descriptor* desc, MessagePart part);
+
+        /// \brief Decode a single (non-repeated) field of a message on its own, given the bits starting at its position in the encoded message
+        ///
+        /// \param bits Pointer to a Bitset (usually reading from a BitReader) from which the field's bits will be consumed
+        /// \param field_value Pointer to store the decoded value (left empty if the field is not set)
+        /// \param desc Descriptor of the message containing `field`
+        /// \param field Field to decode (this codec must be the codec for this field)
+        /// \param part part of the Message that contains the field
+        void base_decode_field(Bitset* bits, boost::any* field_value,
+                               const google::protobuf::Descriptor* desc,
+                               const google::protobuf::FieldDescriptor* field,
+                               MessagePart part);
         //@}
             
         /// \name Field functions (primitive types and embedded messages)
@@ -222,6 +287,15 @@ namespace dccl
                           const boost::any& field_value,
                           const google::protobuf::FieldDescriptor* field);
 
+        /// \brief Encode a non-repeated field directly into a byte buffer.
+        ///
+        /// \param writer BitWriter to write the encoded bits to (starting at its current position)
+        /// \param field_value Value to encode (FieldType)
+        /// \param field Protobuf descriptor to the field to encode. Set to 0 for base message.
+        void field_encode(BitWriter* writer,
+                          const boost::any& field_value,
+                          const google::protobuf::FieldDescriptor* field);
+
         /// \brief Encode a repeated field.
         ///
         /// \param bits Pointer to bitset to store encoded bits. Bits are added to the most significant end of `bits`
@@ -231,6 +305,15 @@ namespace dccl
                                    const std::vector<boost::any>& field_values,
                                    const google::protobuf::FieldDescriptor* field);
 
+        /// \brief Encode a repeated field directly into a byte buffer.
+        ///
+        /// \param writer BitWriter to write the encoded bits to (starting at its current position)
+        /// \param field_values Values to encode (FieldType)
+        /// \param field Protobuf descriptor to the field. Set to 0 for base message.
+        void field_encode_repeated(BitWriter* writer,
+                                   const std::vector<boost::any>& field_values,
+                                   const google::protobuf::FieldDescriptor* field);
+
         /// \brief Calculate the size of a field
         ///
         /// \param bit_size Location to <i>add</i> calculated bit size to. Be sure to zero `bit_size` if you want only the size of this field.
@@ -247,6 +330,26 @@ namespace dccl
         void field_size_repeated(unsigned* bit_size, const std::vector<boost::any>& wire_values,
                                  const google::protobuf::FieldDescriptor* field);
 
+        /// \brief Encode a field (repeated or not) directly from the message containing it, without boxing the value(s) in boost::any.
+        ///
+        /// \param writer BitWriter to write the encoded bits to (starting at its current position)
+        /// \param msg Message containing `field`
+        /// \param field Protobuf descriptor to the field to encode
+        /// \return false (and nothing is written) if this codec has no typed path for `field`; use field_encode() or field_encode_repeated() instead.
+        bool field_encode_reflected(BitWriter* writer,
+                                    const google::protobuf::Message& msg,
+                                    const google::protobuf::FieldDescriptor* field);
+
+        /// \brief Calculate the size of a field (repeated or not) directly from the message containing it, without boxing the value(s) in boost::any.
+        ///
+        /// \param bit_size Location to <i>add</i> calculated bit size to.
+        /// \param msg Message containing `field`
+        /// \param field Protobuf descriptor to the field
+        /// \return false (and `bit_size` is unchanged) if this codec has no typed path for `field`; use field_size() or field_size_repeated() instead.
+        bool field_size_reflected(unsigned* bit_size,
+                                  const google::protobuf::Message& msg,
+                                  const google::protobuf::FieldDescriptor* field);
+
         // traverse mutable
         /// \brief Decode a non-repeated field
         ///
@@ -266,6 +369,22 @@ namespace dccl
                                    std::vector<boost::any>* field_values,
                                    const google::protobuf::FieldDescriptor* field);
 
+        /// \brief Decode a field (repeated or not) directly into the message containing it, without boxing the value(s) in boost::any.
+        ///
+        /// \param bits Bits to decode. Used bits are consumed (erased) from the least significant end
+        /// \param msg Message containing `field`. Decoded values are set (or added, for repeated fields) using its Reflection.
+        /// \param field Protobuf descriptor to the field
+        /// \return false (and no bits are consumed) if this codec has no typed path for `field`; use field_decode() or field_decode_repeated() instead.
+        bool field_decode_reflected(Bitset* bits,
+                                    google::protobuf::Message* msg,
+                                    const google::protobuf::FieldDescriptor* field);
+
+        /// \brief Skip over a field (repeated or not), consuming the same bits as decoding it would, without decoding its value(s)
+        ///
+        /// \param bits Bitset containing the bits to skip. Bits are consumed from the least significant end (as field_decode()).
+        /// \param field Protobuf descriptor to the field to skip.
+        void field_skip(Bitset* bits, const google::protobuf::FieldDescriptor* field);
+
         /// \brief Post-decodes a non-repeated (i.e. optional or required) field by converting the WireType (the type used in the encoded DCCL message) representation into the FieldType representation (the Google Protobuf representation). This allows for type-converting codecs.
         ///
         /// \param wire_value Should be set to the desired value to translate
@@ -314,14 +433,23 @@ namespace dccl
         /// \brief Get the DCCL field option extension value for the current field
         ///
         /// dccl::DCCLFieldOptions is defined in acomms_option_extensions.proto
-        dccl::DCCLFieldOptions dccl_field_options() const 
+        const dccl::DCCLFieldOptions& dccl_field_options() const 
         {
             if(this_field())
-                return this_field()->options().GetExtension(dccl::field);
+                return *field_options().extension;
             else
                 throw(Exception("Cannot call dccl_field on base message (has no *field* option extension"));                
                 
         }
+
+        /// \brief Get the (dccl.field) options of this field as a compact snapshot. Prefer this to dccl_field_options() in frequently called methods (encode, decode, size, etc.).
+        const internal::FieldOptionsSnapshot& field_options() const 
+        {
+            if(this_field())
+                return *context().field_options.back();
+            else
+                throw(Exception("Cannot call field_options on base message (has no *field* option extension"));                
+        }
             
         /// \brief Essentially an assertion to be used in the validate() virtual method
         ///
@@ -364,9 +492,21 @@ namespace dccl
         /// \param wire_value Value to encode (WireType)
         virtual void any_encode(Bitset* bits, const boost::any& wire_value) = 0;
 
+        /// \brief Virtual method used to encode directly into the output buffer
+        ///
+        /// The default implementation encodes into a temporary Bitset using any_encode() and writes the result. Codecs (such as the default message codecs) may override this to avoid the intermediate Bitset.
+        /// \param writer BitWriter to write the encoded bits to (starting at its current position)
+        /// \param wire_value Value to encode (WireType)
+        virtual void any_encode_direct(BitWriter* writer, const boost::any& wire_value)
+        {
+            Bitset bits;
+            any_encode(&bits, wire_value);
+            writer->write(bits);
+        }
+
         /// \brief Virtual method used to decode
         ///
-        /// \param bits Bitset containing bits to decode. This will initially contain min_size() bits. If you need more bits, call get_more_bits() with the number of bits required. This bits will be consumed from the bit pool and placed in `bits`.
+        /// \param bits Bitset containing bits to decode. This will initially contain decode_prefetch_size() bits (min_size() unless overridden). If you need more bits, call get_more_bits() with the number of bits required. This bits will be consumed from the bit pool and placed in `bits`.
         /// \param wire_value Place to store decoded value (as FieldType)
         virtual void any_decode(Bitset* bits, boost::any* wire_value) = 0;
 
@@ -411,7 +551,40 @@ namespace dccl
         /// \return Minimum size of this field (in bits).
         virtual unsigned min_size() = 0;
 
+        /// \brief Calculate the number of bits placed in `bits` before any_decode() is called
+        ///
+        /// Codecs that request the remainder of their bits on demand using get_more_bits() may return fewer bits than min_size(), so that those bits are not first copied through an intermediate Bitset. The default message codecs do this so that nested messages are decoded directly from the encoded bytes.
+        /// \return Number of bits initially given to any_decode() (defaults to min_size()).
+        virtual unsigned decode_prefetch_size() { return min_size(); }
+
+        /// \brief Skip over an encoded value without decoding it
+        ///
+        /// \param bits Bits of this value: contains decode_prefetch_size() bits (as for any_decode()). Call get_more_bits() or skip_more_bits() to consume the rest of the value.
+        /// The default implementation skips the remaining bits of fixed size values and otherwise decodes the value and discards it. Variable size codecs can override this to skip more cheaply.
+        virtual void skip(Bitset* bits);
+
+        /// \brief Skip over an encoded repeated field without decoding it
+        ///
+        /// The default implementation skips each value using skip(), assuming the layout used by any_decode_repeated(). Codecs that override any_decode_repeated() must override this as well.
+        virtual void skip_repeated(Bitset* repeated_bits);
+
+        /// \brief For message codecs: append the fields of the current message (this_descriptor()) that are always encoded at the same position, as base_fixed_layout()
+        ///
+        /// The default implementation appends nothing, which is always correct.
+        virtual void fixed_layout(std::vector<internal::FixedLayoutField>* layout) { }
+
         virtual void any_encode_repeated(Bitset* bits, const std::vector<boost::any>& wire_values);
+
+        /// \brief Encode a repeated field directly into the output buffer. The default implementation encodes into a temporary Bitset using any_encode_repeated().
+        virtual void any_encode_repeated_direct(BitWriter* writer, const std::vector<boost::any>& wire_values)
+        {
+            Bitset bits;
+            any_encode_repeated(&bits, wire_values);
+            writer->write(bits);
+        }
+
+        /// \brief Writes the default repeated field layout (as any_encode_repeated()), using any_encode_direct() for each element. For codecs that override any_encode_direct() but not any_encode_repeated().
+        void any_encode_repeated_each_direct(BitWriter* writer, const std::vector<boost::any>& wire_values);
         virtual void any_decode_repeated(Bitset* repeated_bits, std::vector<boost::any>* field_values);
 
         virtual void any_pre_encode_repeated(std::vector<boost::any>* wire_values,
@@ -423,6 +596,50 @@ namespace dccl
         virtual unsigned any_size_repeated(const std::vector<boost::any>& wire_values);
         virtual unsigned max_size_repeated();
         virtual unsigned min_size_repeated();
+
+        // no boost::any: values are read from and written to the containing message directly.
+        // Used in place of the boost::any virtuals above for fields where has_reflected_path() is true.
+        // Implemented by TypedFieldCodec.
+
+        /// \brief Whether this codec can encode, size and decode `field` using the reflected_* methods.
+        virtual bool has_reflected_path(const google::protobuf::FieldDescriptor* field)
+        { return false; }
+        /// \brief Encode the non-repeated `field` of `msg` (the equivalent of any_pre_encode() followed by any_encode())
+        virtual void reflected_encode(BitWriter* writer, const google::protobuf::Message& msg,
+                                      const google::protobuf::FieldDescriptor* field);
+        /// \brief Encode the repeated `field` of `msg` (the equivalent of any_pre_encode_repeated() followed by any_encode_repeated())
+        virtual void reflected_encode_repeated(BitWriter* writer, const google::protobuf::Message& msg,
+                                               const google::protobuf::FieldDescriptor* field);
+        /// \brief Return the size of the non-repeated `field` of `msg`
+        virtual unsigned reflected_size(const google::protobuf::Message& msg,
+                                        const google::protobuf::FieldDescriptor* field);
+        /// \brief Return the size of the repeated `field` of `msg`
+        virtual unsigned reflected_size_repeated(const google::protobuf::Message& msg,
+                                                 const google::protobuf::FieldDescriptor* field);
+        /// \brief Decode the non-repeated `field` into `msg` (the equivalent of any_decode() followed by any_post_decode())
+        virtual void reflected_decode(Bitset* bits, google::protobuf::Message* msg,
+                                      const google::protobuf::FieldDescriptor* field);
+        /// \brief Decode the repeated `field` into `msg` (the equivalent of any_decode_repeated() followed by any_post_decode_repeated())
+        virtual void reflected_decode_repeated(Bitset* repeated_bits, google::protobuf::Message* msg,
+                                               const google::protobuf::FieldDescriptor* field);
+
+        int repeated_vector_field_size(int max_repeat)
+        { return dccl::ceil_log2(max_repeat+1); }
+
+        /// \brief Sets decode_mask() until destroyed (for message codecs decoding embedded messages)
+        class DecodeMaskScope
+        {
+          public:
+            DecodeMaskScope(const FieldMask* mask)
+                : context_(FieldCodecBase::context()),
+                previous_(context_.decode_mask)
+            { context_.decode_mask = mask; }
+            ~DecodeMaskScope()
+            { context_.decode_mask = previous_; }
+          private:
+            internal::CodecContext& context_;
+            const FieldMask* previous_;
+        };
             
         friend class FieldCodecManager;
       private:
@@ -442,45 +659,61 @@ namespace dccl
                 return max_size() != min_size();
         }            
 
-        int repeated_vector_field_size(int max_repeat)
-        { return dccl::ceil_log2(max_repeat+1); }
+        unsigned decode_prefetch_size_repeated();
 
-        void disp_size(const google::protobuf::FieldDescriptor* field, const Bitset& new_bits, int depth, int vector_size = -1);
+        void disp_size(const google::protobuf::FieldDescriptor* field, unsigned bit_size, int depth, int vector_size = -1);
         
         
       private:
-        // sets global statics relating the current message begin processed
-        // and unsets them on destruction
-        struct BaseRAII
+        // sets the context relating to the current message being processed
+        // and restores it on destruction
+        class BaseRAII
         {
+          public:
             BaseRAII(MessagePart part,
                      const google::protobuf::Descriptor* root_descriptor)
+                : context_(FieldCodecBase::context()),
+                previous_part_(context_.part),
+                previous_root_message_(context_.root_message),
+                previous_root_descriptor_(context_.root_descriptor),
+                previous_decode_mask_(context_.decode_mask)
                 {
-                    FieldCodecBase::part_ = part;
-                    FieldCodecBase::root_message_ = 0;
-                    FieldCodecBase::root_descriptor_ = root_descriptor;
+                    set(part, 0, root_descriptor);
                 }
 
             BaseRAII(MessagePart part,            
                      const google::protobuf::Message* root_message)
+                : context_(FieldCodecBase::context()),
+                previous_part_(context_.part),
+                previous_root_message_(context_.root_message),
+                previous_root_descriptor_(context_.root_descriptor),
+                previous_decode_mask_(context_.decode_mask)
                 {
-                    FieldCodecBase::part_ = part;
-                    FieldCodecBase::root_message_ = root_message;
-                    FieldCodecBase::root_descriptor_ = root_message->GetDescriptor();                    
+                    set(part, root_message, root_message->GetDescriptor());
                 }
             ~BaseRAII()
                 {
-                    FieldCodecBase::part_ = dccl::UNKNOWN;
-                    FieldCodecBase::root_message_ = 0;
-                    FieldCodecBase::root_descriptor_ = 0;
+                    set(previous_part_, previous_root_message_, previous_root_descriptor_);
+                    context_.decode_mask = previous_decode_mask_;
                 }
+          private:
+            void set(MessagePart part,
+                     const google::protobuf::Message* root_message,
+                     const google::protobuf::Descriptor* root_descriptor)
+            {
+                context_.part = part;
+                context_.root_message = root_message;
+                context_.root_descriptor = root_descriptor;
+                context_.decode_mask = 0;
+            }
+            
+            internal::CodecContext& context_;
+            MessagePart previous_part_;
+            const google::protobuf::Message* previous_root_message_;
+            const google::protobuf::Descriptor* previous_root_descriptor_;
+            const FieldMask* previous_decode_mask_;
         };
         
-        
-        static MessagePart part_;
-        static const google::protobuf::Message* root_message_;
-        static const google::protobuf::Descriptor* root_descriptor_;
-        
         std::string name_;
         google::protobuf::FieldDescriptor::Type field_type_;
         google::protobuf::FieldDescriptor::CppType wire_type_;
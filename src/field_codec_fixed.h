@@ -46,6 +46,26 @@ namespace dccl
           
       unsigned min_size()
       { return size(); }          
+
+      // the size does not depend on the value, so it is not read (or converted with pre_encode()) to find the size
+      unsigned reflected_size(const google::protobuf::Message& msg,
+                              const google::protobuf::FieldDescriptor* field)
+      { return size(); }
+
+      // same layout as FieldCodecBase::any_size_repeated()
+      unsigned reflected_size_repeated(const google::protobuf::Message& msg,
+                                       const google::protobuf::FieldDescriptor* field)
+      {
+          unsigned out = 0;
+          unsigned wire_vector_size = this->field_options().max_repeat;
+          if(FieldCodecBase::codec_version() > 2)
+          {
+              unsigned field_size = msg.GetReflection()->FieldSize(msg, field);
+              wire_vector_size = std::min(wire_vector_size, field_size);
+              out += this->repeated_vector_field_size(this->field_options().max_repeat);
+          }
+          return out + wire_vector_size*size();
+      }
     };
 }
 
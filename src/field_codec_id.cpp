@@ -32,20 +32,17 @@ dccl::Bitset dccl::DefaultIdentifierCodec::encode()
 
 dccl::Bitset dccl::DefaultIdentifierCodec::encode(const uint32& id)
 {
-    if(id <= ONE_BYTE_MAX_ID)
-    {
-        return(dccl::Bitset(this_size(id), id) << 1);
-    }
-    else
+    const unsigned num_bits = this_size(id);
+    dccl::Bitset return_bits(num_bits);
+    // id goes above the LSB
+    return_bits.write_bits(1, num_bits - 1, id);
+
+    if(id > ONE_BYTE_MAX_ID)
     {
-        dccl::Bitset return_bits(this_size(id), id);
-        return_bits <<= 1;
         // set LSB to indicate long header form
         return_bits.set(0, true);
-
-        
-        return return_bits;
     }
+    return return_bits;
 }
 
 dccl::uint32 dccl::DefaultIdentifierCodec::decode(Bitset* bits)
@@ -55,16 +52,10 @@ dccl::uint32 dccl::DefaultIdentifierCodec::decode(Bitset* bits)
         // long header
         // grabs more bits to add to the MSB of `bits`
         bits->get_more_bits((LONG_FORM_ID_BYTES - SHORT_FORM_ID_BYTES)*BITS_IN_BYTE);
-        // discard identifier
-        *(bits) >>= 1;
-        return bits->to_ulong();
-    }
-    else
-    {
-        // short header
-        *(bits) >>= 1;
-        return bits->to_ulong();
     }
+
+    // discard the long form flag (LSB)
+    return bits->read_bits(1, bits->size() - 1);
 }
 
 unsigned dccl::DefaultIdentifierCodec::size()
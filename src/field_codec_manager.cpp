@@ -21,19 +21,76 @@
 // along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
 #include "field_codec_manager.h"
 
-std::map<google::protobuf::FieldDescriptor::Type, dccl::FieldCodecManager::InsideMap> dccl::FieldCodecManager::codecs_;
+boost::shared_ptr<const dccl::FieldCodecManager::Registry> dccl::FieldCodecManager::registry_(new Registry);
+std::mutex dccl::FieldCodecManager::registry_mutex_;
+std::atomic<unsigned> dccl::FieldCodecManager::generation_(1);
+std::atomic<unsigned> dccl::FieldCodecManager::descriptor_generation_(0);
 
+namespace
+{
+    // set once this thread's cache has been destroyed (e.g. a Codec destroyed after it at exit)
+    thread_local bool thread_cache_destroyed = false;
+}
+
+dccl::FieldCodecManager::ThreadCache& dccl::FieldCodecManager::thread_cache()
+{
+    struct DestroyedFlag
+    {
+        ~DestroyedFlag() { thread_cache_destroyed = true; }
+    };
+    static thread_local ThreadCache cache;
+    // destroyed before cache
+    static thread_local DestroyedFlag flag;
+    (void)flag;
+
+    // only take the lock if codecs have been added or removed since this thread last looked
+    if(cache.generation != generation_.load(std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        cache.registry = registry_;
+        cache.generation = generation_.load(std::memory_order_relaxed);
+        cache.field_cache.clear();
+        cache.desc_cache.clear();
+        cache.plans.clear();
+    }
+
+    // the cached results are only copied out of these maps, so they may be cleared even while a call is in progress
+    unsigned descriptor_generation = descriptor_generation_.load(std::memory_order_acquire);
+    if(cache.descriptor_generation != descriptor_generation)
+    {
+        cache.field_cache.clear();
+        cache.desc_cache.clear();
+        cache.plans.clear();
+        cache.descriptor_generation = descriptor_generation;
+    }
+    return cache;
+}
+
+void dccl::FieldCodecManager::release_thread_cache()
+{
+    if(thread_cache_destroyed)
+        return;
+    
+    ThreadCache& cache = thread_cache();
+    cache.registry.reset();
+    cache.field_cache.clear();
+    cache.desc_cache.clear();
+    cache.plans.clear();
+    // never a current generation, so the registry is taken again when next needed
+    cache.generation = 0;
+}
 
 boost::shared_ptr<dccl::FieldCodecBase>
-dccl::FieldCodecManager::__find(google::protobuf::FieldDescriptor::Type type,
+dccl::FieldCodecManager::__find(const Registry& registry,
+                                google::protobuf::FieldDescriptor::Type type,
                                                  const std::string& codec_name,
                                                  const std::string& type_name /* = "" */)
 {
     typedef InsideMap::const_iterator InsideIterator;
     typedef std::map<google::protobuf::FieldDescriptor::Type, InsideMap>::const_iterator Iterator;
     
-    Iterator it = codecs_.find(type);
-    if(it != codecs_.end())
+    Iterator it = registry.codecs.find(type);
+    if(it != registry.codecs.end())
     {
         InsideIterator inside_it = it->second.end();
         // try specific type codec
@@ -27,8 +27,13 @@
 #include <boost/mpl/and.hpp>
 #include <boost/mpl/not.hpp>
 #include <boost/mpl/logical.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <atomic>
+#include <mutex>
 
 #include "internal/type_helper.h"
+#include "internal/message_plan.h"
 #include "field_codec.h"
 #include "dccl/logger.h"
 
@@ -41,6 +46,8 @@ namespace dccl
     }
 
     /// \brief A class for managing the various field codecs. Here you can add and remove field codecs. The DCCL Codec and DefaultMessageCodec use the find() methods to locate the appropriate field codec.
+    ///
+    /// The codecs are kept in an immutable snapshot that add(), remove() and clear() replace with a modified copy. Each thread looks up codecs in its own reference to the latest snapshot (and its own cache of find() results), so find() does not lock, and adding or removing codecs (e.g. by loading a plugin library) at any time is safe while other threads are encoding or decoding. Calls already in progress keep using the codecs they have found.
     class FieldCodecManager
     {
       public:
@@ -118,17 +125,40 @@ namespace dccl
 
         
         /// \brief Find the codec for a given field. For embedded messages, prefers (dccl.field).codec (inside field) over (dccl.msg).codec (inside embedded message).
+        ///
+        /// The result is cached by FieldDescriptor (and codec group) until the next call to add(), remove(), clear() or invalidate_descriptors().
         static boost::shared_ptr<FieldCodecBase> find(
             const google::protobuf::FieldDescriptor* field,
             bool has_codec_group,
             const std::string& codec_group)
         {
+            ThreadCache& cache = thread_cache();
+            FieldCache::const_iterator cache_it = cache.field_cache.find(field);
+            if(cache_it != cache.field_cache.end())
+            {
+                const std::vector<FieldCacheEntry>& entries = cache_it->second;
+                for(std::vector<FieldCacheEntry>::const_iterator it = entries.begin(), end = entries.end(); it != end; ++it)
+                {
+                    if(it->has_codec_group == has_codec_group && (!has_codec_group || it->codec_group == codec_group))
+                        return it->codec;
+                }
+            }
+            
             std::string name = __find_codec(field, has_codec_group, codec_group);            
+
+            FieldCacheEntry entry;
+            entry.has_codec_group = has_codec_group;
+            if(has_codec_group)
+                entry.codec_group = codec_group;
             
             if(field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
-                return find(field->message_type(), name);
+                entry.codec = __find(*cache.registry, google::protobuf::FieldDescriptor::TYPE_MESSAGE,
+                                     name, field->message_type()->full_name());
             else
-                return __find(field->type(), name);
+                entry.codec = __find(*cache.registry, field->type(), name);
+
+            cache.field_cache[field].push_back(entry);
+            return entry.codec;
         }                
 
         /// \brief Find the codec for a given base (or embedded) message.
@@ -139,17 +169,28 @@ namespace dccl
             const google::protobuf::Descriptor* desc,
             std::string name = "")
         {
+            ThreadCache& cache = thread_cache();
+            
             // this was called on the root message
             if(name.empty())
             {
+                DescriptorCache::const_iterator it = cache.desc_cache.find(desc);
+                if(it != cache.desc_cache.end())
+                    return it->second;
+                
                 // explicitly declared codec takes precedence over group
                 if(desc->options().GetExtension(dccl::msg).has_codec())
                     name = desc->options().GetExtension(dccl::msg).codec();
                 else
                     name = FieldCodecBase::codec_group(desc);
+
+                boost::shared_ptr<FieldCodecBase> codec = __find(*cache.registry, google::protobuf::FieldDescriptor::TYPE_MESSAGE,
+                                                                 name, desc->full_name());
+                cache.desc_cache[desc] = codec;
+                return codec;
             }
             
-            return __find(google::protobuf::FieldDescriptor::TYPE_MESSAGE,
+            return __find(*cache.registry, google::protobuf::FieldDescriptor::TYPE_MESSAGE,
                           name, desc->full_name());
         }
 
@@ -157,15 +198,38 @@ namespace dccl
             google::protobuf::FieldDescriptor::Type type,
             std::string name)
         {
-            return __find(type, name);
+            return __find(*thread_cache().registry, type, name);
         }
 
         static void clear()
         {
             internal::TypeHelper::reset();
-            codecs_.clear();
+            
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            publish(boost::shared_ptr<Registry>(new Registry));
+        }
+
+        /// \brief Incremented every time a codec is added or removed. Used to detect when cached results of find() (such as a compiled internal::MessagePlan) are stale.
+        static unsigned generation()
+        { return generation_.load(std::memory_order_acquire); }
+
+        /// \brief This thread's cache of the message plans compiled by a message codec (see internal::MessagePlan). These are discarded whenever a codec is added or removed, and by invalidate_descriptors().
+        static internal::MessagePlanCache& plans(const FieldCodecBase* message_codec)
+        { return thread_cache().plans[message_codec]; }
+
+        /// \brief Drop the calling thread's reference to the codecs (and its cached results of find() and message plans), so that codecs since removed are destroyed now unless used elsewhere. These are taken again when next needed.
+        ///
+        /// Codecs removed by remove() or clear() stay alive until every thread that used them has refreshed its cache, so this must be called (on each such thread) before closing a shared library that provided codecs. ~Codec() calls this for the calling thread.
+        static void release_thread_cache();
+
+        /// \brief Discard the results of find() and the message plans cached by every thread, and the snapshots of (dccl.field) options (see internal::FieldOptionsSnapshot::invalidate()).
+        ///
+        /// These are all looked up by descriptor address, so this must be called when descriptors may have been destroyed: a new descriptor at the same address would otherwise get the old one's codec, plan and options. Codec::load() and Codec::unload() call this, as does DynamicProtobufManager when it replaces its descriptor pool. Each thread discards its caches the next time it uses them.
+        static void invalidate_descriptors()
+        {
+            descriptor_generation_.fetch_add(1, std::memory_order_release);
+            internal::FieldOptionsSnapshot::invalidate();
         }
-        
         
       private:
         FieldCodecManager() { }
@@ -173,12 +237,29 @@ namespace dccl
         FieldCodecManager(const FieldCodecManager&);
         FieldCodecManager& operator= (const FieldCodecManager&);
 
-                
+        friend class internal::TypeHelper;
+        
+        typedef std::map<std::string, boost::shared_ptr<FieldCodecBase> > InsideMap;
+        // the codecs (and type helpers of the message types of message codecs) at one time; not modified once published
+        struct Registry
+        {
+            std::map<google::protobuf::FieldDescriptor::Type, InsideMap> codecs;
+            internal::TypeHelper::CustomMessageMap custom_messages;
+        };
             
         static boost::shared_ptr<FieldCodecBase> __find(
+            const Registry& registry,
             google::protobuf::FieldDescriptor::Type type,
             const std::string& codec_name,
             const std::string& type_name = "");
+
+        // for internal::TypeHelper
+        static boost::shared_ptr<internal::FromProtoCppTypeBase> __find_custom_message(const std::string& type_name)
+        {
+            const internal::TypeHelper::CustomMessageMap& custom_messages = thread_cache().registry->custom_messages;
+            internal::TypeHelper::CustomMessageMap::const_iterator it = custom_messages.find(type_name);
+            return (it != custom_messages.end()) ? it->second : boost::shared_ptr<internal::FromProtoCppTypeBase>();
+        }
             
         static std::string __mangle_name(const std::string& codec_name,
                                          const std::string& type_name) 
@@ -202,14 +283,21 @@ namespace dccl
                                         google::protobuf::FieldDescriptor::CppType wire_type);
 
         
+        // replaces the current registry with `registry` (a modified copy of it), invalidating the cached results of find(). registry_mutex_ must be held.
+        static void publish(const boost::shared_ptr<const Registry>& registry)
+        {
+            registry_ = registry;
+            generation_.fetch_add(1, std::memory_order_release);
+        }
+        
         static std::string __find_codec(const google::protobuf::FieldDescriptor* field,
                                         bool has_codec_group, const std::string& codec_group)
         {
-            dccl::DCCLFieldOptions dccl_field_options = field->options().GetExtension(dccl::field);
+            const internal::FieldOptionsSnapshot& field_options = internal::FieldOptionsSnapshot::find(field);
                 
             // prefer the codec listed as a field extension
-            if(dccl_field_options.has_codec())
-                return dccl_field_options.codec();                
+            if(field_options.has_codec)
+                return field_options.codec;                
             // then, the codec embedded in the message option extension
             else if(field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE && field->message_type()->options().GetExtension(dccl::msg).has_codec())
                 return field->message_type()->options().GetExtension(dccl::msg).codec();
@@ -218,12 +306,45 @@ namespace dccl
                 return codec_group;
             // finally the default
             else
-                return dccl_field_options.codec();
+                return field_options.codec;
         }
 
       private:
-        typedef std::map<std::string, boost::shared_ptr<FieldCodecBase> > InsideMap;
-        static std::map<google::protobuf::FieldDescriptor::Type, InsideMap> codecs_;
+        // latest registry; only accessed with registry_mutex_ held
+        static boost::shared_ptr<const Registry> registry_;
+        // serializes add(), remove() and clear(), and threads taking a reference to registry_
+        static std::mutex registry_mutex_;
+        static std::atomic<unsigned> generation_;
+        // incremented by invalidate_descriptors()
+        static std::atomic<unsigned> descriptor_generation_;
+
+        struct FieldCacheEntry
+        {
+            bool has_codec_group;
+            std::string codec_group;
+            boost::shared_ptr<FieldCodecBase> codec;
+        };
+        // results of find() for fields, by field and codec group (usually only one group per field)
+        typedef boost::unordered_map<const google::protobuf::FieldDescriptor*, std::vector<FieldCacheEntry> > FieldCache;
+        // results of find() for root messages
+        typedef boost::unordered_map<const google::protobuf::Descriptor*, boost::shared_ptr<FieldCodecBase> > DescriptorCache;
+
+        // one thread's reference to the registry, and results derived from it
+        struct ThreadCache
+        {
+            ThreadCache() : generation(0), descriptor_generation(0) { }
+            // generation_ when registry was taken
+            unsigned generation;
+            // descriptor_generation_ when field_cache, desc_cache and plans were last cleared
+            unsigned descriptor_generation;
+            boost::shared_ptr<const Registry> registry;
+            FieldCache field_cache;
+            DescriptorCache desc_cache;
+            std::map<const FieldCodecBase*, internal::MessagePlanCache> plans;
+        };
+
+        // this thread's cache, first updated to the latest registry if codecs have been added or removed since it was last used (and cleared if descriptors may have been destroyed)
+        static ThreadCache& thread_cache();
     };
 }
 
@@ -236,8 +357,16 @@ boost::mpl::not_<boost::is_same<google::protobuf::Message, typename Codec::wire_
 void>::type 
     dccl::FieldCodecManager::add(const std::string& name, compiler::dummy_fcm<0> dummy_fcm)
 {
-    internal::TypeHelper::add<typename Codec::wire_type>();
-    add_single_type<Codec>(__mangle_name(name, Codec::wire_type::descriptor()->full_name()),
+    typedef typename Codec::wire_type ProtobufMessage;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        boost::shared_ptr<Registry> registry(new Registry(*registry_));
+        registry->custom_messages.insert(std::make_pair(ProtobufMessage::descriptor()->full_name(),
+                                                        boost::shared_ptr<internal::FromProtoCppTypeBase>(new internal::FromProtoCustomMessage<ProtobufMessage>)));
+        publish(registry);
+    }
+    
+    add_single_type<Codec>(__mangle_name(name, ProtobufMessage::descriptor()->full_name()),
                            google::protobuf::FieldDescriptor::TYPE_MESSAGE,
                            google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE);
 }
@@ -284,26 +413,36 @@ void dccl::FieldCodecManager::add_single_type(const std::string& name,
                                               google::protobuf::FieldDescriptor::CppType wire_type)
 {
     using google::protobuf::FieldDescriptor;
-    if(!codecs_[field_type].count(name))
+    boost::shared_ptr<FieldCodecBase> new_field_codec(new Codec());
+    new_field_codec->set_name(name);
+    new_field_codec->set_field_type(field_type);
+    new_field_codec->set_wire_type(wire_type);
+
+    boost::shared_ptr<FieldCodecBase> existing_field_codec;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        std::map<FieldDescriptor::Type, InsideMap>::const_iterator it = registry_->codecs.find(field_type);
+        if(it != registry_->codecs.end() && it->second.count(name))
+        {
+            existing_field_codec = it->second.find(name)->second;
+        }
+        else
+        {
+            boost::shared_ptr<Registry> registry(new Registry(*registry_));
+            registry->codecs[field_type][name] = new_field_codec;
+            publish(registry);
+        }
+    }
+    
+    if(!existing_field_codec)
     {
-        boost::shared_ptr<FieldCodecBase> new_field_codec(new Codec());
-        new_field_codec->set_name(name);
-        new_field_codec->set_field_type(field_type);
-        new_field_codec->set_wire_type(wire_type);
-        
-        codecs_[field_type][name] = new_field_codec;
         dccl::dlog.is(dccl::logger::DEBUG1) && dccl::dlog << "Adding codec " << *new_field_codec << std::endl;
     }            
     else
     {
-        boost::shared_ptr<FieldCodecBase> new_field_codec(new Codec());
-        new_field_codec->set_name(name);
-        new_field_codec->set_field_type(field_type);
-        new_field_codec->set_wire_type(wire_type);
-        
         dccl::dlog.is(dccl::logger::DEBUG1) && dccl::dlog << "Trying to add: " << *new_field_codec
                                                             << ", but already have duplicate codec (For `name`/`field type` pair) "
-                                                            << *(codecs_[field_type].find(name)->second)
+                                                            << *existing_field_codec
                                                             << std::endl;
     }
 }
@@ -319,8 +458,15 @@ boost::mpl::not_<boost::is_same<google::protobuf::Message, typename Codec::wire_
 void>::type 
     dccl::FieldCodecManager::remove(const std::string& name, compiler::dummy_fcm<0> dummy_fcm)
 {
-    internal::TypeHelper::remove<typename Codec::wire_type>();
-    remove_single_type<Codec>(__mangle_name(name, Codec::wire_type::descriptor()->full_name()),
+    typedef typename Codec::wire_type ProtobufMessage;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        boost::shared_ptr<Registry> registry(new Registry(*registry_));
+        registry->custom_messages.erase(ProtobufMessage::descriptor()->full_name());
+        publish(registry);
+    }
+
+    remove_single_type<Codec>(__mangle_name(name, ProtobufMessage::descriptor()->full_name()),
                               google::protobuf::FieldDescriptor::TYPE_MESSAGE,
                               google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE);
 }
@@ -367,10 +513,22 @@ void dccl::FieldCodecManager::remove_single_type(const std::string& name,
                                               google::protobuf::FieldDescriptor::CppType wire_type)
 {
     using google::protobuf::FieldDescriptor;
-    if(codecs_[field_type].count(name))
+    boost::shared_ptr<FieldCodecBase> removed_field_codec;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        std::map<FieldDescriptor::Type, InsideMap>::const_iterator it = registry_->codecs.find(field_type);
+        if(it != registry_->codecs.end() && it->second.count(name))
+        {
+            removed_field_codec = it->second.find(name)->second;
+            boost::shared_ptr<Registry> registry(new Registry(*registry_));
+            registry->codecs[field_type].erase(name);
+            publish(registry);
+        }
+    }
+    
+    if(removed_field_codec)
     {       
-        dccl::dlog.is(dccl::logger::DEBUG1) && dccl::dlog << "Removing codec " << *codecs_[field_type][name]  << std::endl;
-        codecs_[field_type].erase(name);
+        dccl::dlog.is(dccl::logger::DEBUG1) && dccl::dlog << "Removing codec " << *removed_field_codec  << std::endl;
     }            
     else
     {
@@ -215,7 +215,207 @@ typedef WireType wire_type;
           catch(NullValueException&)
           { *wire_value = boost::any(); }              
       }
-    
+
+      // typed path: values go directly between the containing message (via Reflection) and WireType
+      bool has_reflected_path(const google::protobuf::FieldDescriptor* field)
+      { return internal::ReflectionAccess<FieldType>::matches(field); }
+          
+      void reflected_encode(BitWriter* writer, const google::protobuf::Message& msg,
+                            const google::protobuf::FieldDescriptor* field)
+      { reflected_encode_specific<FieldType>(writer, msg, field); }
+
+      void reflected_encode_repeated(BitWriter* writer, const google::protobuf::Message& msg,
+                                     const google::protobuf::FieldDescriptor* field)
+      { reflected_encode_repeated_specific<FieldType>(writer, msg, field); }
+
+      unsigned reflected_size(const google::protobuf::Message& msg,
+                              const google::protobuf::FieldDescriptor* field)
+      { return reflected_size_specific<FieldType>(msg, field); }
+
+      unsigned reflected_size_repeated(const google::protobuf::Message& msg,
+                                       const google::protobuf::FieldDescriptor* field)
+      { return reflected_size_repeated_specific<FieldType>(msg, field); }
+
+      void reflected_decode(Bitset* bits, google::protobuf::Message* msg,
+                            const google::protobuf::FieldDescriptor* field)
+      { reflected_decode_specific<FieldType>(bits, msg, field); }
+
+      void reflected_decode_repeated(Bitset* repeated_bits, google::protobuf::Message* msg,
+                                     const google::protobuf::FieldDescriptor* field)
+      { reflected_decode_repeated_specific<FieldType>(repeated_bits, msg, field); }
+
+      // has_reflected_path() is false for types without ReflectionAccess, so these are never called
+      template<typename T>
+      typename boost::disable_if_c<internal::ReflectionAccess<T>::supported, void>::type
+      reflected_encode_specific(BitWriter* writer, const google::protobuf::Message& msg,
+                                const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      { FieldCodecBase::reflected_encode(writer, msg, field); }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::ReflectionAccess<T>::supported, void>::type
+      reflected_encode_repeated_specific(BitWriter* writer, const google::protobuf::Message& msg,
+                                         const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      { FieldCodecBase::reflected_encode_repeated(writer, msg, field); }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::ReflectionAccess<T>::supported, unsigned>::type
+      reflected_size_specific(const google::protobuf::Message& msg,
+                              const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      { return FieldCodecBase::reflected_size(msg, field); }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::ReflectionAccess<T>::supported, unsigned>::type
+      reflected_size_repeated_specific(const google::protobuf::Message& msg,
+                                       const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      { return FieldCodecBase::reflected_size_repeated(msg, field); }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::ReflectionAccess<T>::supported, void>::type
+      reflected_decode_specific(Bitset* bits, google::protobuf::Message* msg,
+                                const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      { FieldCodecBase::reflected_decode(bits, msg, field); }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::ReflectionAccess<T>::supported, void>::type
+      reflected_decode_repeated_specific(Bitset* repeated_bits, google::protobuf::Message* msg,
+                                         const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      { FieldCodecBase::reflected_decode_repeated(repeated_bits, msg, field); }
+
+      
+      template<typename T>
+      typename boost::enable_if_c<internal::ReflectionAccess<T>::supported, void>::type
+      reflected_encode_specific(BitWriter* writer, const google::protobuf::Message& msg,
+                                const google::protobuf::FieldDescriptor* field, compiler::dummy<1> dummy = 0)
+      {
+          if(msg.GetReflection()->HasField(msg, field))
+          {
+              T scratch;
+              writer->write(encode_field_value(internal::ReflectionAccess<T>::get(msg, field, &scratch)));
+          }
+          else
+          {
+              writer->write(encode());
+          }
+      }
+
+      // same layout as FieldCodecBase::any_encode_repeated()
+      template<typename T>
+      typename boost::enable_if_c<internal::ReflectionAccess<T>::supported, void>::type
+      reflected_encode_repeated_specific(BitWriter* writer, const google::protobuf::Message& msg,
+                                         const google::protobuf::FieldDescriptor* field, compiler::dummy<1> dummy = 0)
+      {
+          unsigned field_size = msg.GetReflection()->FieldSize(msg, field);
+          unsigned wire_vector_size = this->field_options().max_repeat;
+          if(FieldCodecBase::codec_version() > 2)
+          {
+              wire_vector_size = std::min(wire_vector_size, field_size);
+              writer->write(field_size, this->repeated_vector_field_size(this->field_options().max_repeat));
+          }
+
+          T scratch;
+          for(unsigned i = 0; i < wire_vector_size; ++i)
+          {
+              if(i < field_size)
+                  writer->write(encode_field_value(internal::ReflectionAccess<T>::get_repeated(msg, field, i, &scratch)));
+              else
+                  writer->write(encode());
+          }
+      }
+
+      template<typename T>
+      typename boost::enable_if_c<internal::ReflectionAccess<T>::supported, unsigned>::type
+      reflected_size_specific(const google::protobuf::Message& msg,
+                              const google::protobuf::FieldDescriptor* field, compiler::dummy<1> dummy = 0)
+      {
+          if(msg.GetReflection()->HasField(msg, field))
+          {
+              T scratch;
+              return size_field_value(internal::ReflectionAccess<T>::get(msg, field, &scratch));
+          }
+          else
+          {
+              return size();
+          }
+      }
+
+      // same layout as FieldCodecBase::any_size_repeated()
+      template<typename T>
+      typename boost::enable_if_c<internal::ReflectionAccess<T>::supported, unsigned>::type
+      reflected_size_repeated_specific(const google::protobuf::Message& msg,
+                                       const google::protobuf::FieldDescriptor* field, compiler::dummy<1> dummy = 0)
+      {
+          unsigned out = 0;
+          unsigned field_size = msg.GetReflection()->FieldSize(msg, field);
+          unsigned wire_vector_size = this->field_options().max_repeat;
+          if(FieldCodecBase::codec_version() > 2)
+          {
+              wire_vector_size = std::min(wire_vector_size, field_size);
+              out += this->repeated_vector_field_size(this->field_options().max_repeat);
+          }
+
+          T scratch;
+          for(unsigned i = 0; i < wire_vector_size; ++i)
+          {
+              if(i < field_size)
+                  out += size_field_value(internal::ReflectionAccess<T>::get_repeated(msg, field, i, &scratch));
+              else
+                  out += size();
+          }
+          return out;
+      }
+      
+      template<typename T>
+      typename boost::enable_if_c<internal::ReflectionAccess<T>::supported, void>::type
+      reflected_decode_specific(Bitset* bits, google::protobuf::Message* msg,
+                                const google::protobuf::FieldDescriptor* field, compiler::dummy<1> dummy = 0)
+      {
+          // an empty value (NullValueException) leaves the field unset
+          try
+          { internal::ReflectionAccess<T>::set(msg, field, this->post_decode(decode(bits))); }
+          catch(NullValueException&)
+          { }
+      }
+
+      // same layout as FieldCodecBase::any_decode_repeated()
+      template<typename T>
+      typename boost::enable_if_c<internal::ReflectionAccess<T>::supported, void>::type
+      reflected_decode_repeated_specific(Bitset* repeated_bits, google::protobuf::Message* msg,
+                                         const google::protobuf::FieldDescriptor* field, compiler::dummy<1> dummy = 0)
+      {
+          unsigned wire_vector_size = this->field_options().max_repeat;
+          if(FieldCodecBase::codec_version() > 2)
+          {
+              Bitset size_bits(repeated_bits);
+              size_bits.get_more_bits(this->repeated_vector_field_size(this->field_options().max_repeat));
+              wire_vector_size = size_bits.to_ulong();
+          }
+
+          for(unsigned i = 0; i < wire_vector_size; ++i)
+          {
+              Bitset these_bits(repeated_bits);
+              these_bits.get_more_bits(this->decode_prefetch_size());
+              try
+              { internal::ReflectionAccess<T>::add(msg, field, this->post_decode(decode(&these_bits))); }
+              catch(NullValueException&)
+              { }
+          }
+      }
+
+      Bitset encode_field_value(const FieldType& field_value)
+      {
+          try
+          { return encode(this->pre_encode(field_value)); }
+          catch(NullValueException&)
+          { return encode(); }
+      }
+
+      unsigned size_field_value(const FieldType& field_value)
+      {
+          try
+          { return size(this->pre_encode(field_value)); }
+          catch(NullValueException&)
+          { return size(); }
+      }
     };
 
 
@@ -296,6 +496,10 @@ typedef WireType wire_type;
 
           
       private:
+      // repeated fields go through encode_repeated() / decode_repeated() using the boost::any path
+      bool has_reflected_path(const google::protobuf::FieldDescriptor* field)
+      { return !field->is_repeated() && internal::ReflectionAccess<FieldType>::matches(field); }
+
       void any_encode_repeated(Bitset* bits, const std::vector<boost::any>& wire_values)
       {
           try
@@ -317,6 +521,13 @@ typedef WireType wire_type;
           any_decode_repeated_specific<WireType>(repeated_bits, field_values);
       }
 
+      // the repeated layout is up to the subclass, so decode and discard the values
+      void skip_repeated(Bitset* repeated_bits)
+      {
+          std::vector<boost::any> wire_values;
+          any_decode_repeated(repeated_bits, &wire_values);
+      }
+
       template<typename T>
       typename boost::enable_if<boost::is_base_of<google::protobuf::Message, T>, void>::type
       any_decode_repeated_specific(Bitset* repeated_bits, std::vector<boost::any>* wire_values, compiler::dummy<0> dummy = 0)
@@ -0,0 +1,97 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLFIELDMASK20261016H
+#define DCCLFIELDMASK20261016H
+
+#include <map>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+namespace dccl
+{
+    /// \brief The fields of a message to decode when only some of them are needed (see Codec::decode()).
+    ///
+    /// Fields are given by name, or for fields of embedded messages, by the path of field names separated by '.' (e.g. "position.lat"), as in google.protobuf.FieldMask. Giving an embedded message field by itself selects all of its fields. Names that do not match a field are ignored.
+    class FieldMask
+    {
+      public:
+        FieldMask() : all_(false) { }
+
+        /// \brief Add a field to the mask
+        ///
+        /// \param path Field name or path (e.g. "depth" or "position.lat")
+        /// \return this mask, so calls may be chained (e.g. FieldMask().add_path("depth").add_path("position.lat"))
+        FieldMask& add_path(const std::string& path)
+        {
+            FieldMask* mask = this;
+            std::string::size_type begin = 0;
+            while(!mask->all_)
+            {
+                std::string::size_type end = path.find('.', begin);
+                boost::shared_ptr<FieldMask>& child = mask->fields_[path.substr(begin, end - begin)];
+
+                // copies of a mask share children until they are modified
+                if(!child)
+                    child.reset(new FieldMask);
+                else if(!child.unique())
+                    child.reset(new FieldMask(*child));
+                mask = child.get();
+
+                if(end == std::string::npos)
+                {
+                    mask->all_ = true;
+                    mask->fields_.clear();
+                }
+                else
+                {
+                    begin = end + 1;
+                }
+            }
+            return *this;
+        }
+
+        /// \brief Whether every field is selected
+        bool all() const { return all_; }
+
+        /// \brief Whether no fields are selected
+        bool empty() const { return !all_ && fields_.empty(); }
+
+        /// \brief The selected fields of the field `name`
+        ///
+        /// \return 0 if the field is not selected, otherwise its mask (with all() true if the entire field is selected)
+        const FieldMask* find(const std::string& name) const
+        {
+            if(all_)
+                return this;
+            
+            std::map<std::string, boost::shared_ptr<FieldMask> >::const_iterator it = fields_.find(name);
+            return (it == fields_.end()) ? 0 : it->second.get();
+        }
+        
+      private:
+        bool all_;
+        std::map<std::string, boost::shared_ptr<FieldMask> > fields_;
+    };
+}
+
+#endif
@@ -0,0 +1,90 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLGENERATEDCODEC20261016H
+#define DCCLGENERATEDCODEC20261016H
+
+#include <google/protobuf/message.h>
+
+#include "dccl/bitset.h"
+#include "dccl/bitwriter.h"
+#include "dccl/internal/field_codec_message_stack.h"
+
+namespace dccl
+{
+    /// \brief Base class for an encoder/decoder written ahead of time for a single DCCL message type, such as those generated by protoc-gen-dccl.
+    ///
+    /// Implementations are registered using Codec::add_generated_codec(). Once the message is loaded, Codec uses the generated codec in place of the default message codec for that type, as long as its fields all use the default DCCL3 field codecs and the generated sizes agree with those calculated from the Descriptor.
+    class GeneratedMessageCodec
+    {
+      public:
+        virtual ~GeneratedMessageCodec() { }
+
+        /// \brief Encode a part (head or body) of a message
+        ///
+        /// \param writer BitWriter to write the encoded bits to
+        /// \param msg Message to encode
+        /// \param part Part of the message to encode
+        /// \return false (and nothing is written) if `msg` is not of the generated C++ type (e.g. a google::protobuf::DynamicMessage), in which case the default codecs are used.
+        virtual bool encode(BitWriter* writer, const google::protobuf::Message& msg, MessagePart part) = 0;
+
+        /// \brief Calculate the encoded size (in bits) of a part of a message
+        ///
+        /// \return false if `msg` is not of the generated C++ type
+        virtual bool size(unsigned* bit_size, const google::protobuf::Message& msg, MessagePart part) = 0;
+
+        /// \brief Decode a part of a message
+        ///
+        /// \param bits Bitset to read the encoded bits from (using get_more_bits())
+        /// \param msg Message to merge the decoded fields into
+        /// \param part Part of the message to decode
+        /// \return false (and no bits are consumed) if `msg` is not of the generated C++ type
+        virtual bool decode(Bitset* bits, google::protobuf::Message* msg, MessagePart part) = 0;
+
+        /// \brief Maximum size (in bits) of a part of the message
+        virtual unsigned max_size(MessagePart part) = 0;
+        
+        /// \brief Minimum size (in bits) of a part of the message
+        virtual unsigned min_size(MessagePart part) = 0;
+
+      protected:
+        /// \brief Read the next `num_bits` bits from `bits` (as a field codec would using get_more_bits())
+        static dccl::uint64 read_bits(Bitset* bits, unsigned num_bits)
+        {
+            if(!num_bits)
+                return 0;
+            
+            Bitset these_bits(bits);
+            these_bits.get_more_bits(num_bits);
+            return these_bits.read_bits(0, num_bits);
+        }
+
+        /// \brief Whether any field of `msg` is set (an embedded message with no fields set after decoding is cleared, as the default message codec does)
+        static bool has_any_field(const google::protobuf::Message& msg)
+        {
+            std::vector<const google::protobuf::FieldDescriptor*> set_fields;
+            msg.GetReflection()->ListFields(msg, &set_fields);
+            return !set_fields.empty();
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,79 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLCONTIGUOUSBYTES20261016H
+#define DCCLCONTIGUOUSBYTES20261016H
+
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace dccl
+{
+    namespace internal
+    {
+        /// \brief Whether CharIterator points into contiguous storage of `char` (so the bytes can be read in place)
+        template<typename CharIterator>
+            struct IsContiguousCharIterator : std::false_type { };
+        template<> struct IsContiguousCharIterator<char*> : std::true_type { };
+        template<> struct IsContiguousCharIterator<const char*> : std::true_type { };
+        template<> struct IsContiguousCharIterator<std::string::iterator> : std::true_type { };
+        template<> struct IsContiguousCharIterator<std::string::const_iterator> : std::true_type { };
+        template<> struct IsContiguousCharIterator<std::vector<char>::iterator> : std::true_type { };
+        template<> struct IsContiguousCharIterator<std::vector<char>::const_iterator> : std::true_type { };
+
+        /// \brief The bytes [begin, end) as one array: the original bytes for contiguous storage, otherwise a copy of them (e.g. for std::deque<char> or std::list<char> iterators)
+        template<typename CharIterator, bool contiguous = IsContiguousCharIterator<CharIterator>::value>
+            class ContiguousBytes
+        {
+          public:
+            ContiguousBytes(CharIterator begin, CharIterator end)
+                : data_((begin == end) ? 0 : &*begin),
+                size_(std::distance(begin, end))
+                { }
+
+            const char* data() const { return data_; }
+            std::size_t size() const { return size_; }
+            
+          private:
+            const char* data_;
+            std::size_t size_;
+        };
+
+        template<typename CharIterator>
+            class ContiguousBytes<CharIterator, false>
+        {
+          public:
+            ContiguousBytes(CharIterator begin, CharIterator end)
+                : copy_(begin, end)
+                { }
+
+            const char* data() const { return copy_.data(); }
+            std::size_t size() const { return copy_.size(); }
+            
+          private:
+            std::string copy_;
+        };
+    }
+}
+
+#endif
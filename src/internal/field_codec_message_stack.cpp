@@ -22,9 +22,18 @@
 #include "field_codec_message_stack.h"
 #include "dccl/field_codec.h"
 
-std::vector<const google::protobuf::FieldDescriptor*> dccl::internal::MessageStack::field_;
-std::vector<const google::protobuf::Descriptor*> dccl::internal::MessageStack::desc_;
-std::vector<dccl::MessagePart> dccl::internal::MessageStack::parts_;
+thread_local dccl::internal::CodecContext* dccl::internal::CodecContext::current_ = 0;
+
+//
+// CodecContext
+//
+
+dccl::internal::CodecContext& dccl::internal::CodecContext::thread_default()
+{
+    // used by all calls on this thread except nested ones (see Scope)
+    static thread_local CodecContext context;
+    return context;
+}
 
 //
 // MessageStack
@@ -33,44 +42,49 @@ std::vector<dccl::MessagePart> dccl::internal::MessageStack::parts_;
 void dccl::internal::MessageStack::push(const google::protobuf::Descriptor* desc)
  
 {
-    desc_.push_back(desc);
+    context_.desc.push_back(desc);
     ++descriptors_pushed_;
 }
 
 void dccl::internal::MessageStack::push(const google::protobuf::FieldDescriptor* field)
 {
-    field_.push_back(field);
+    context_.field.push_back(field);
+    context_.field_options.push_back(&FieldOptionsSnapshot::find(field));
     ++fields_pushed_;
 }
 
 void dccl::internal::MessageStack::push(MessagePart part)
 {
-    parts_.push_back(part);
+    context_.parts.push_back(part);
     ++parts_pushed_;
 }
 
 
 void dccl::internal::MessageStack::__pop_desc()
 {
-    if(!desc_.empty())
-        desc_.pop_back();
+    if(!context_.desc.empty())
+        context_.desc.pop_back();
 }
 
 void dccl::internal::MessageStack::__pop_field()
 {
-    if(!field_.empty())
-        field_.pop_back();
+    if(!context_.field.empty())
+    {
+        context_.field.pop_back();
+        context_.field_options.pop_back();
+    }
 }
 
 void dccl::internal::MessageStack::__pop_parts()
 {
-    if(!parts_.empty())
-        parts_.pop_back();
+    if(!context_.parts.empty())
+        context_.parts.pop_back();
 }
 
 
 dccl::internal::MessageStack::MessageStack(const google::protobuf::FieldDescriptor* field)
-    : descriptors_pushed_(0),
+    : context_(CodecContext::current()),
+      descriptors_pushed_(0),
       fields_pushed_(0),
       parts_pushed_(0)
 {
@@ -79,10 +93,11 @@ dccl::internal::MessageStack::MessageStack(const google::protobuf::FieldDescript
         if(field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
         {
             MessagePart part = UNKNOWN;
-            if(field->options().GetExtension(dccl::field).has_in_head())
+            const FieldOptionsSnapshot& options = FieldOptionsSnapshot::find(field);
+            if(options.has_in_head)
             {
                 // if explicitly set, set part (HEAD or BODY) of message for all children of this message
-                part = field->options().GetExtension(dccl::field).in_head() ? HEAD : BODY;
+                part = options.in_head ? HEAD : BODY;
             }
             else
             {
@@ -22,16 +22,87 @@
 #ifndef DCCLFIELDCODECHELPERS20110825H
 #define DCCLFIELDCODECHELPERS20110825H
 
+#include <boost/scoped_ptr.hpp>
+
 #include "dccl/common.h"
+#include "field_options.h"
 
 namespace dccl
 {
     class FieldCodecBase;
+    class FieldMask;
     enum MessagePart { HEAD, BODY, UNKNOWN };
 
     /// Namespace for objects used internally by DCCL
     namespace internal
     {
+        /// \brief State of one encode, decode, size (etc.) call: the message recursion stack (see MessageStack) and the root message being processed. FieldCodecBase exposes this through this_field(), this_descriptor(), part(), root_message(), etc.
+        ///
+        /// Each thread has its own context, and Codec gives a call made while another is in progress on the same thread (see Scope) a new one, so concurrent or nested calls do not share this state.
+        struct CodecContext
+        {
+            CodecContext()
+            : part(UNKNOWN),
+                root_message(0),
+                root_descriptor(0),
+                decode_mask(0)
+                { }
+
+            std::vector<const google::protobuf::Descriptor*> desc;
+            std::vector<const google::protobuf::FieldDescriptor*> field;
+            // (dccl.field) options of each entry in field
+            std::vector<const FieldOptionsSnapshot*> field_options;
+            std::vector<MessagePart> parts;
+
+            MessagePart part;
+            const google::protobuf::Message* root_message;
+            const google::protobuf::Descriptor* root_descriptor;
+            const FieldMask* decode_mask;
+
+            /// \brief The context current for this thread (or this thread's default context if none has been made current)
+            static CodecContext& current()
+            { return current_ ? *current_ : thread_default(); }
+
+            /// \brief Whether no call is using this context
+            bool idle() const
+            { return desc.empty() && field.empty() && parts.empty() && !root_descriptor; }
+
+            /// \brief Whether no call is in progress on this thread (nested calls only get a context of their own while the thread's default context is in use)
+            static bool thread_idle()
+            { return thread_default().idle(); }
+
+            /// \brief Gives a (top-level or nested) encode, decode, etc. call a context of its own until destroyed. This is the thread's default context, unless a call in progress is already using it (e.g. a field codec that itself calls a Codec), in which case a new context is made.
+            class Scope
+            {
+              public:
+                Scope()
+                    : previous_(current_)
+                {
+                    CodecContext& context = current();
+                    if(context.idle())
+                    {
+                        current_ = &context;
+                    }
+                    else
+                    {
+                        nested_.reset(new CodecContext);
+                        current_ = nested_.get();
+                    }
+                }
+                ~Scope()
+                { current_ = previous_; }
+              private:
+                Scope(const Scope&);
+                Scope& operator=(const Scope&);
+                CodecContext* previous_;
+                boost::scoped_ptr<CodecContext> nested_;
+            };
+            
+          private:
+            static CodecContext& thread_default();
+            static thread_local CodecContext* current_;
+        };
+        
         //RAII handler for the current Message recursion stack
         class MessageStack
         {
@@ -41,25 +112,27 @@ namespace dccl
             ~MessageStack();
             
             bool first() 
-            { return desc_.empty(); }
+            { return context_.desc.empty(); }
             int count() 
-            { return desc_.size(); }
+            { return context_.desc.size(); }
 
             void push(const google::protobuf::Descriptor* desc);
             void push(const google::protobuf::FieldDescriptor* field);
             void push(MessagePart part);
 
-            static MessagePart current_part() { return parts_.empty() ? UNKNOWN : parts_.back(); }
+            static MessagePart current_part()
+            {
+                const std::vector<MessagePart>& parts = CodecContext::current().parts;
+                return parts.empty() ? UNKNOWN : parts.back();
+            }
         
-            friend class ::dccl::FieldCodecBase;
           private:
             void __pop_desc();
             void __pop_field();
             void __pop_parts();
-                
-            static std::vector<const google::protobuf::Descriptor*> desc_;
-            static std::vector<const google::protobuf::FieldDescriptor*> field_;
-            static std::vector<MessagePart> parts_;
+
+            // context this stack was created in (and will be unwound from)
+            CodecContext& context_;
             int descriptors_pushed_;
             int fields_pushed_;
             int parts_pushed_;
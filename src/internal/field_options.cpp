@@ -0,0 +1,85 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <atomic>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "field_options.h"
+#include "field_codec_message_stack.h"
+
+namespace
+{
+    // a snapshot, and the generation it was made in
+    struct CachedSnapshot
+    {
+        CachedSnapshot(unsigned generation, const google::protobuf::FieldDescriptor* field)
+        : generation(generation),
+            snapshot(new dccl::internal::FieldOptionsSnapshot(field->options().GetExtension(dccl::field)))
+            { }
+        unsigned generation;
+        boost::shared_ptr<const dccl::internal::FieldOptionsSnapshot> snapshot;
+    };
+    
+    // one map per thread, so concurrent encodes and decodes do not race to fill it
+    typedef boost::unordered_map<const google::protobuf::FieldDescriptor*, CachedSnapshot> SnapshotMap;
+    thread_local SnapshotMap snapshots;
+    // generation when snapshots was last cleared
+    thread_local unsigned snapshots_generation = 0;
+    // out of date snapshots replaced while a call was in progress (which may still hold references to them)
+    thread_local std::vector<boost::shared_ptr<const dccl::internal::FieldOptionsSnapshot> > retired;
+
+    // incremented by invalidate()
+    std::atomic<unsigned> generation(0);
+}
+
+const dccl::internal::FieldOptionsSnapshot& dccl::internal::FieldOptionsSnapshot::find(const google::protobuf::FieldDescriptor* field)
+{
+    unsigned current = generation.load(std::memory_order_acquire);
+    // between calls, nothing can hold a reference to a snapshot, so the stale ones (including those of destroyed descriptors) are erased
+    if((snapshots_generation != current || !retired.empty()) && CodecContext::thread_idle())
+    {
+        if(snapshots_generation != current)
+            snapshots.clear();
+        retired.clear();
+        snapshots_generation = current;
+    }
+    
+    SnapshotMap::iterator it = snapshots.find(field);
+    if(it == snapshots.end())
+    {
+        it = snapshots.insert(std::make_pair(field, CachedSnapshot(current, field))).first;
+    }
+    else if(it->second.generation != current)
+    {
+        // `field` may be a new descriptor at the address of a destroyed one, but the call in progress may be using the old snapshot
+        retired.push_back(it->second.snapshot);
+        it->second = CachedSnapshot(current, field);
+    }
+    return *it->second.snapshot;
+}
+
+void dccl::internal::FieldOptionsSnapshot::invalidate()
+{
+    generation.fetch_add(1, std::memory_order_release);
+}
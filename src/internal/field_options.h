@@ -0,0 +1,92 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLFIELDOPTIONS20261016H
+#define DCCLFIELDOPTIONS20261016H
+
+#include <string>
+
+#include <google/protobuf/descriptor.h>
+
+#include "dccl/common.h"
+#include "dccl/protobuf/option_extensions.pb.h"
+
+namespace dccl
+{
+    namespace internal
+    {
+        /// \brief Read-only copy of the commonly used (dccl.field) options of a field.
+        ///
+        /// A snapshot is made once per FieldDescriptor (see find()), so that codecs can read their options (typically many times per encode or decode) through FieldCodecBase::field_options() without copying or looking up the DCCLFieldOptions extension message.
+        struct FieldOptionsSnapshot
+        {
+            explicit FieldOptionsSnapshot(const DCCLFieldOptions& options)
+            : codec(options.codec()),
+                has_codec(options.has_codec()),
+                omit(options.omit()),
+                in_head(options.in_head()),
+                has_in_head(options.has_in_head()),
+                precision(options.precision()),
+                has_precision(options.has_precision()),
+                min(options.min()),
+                has_min(options.has_min()),
+                max(options.max()),
+                has_max(options.has_max()),
+                num_days(options.num_days()),
+                max_length(options.max_length()),
+                has_max_length(options.has_max_length()),
+                max_repeat(options.max_repeat()),
+                has_max_repeat(options.has_max_repeat()),
+                extension(&options)
+                { }
+            
+            std::string codec;
+            bool has_codec;
+            bool omit;
+            bool in_head;
+            bool has_in_head;
+            int32 precision;
+            bool has_precision;
+            double min;
+            bool has_min;
+            double max;
+            bool has_max;
+            uint32 num_days;
+            uint32 max_length;
+            bool has_max_length;
+            uint32 max_repeat;
+            bool has_max_repeat;
+
+            /// \brief The complete (dccl.field) extension, for the less commonly used options (static_value, units, etc.) and extensions (ccl, arithmetic, etc.)
+            const DCCLFieldOptions* extension;
+
+            /// \brief The snapshot of the (dccl.field) options of `field`, made the first time the calling thread requests it (each thread keeps its own snapshots). The reference remains valid until the calling thread has no encode, decode, etc. call in progress and invalidate() has been called.
+            static const FieldOptionsSnapshot& find(const google::protobuf::FieldDescriptor* field);
+
+            /// \brief Discard the snapshots of all threads, so each is made again when next requested. Each thread discards its snapshots at its next find() made with no call in progress.
+            ///
+            /// Snapshots are looked up by FieldDescriptor address, so this must be called when descriptors may have been destroyed: a new descriptor at the same address would otherwise get the old one's options. FieldCodecManager::invalidate_descriptors() calls this.
+            static void invalidate();
+        };
+    }
+}
+
+#endif
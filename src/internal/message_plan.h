@@ -0,0 +1,125 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLMESSAGEPLAN20261016H
+#define DCCLMESSAGEPLAN20261016H
+
+#include <map>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "type_helper.h"
+#include "field_codec_message_stack.h"
+
+namespace dccl
+{
+    class FieldCodecBase;
+
+    namespace internal
+    {
+        /// \brief One field of a MessagePlan, with its codec (and everything else needed to encode, decode or size it) resolved ahead of time.
+        struct MessagePlanStep
+        {
+            MessagePlanStep()
+            : field(0),
+                max_repeat(1),
+                fixed_size(false),
+                size(0)
+                { }
+            
+            const google::protobuf::FieldDescriptor* field;
+            boost::shared_ptr<FieldCodecBase> codec;
+            boost::shared_ptr<FromProtoCppTypeBase> helper;
+            /// (dccl.field).max_repeat for repeated fields, 1 otherwise
+            unsigned max_repeat;
+            /// true if this field always encodes to `size` bits (max_size == min_size)
+            bool fixed_size;
+            /// encoded size in bits (if fixed_size)
+            unsigned size;
+        };
+
+        /// \brief The fields (in encoding order) of one part (HEAD or BODY) of a message, compiled by the DefaultMessageCodec when the message is loaded, so that each encode, decode and size is a walk of this vector rather than a re-discovery of the schema from the Descriptor and (dccl.field) options.
+        struct MessagePlan
+        {
+            MessagePlan()
+            : part(UNKNOWN),
+                generation(0)
+                { }
+
+            std::vector<MessagePlanStep> steps;
+            /// Part of the message this plan covers
+            MessagePart part;
+            /// FieldCodecManager::generation() when this plan was compiled; the plan is stale if codecs have been added or removed since
+            unsigned generation;
+        };
+
+        /// \brief A field that is always encoded at the same bit offset (from the start of its part of the message), as found by FieldCodecBase::base_fixed_layout().
+        struct FixedLayoutField
+        {
+            FixedLayoutField()
+            : field(0),
+                part(UNKNOWN),
+                offset(0),
+                size(0)
+                { }
+
+            const google::protobuf::FieldDescriptor* field;
+            boost::shared_ptr<FieldCodecBase> codec;
+            MessagePart part;
+            /// bits preceding this field in its part of the message (not including the id)
+            unsigned offset;
+            /// encoded size in bits
+            unsigned size;
+        };
+        
+        /// \brief Everything that determines the contents of a MessagePlan: the (embedded) message, the part of the root message being processed, the part set by the parent fields (or UNKNOWN), and the root message (which determines the codec group).
+        struct MessagePlanKey
+        {
+            MessagePlanKey(const google::protobuf::Descriptor* desc,
+                           MessagePart part,
+                           MessagePart parent_part,
+                           const google::protobuf::Descriptor* root)
+            : desc(desc),
+                part(part),
+                parent_part(parent_part),
+                root(root)
+                { }
+            
+            const google::protobuf::Descriptor* desc;
+            MessagePart part;
+            MessagePart parent_part;
+            const google::protobuf::Descriptor* root;
+        };
+
+        inline bool operator<(const MessagePlanKey& a, const MessagePlanKey& b)
+        {
+            if(a.desc != b.desc) return a.desc < b.desc;
+            if(a.part != b.part) return a.part < b.part;
+            if(a.parent_part != b.parent_part) return a.parent_part < b.parent_part;
+            return a.root < b.root;
+        }
+
+        typedef std::map<MessagePlanKey, boost::shared_ptr<const MessagePlan> > MessagePlanCache;
+    }
+}
+
+#endif
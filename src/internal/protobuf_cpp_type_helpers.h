@@ -582,6 +582,76 @@ namespace dccl
             static google::protobuf::FieldDescriptor::CppType as_enum()
             { return google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE; }
         };
+
+        /// \brief Typed (no boost::any) access to a field using google::protobuf::Reflection. Specialized for each non-message FieldType; `supported` is false for all other types.
+        template<typename T>
+            struct ReflectionAccess
+        {
+            enum { supported = false };
+            static bool matches(const google::protobuf::FieldDescriptor* field)
+            { return false; }
+        };
+
+        // get() returns a reference to either the field's own storage or to `scratch`
+#define DCCL_REFLECTION_ACCESS(T, NAME)                                 \
+        template<>                                                      \
+            struct ReflectionAccess<T >                                 \
+        {                                                               \
+            enum { supported = true };                                  \
+            static bool matches(const google::protobuf::FieldDescriptor* field) \
+            { return field->cpp_type() == ToProtoCppType<T >::as_enum(); } \
+            static T const& get(const google::protobuf::Message& msg,   \
+                                const google::protobuf::FieldDescriptor* field, \
+                                T* scratch)                             \
+            { return (*scratch = msg.GetReflection()->Get##NAME(msg, field)); } \
+            static T const& get_repeated(const google::protobuf::Message& msg, \
+                                         const google::protobuf::FieldDescriptor* field, \
+                                         int index, T* scratch)         \
+            { return (*scratch = msg.GetReflection()->GetRepeated##NAME(msg, field, index)); } \
+            static void set(google::protobuf::Message* msg,             \
+                            const google::protobuf::FieldDescriptor* field, \
+                            T const& value)                             \
+            { msg->GetReflection()->Set##NAME(msg, field, value); }     \
+            static void add(google::protobuf::Message* msg,             \
+                            const google::protobuf::FieldDescriptor* field, \
+                            T const& value)                             \
+            { msg->GetReflection()->Add##NAME(msg, field, value); }     \
+        }
+
+        DCCL_REFLECTION_ACCESS(double, Double);
+        DCCL_REFLECTION_ACCESS(float, Float);
+        DCCL_REFLECTION_ACCESS(google::protobuf::int32, Int32);
+        DCCL_REFLECTION_ACCESS(google::protobuf::uint32, UInt32);
+        DCCL_REFLECTION_ACCESS(google::protobuf::int64, Int64);
+        DCCL_REFLECTION_ACCESS(google::protobuf::uint64, UInt64);
+        DCCL_REFLECTION_ACCESS(bool, Bool);
+        DCCL_REFLECTION_ACCESS(const google::protobuf::EnumValueDescriptor*, Enum);
+#undef DCCL_REFLECTION_ACCESS
+
+        // strings are read by reference where the Reflection implementation allows it
+        template<>
+            struct ReflectionAccess<std::string>
+        {
+            enum { supported = true };
+            static bool matches(const google::protobuf::FieldDescriptor* field)
+            { return field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_STRING; }
+            static const std::string& get(const google::protobuf::Message& msg,
+                                          const google::protobuf::FieldDescriptor* field,
+                                          std::string* scratch)
+            { return msg.GetReflection()->GetStringReference(msg, field, scratch); }
+            static const std::string& get_repeated(const google::protobuf::Message& msg,
+                                                   const google::protobuf::FieldDescriptor* field,
+                                                   int index, std::string* scratch)
+            { return msg.GetReflection()->GetRepeatedStringReference(msg, field, index, scratch); }
+            static void set(google::protobuf::Message* msg,
+                            const google::protobuf::FieldDescriptor* field,
+                            const std::string& value)
+            { msg->GetReflection()->SetString(msg, field, value); }
+            static void add(google::protobuf::Message* msg,
+                            const google::protobuf::FieldDescriptor* field,
+                            const std::string& value)
+            { msg->GetReflection()->AddString(msg, field, value); }
+        };
     }
 }
 
@@ -0,0 +1,66 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLSNAPSHOT20261016H
+#define DCCLSNAPSHOT20261016H
+
+#include <boost/shared_ptr.hpp>
+
+namespace dccl
+{
+    namespace internal
+    {
+        /// \brief Holds the current version of a value that is replaced (by set()) rather than modified, so that other threads can keep using the version they got from get() while it is replaced.
+        ///
+        /// get() and set() may be called from any thread (though callers that build the new version from the current one must serialize their calls to set()). Each version is destroyed when it has been replaced and the last pointer to it from get() is released.
+        template<typename T>
+            class Snapshot
+        {
+          public:
+            Snapshot() { }
+            Snapshot(const Snapshot& other)
+                : current_(other.get())
+                { }
+            Snapshot& operator=(const Snapshot& other)
+            {
+                set(other.get());
+                return *this;
+            }
+
+            /// \brief The current version, or null if none has been set
+            boost::shared_ptr<const T> get() const
+            { return boost::atomic_load(&current_); }
+
+            /// \brief Replace the current version with `value`
+            void set(const boost::shared_ptr<const T>& value)
+            { boost::atomic_store(&current_, value); }
+
+            /// \brief Remove the current version
+            void reset()
+            { set(boost::shared_ptr<const T>()); }
+            
+          private:
+            boost::shared_ptr<const T> current_;
+        };
+    }
+}
+
+#endif
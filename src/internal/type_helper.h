@@ -58,17 +58,6 @@ namespace dccl
             
           private:
             friend class ::dccl::FieldCodecManager;
-            template<typename ProtobufMessage>
-                static void add()
-            {
-                custom_message_map_.insert(std::make_pair(ProtobufMessage::descriptor()->full_name(),
-                                                          boost::shared_ptr<FromProtoCppTypeBase>(new FromProtoCustomMessage<ProtobufMessage>)));
-            }
-            template<typename ProtobufMessage>
-                static void remove()
-            {
-                custom_message_map_.erase(ProtobufMessage::descriptor()->full_name());
-            }
             static void reset()
             {
                 inst_.reset();
@@ -80,7 +69,6 @@ namespace dccl
             {
                 type_map_.clear();
                 cpptype_map_.clear();
-                custom_message_map_.clear();
             }
             TypeHelper(const TypeHelper&);
             TypeHelper& operator= (const TypeHelper&);
@@ -100,9 +88,9 @@ namespace dccl
                 boost::shared_ptr<FromProtoCppTypeBase> > CppTypeMap;
             static CppTypeMap cpptype_map_;
 
+            // type helpers for the message types of message codecs (kept by FieldCodecManager with the codecs themselves)
             typedef std::map<std::string,
                 boost::shared_ptr<FromProtoCppTypeBase> > CustomMessageMap;
-            static CustomMessageMap custom_message_map_;
         };
     }
 }
@@ -0,0 +1,114 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <system_error>
+
+#include "work_stealing.h"
+
+dccl::internal::WorkerPool& dccl::internal::WorkerPool::instance()
+{
+    static WorkerPool pool;
+    return pool;
+}
+
+dccl::internal::WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_.notify_all();
+    for(std::vector<std::thread>::iterator it = threads_.begin(), end = threads_.end(); it != end; ++it)
+        it->join();
+}
+
+unsigned dccl::internal::WorkerPool::run(unsigned num_threads, const std::function<void(unsigned)>& job)
+{
+    bool expected = false;
+    if(num_threads < 2 || !busy_.compare_exchange_strong(expected, true))
+    {
+        job(0);
+        return 0;
+    }
+
+    unsigned helpers = start_threads(num_threads - 1);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &job;
+        participants_ = helpers;
+        remaining_ = helpers;
+        ++round_;
+    }
+    start_.notify_all();
+
+    job(0);
+    
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return remaining_ == 0; });
+        job_ = 0;
+    }
+    busy_.store(false);
+    return helpers;
+}
+
+unsigned dccl::internal::WorkerPool::start_threads(unsigned count)
+{
+    try
+    {
+        // so that adding a thread cannot fail once it has been started
+        threads_.reserve(count);
+        while(threads_.size() < count)
+            threads_.push_back(std::thread(&WorkerPool::work, this, static_cast<unsigned>(threads_.size()), round_));
+    }
+    catch(std::system_error&)
+    {
+        // carry on with the threads there are
+    }
+    catch(std::bad_alloc&)
+    {
+    }
+    return std::min<unsigned>(count, threads_.size());
+}
+
+void dccl::internal::WorkerPool::work(unsigned index, unsigned first_round)
+{
+    // rounds before this thread was started are not its to take part in
+    unsigned seen = first_round;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for(;;)
+    {
+        start_.wait(lock, [this, seen]() { return stop_ || round_ != seen; });
+        if(stop_)
+            return;
+        seen = round_;
+        if(index >= participants_)
+            continue;
+
+        const std::function<void(unsigned)>* job = job_;
+        lock.unlock();
+        (*job)(index + 1);
+        lock.lock();
+        
+        if(--remaining_ == 0)
+            done_.notify_all();
+    }
+}
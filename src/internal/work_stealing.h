@@ -0,0 +1,192 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLWORKSTEALING20261016H
+#define DCCLWORKSTEALING20261016H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dccl
+{
+    namespace internal
+    {
+        /// \brief Range of indices [begin, end) not yet taken by any thread
+        struct WorkRange
+        {
+            WorkRange() : begin(0), end(0) { }
+            std::mutex mutex;
+            std::size_t begin;
+            std::size_t end;
+        };
+
+        /// \brief Threads kept for running the jobs of parallel_for(), so that their thread_local caches (of codecs, options, etc.) are kept from one call to the next rather than being built again by new threads each time.
+        class WorkerPool
+        {
+          public:
+            /// \brief The pool shared by all callers
+            static WorkerPool& instance();
+
+            /// \brief Calls `job(t)` on the calling thread for t = 0 and on a pool thread for each t in [1, helpers], and returns `helpers` once all of these have returned. This is the number of pool threads used: `num_threads - 1`, or fewer if not that many threads can be started, or 0 if the pool is busy with another call (e.g. one made from a job). `job` must not throw.
+            unsigned run(unsigned num_threads, const std::function<void(unsigned)>& job);
+            
+          private:
+            WorkerPool() : job_(0), round_(0), participants_(0), remaining_(0), stop_(false), busy_(false) { }
+            ~WorkerPool();
+            WorkerPool(const WorkerPool&);
+            WorkerPool& operator=(const WorkerPool&);
+
+            // starts threads until there are `count` (or no more can be started), returning how many there are
+            unsigned start_threads(unsigned count);
+            // body of the `index`th thread, started when round_ was `first_round`
+            void work(unsigned index, unsigned first_round);
+
+            std::vector<std::thread> threads_;
+            
+            // guards the rest
+            std::mutex mutex_;
+            // signalled when a round starts (or the pool is stopped)
+            std::condition_variable start_;
+            // signalled when the last thread of a round finishes
+            std::condition_variable done_;
+            const std::function<void(unsigned)>* job_;
+            // incremented for each call to run()
+            unsigned round_;
+            // threads (by index) that take part in this round
+            unsigned participants_;
+            // participants yet to finish this round
+            unsigned remaining_;
+            bool stop_;
+
+            // set while a call to run() is using the threads
+            std::atomic<bool> busy_;
+        };
+        
+        /// \brief Number of threads to use when the caller asks for `num_threads` (0 meaning one per hardware thread) to work on `count` items
+        inline unsigned worker_count(unsigned num_threads, std::size_t count)
+        {
+            if(num_threads == 0)
+                num_threads = std::max(1u, std::thread::hardware_concurrency());
+            return static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(num_threads, count)));
+        }
+        
+        // takes up to `grain` indices from the front of `range`, returning false if it is empty
+        inline bool take_work(WorkRange* range, std::size_t grain, std::size_t* begin, std::size_t* end)
+        {
+            std::lock_guard<std::mutex> lock(range->mutex);
+            if(range->begin == range->end)
+                return false;
+            *begin = range->begin;
+            *end = std::min(range->end, range->begin + grain);
+            range->begin = *end;
+            return true;
+        }
+
+        // moves the back half of the fullest other range to ranges[thief], returning false if all of them are empty
+        inline bool steal_work(std::vector<WorkRange>* ranges, std::size_t thief)
+        {
+            for(;;)
+            {
+                std::size_t victim = thief, most = 0;
+                for(std::size_t i = 0, n = ranges->size(); i < n; ++i)
+                {
+                    if(i == thief) continue;
+                    std::lock_guard<std::mutex> lock((*ranges)[i].mutex);
+                    std::size_t remaining = (*ranges)[i].end - (*ranges)[i].begin;
+                    if(remaining > most)
+                    {
+                        most = remaining;
+                        victim = i;
+                    }
+                }
+                if(victim == thief)
+                    return false;
+
+                std::size_t begin, end;
+                {
+                    std::lock_guard<std::mutex> lock((*ranges)[victim].mutex);
+                    // emptied since we looked, so look again
+                    if((*ranges)[victim].begin == (*ranges)[victim].end)
+                        continue;
+                    end = (*ranges)[victim].end;
+                    begin = end - ((*ranges)[victim].end - (*ranges)[victim].begin + 1) / 2;
+                    (*ranges)[victim].end = begin;
+                }
+                
+                std::lock_guard<std::mutex> lock((*ranges)[thief].mutex);
+                (*ranges)[thief].begin = begin;
+                (*ranges)[thief].end = end;
+                return true;
+            }
+        }
+
+        /// \brief Calls `f(i)` for each i in [0, count), spread over up to worker_count(num_threads, count) threads: the calling thread and those of the WorkerPool.
+        ///
+        /// Each thread starts with an equal contiguous share of the indices, taken from the front a few at a time. A thread that runs out steals the back half of the largest remaining share, so threads that get cheaper items (or more CPU time) take on more of them, and the shares of any threads the pool could not provide are taken this way too. `f` must not throw.
+        template<typename Function>
+            void parallel_for(std::size_t count, unsigned num_threads, Function f)
+        {
+            const unsigned n = worker_count(num_threads, count);
+            if(n == 1)
+            {
+                for(std::size_t i = 0; i < count; ++i)
+                    f(i);
+                return;
+            }
+            
+            std::vector<WorkRange> ranges(n);
+            for(unsigned t = 0; t < n; ++t)
+            {
+                ranges[t].begin = count * t / n;
+                ranges[t].end = count * (t + 1) / n;
+            }
+
+            // small enough to balance the load, large enough to keep the locking cheap
+            const std::size_t grain = std::max<std::size_t>(1, count / (n * 64));
+            
+            auto work = [&ranges, &f, grain](std::size_t t)
+                {
+                    std::size_t begin, end;
+                    for(;;)
+                    {
+                        if(!take_work(&ranges[t], grain, &begin, &end))
+                        {
+                            if(!steal_work(&ranges, t))
+                                return;
+                            continue;
+                        }
+                        for(std::size_t i = begin; i < end; ++i)
+                            f(i);
+                    }
+                };
+
+            WorkerPool::instance().run(n, work);
+        }
+    }
+}
+
+#endif
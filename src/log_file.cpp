@@ -0,0 +1,280 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dccl/log_file.h"
+
+namespace dccl
+{
+    namespace
+    {
+        const char HEADER_MAGIC[] = "DCCLLOG1";
+        const char TRAILER_MAGIC[] = "DCCLIDX1";
+        const std::size_t MAGIC_SIZE = 8;
+        // size, id and time
+        const std::size_t RECORD_HEADER_SIZE = 4 + 4 + 8;
+        // offset, time, id and size
+        const std::size_t INDEX_ENTRY_SIZE = 8 + 8 + 4 + 4;
+        // index offset, count and magic
+        const std::size_t TRAILER_SIZE = 8 + 8 + MAGIC_SIZE;
+        
+        template<typename T>
+            void put_le(std::string* s, T value)
+        {
+            for(std::size_t i = 0; i < sizeof(T); ++i)
+                s->push_back(static_cast<char>((static_cast<uint64>(value) >> (8*i)) & 0xff));
+        }
+
+        template<typename T>
+            T get_le(const char* p)
+        {
+            uint64 value = 0;
+            for(std::size_t i = 0; i < sizeof(T); ++i)
+                value |= static_cast<uint64>(static_cast<unsigned char>(p[i])) << (8*i);
+            return static_cast<T>(value);
+        }
+    }
+}
+
+dccl::LogWriter::LogWriter(const std::string& path)
+    : file_(path.c_str(), std::ios::binary | std::ios::trunc),
+      offset_(MAGIC_SIZE)
+{
+    if(!file_.is_open())
+        throw(Exception("Failed to create log file: " + path));
+    file_.write(HEADER_MAGIC, MAGIC_SIZE);
+}
+
+dccl::LogWriter::~LogWriter()
+{
+    try
+    {
+        close();
+    }
+    catch(std::exception& e)
+    { }
+}
+
+void dccl::LogWriter::write(const std::string& bytes, uint32 id, int64 time)
+{
+    if(!file_.is_open())
+        throw(Exception("Log file has already been closed"));
+    
+    std::string record_header;
+    put_le<uint32>(&record_header, bytes.size());
+    put_le<uint32>(&record_header, id);
+    put_le<int64>(&record_header, time);
+    file_.write(record_header.data(), record_header.size());
+    file_.write(bytes.data(), bytes.size());
+    if(!file_)
+        throw(Exception("Failed to write to log file"));
+    
+    LogEntry entry;
+    entry.offset = offset_ + RECORD_HEADER_SIZE;
+    entry.time = time;
+    entry.id = id;
+    entry.size = bytes.size();
+    index_.push_back(entry);
+    
+    offset_ += RECORD_HEADER_SIZE + bytes.size();
+}
+
+void dccl::LogWriter::flush()
+{
+    file_.flush();
+}
+
+void dccl::LogWriter::close()
+{
+    if(!file_.is_open())
+        return;
+
+    std::string index;
+    index.reserve(index_.size() * INDEX_ENTRY_SIZE + TRAILER_SIZE);
+    for(std::vector<LogEntry>::const_iterator it = index_.begin(), end = index_.end(); it != end; ++it)
+    {
+        put_le<uint64>(&index, it->offset);
+        put_le<int64>(&index, it->time);
+        put_le<uint32>(&index, it->id);
+        put_le<uint32>(&index, it->size);
+    }
+    put_le<uint64>(&index, offset_);
+    put_le<uint64>(&index, index_.size());
+    index.append(TRAILER_MAGIC, MAGIC_SIZE);
+    
+    file_.write(index.data(), index.size());
+    file_.close();
+    if(!file_)
+        throw(Exception("Failed to write the index of the log file"));
+}
+
+dccl::LogReader::LogReader(const std::string& path)
+    : data_(0),
+      data_size_(0),
+      times_in_order_(true)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw(Exception("Failed to open log file " + path + ": " + std::strerror(errno)));
+
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) < 0)
+    {
+        ::close(fd);
+        throw(Exception("Failed to read log file " + path + ": " + std::strerror(errno)));
+    }
+    data_size_ = file_stat.st_size;
+
+    if(data_size_ < MAGIC_SIZE)
+    {
+        ::close(fd);
+        throw(Exception(path + " is not a DCCL log file"));
+    }
+        
+    void* mapped = mmap(0, data_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid without the descriptor
+    ::close(fd);
+    if(mapped == MAP_FAILED)
+        throw(Exception("Failed to map log file " + path + ": " + std::strerror(errno)));
+    data_ = static_cast<const char*>(mapped);
+    
+    if(std::memcmp(data_, HEADER_MAGIC, MAGIC_SIZE) != 0)
+    {
+        munmap(const_cast<char*>(data_), data_size_);
+        throw(Exception(path + " is not a DCCL log file"));
+    }
+    
+    if(!read_index())
+        recover_index();
+
+    for(std::size_t i = 0, n = index_.size(); i < n; ++i)
+    {
+        id_index_[index_[i].id].push_back(i);
+        if(i > 0 && index_[i].time < index_[i-1].time)
+            times_in_order_ = false;
+    }
+}
+
+dccl::LogReader::~LogReader()
+{
+    munmap(const_cast<char*>(data_), data_size_);
+}
+
+bool dccl::LogReader::read_index()
+{
+    if(data_size_ < MAGIC_SIZE + TRAILER_SIZE)
+        return false;
+
+    const char* trailer = data_ + data_size_ - TRAILER_SIZE;
+    if(std::memcmp(trailer + 16, TRAILER_MAGIC, MAGIC_SIZE) != 0)
+        return false;
+
+    uint64 index_offset = get_le<uint64>(trailer);
+    uint64 count = get_le<uint64>(trailer + 8);
+    if(index_offset < MAGIC_SIZE || index_offset > data_size_ - TRAILER_SIZE)
+        return false;
+    // checked before multiplying, as a corrupt count could overflow
+    uint64 index_size = data_size_ - TRAILER_SIZE - index_offset;
+    if(count > index_size / INDEX_ENTRY_SIZE || index_size != count * INDEX_ENTRY_SIZE)
+        return false;
+
+    index_.resize(count);
+    const char* p = data_ + index_offset;
+    for(uint64 i = 0; i < count; ++i, p += INDEX_ENTRY_SIZE)
+    {
+        LogEntry& entry = index_[i];
+        entry.offset = get_le<uint64>(p);
+        entry.time = get_le<int64>(p + 8);
+        entry.id = get_le<uint32>(p + 16);
+        entry.size = get_le<uint32>(p + 20);
+        if(entry.offset > index_offset || entry.size > index_offset - entry.offset)
+        {
+            index_.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void dccl::LogReader::recover_index()
+{
+    index_.clear();
+    std::size_t offset = MAGIC_SIZE;
+    // a partly written message at the end is left out
+    while(data_size_ - offset >= RECORD_HEADER_SIZE)
+    {
+        const char* p = data_ + offset;
+        LogEntry entry;
+        entry.size = get_le<uint32>(p);
+        entry.id = get_le<uint32>(p + 4);
+        entry.time = get_le<int64>(p + 8);
+        entry.offset = offset + RECORD_HEADER_SIZE;
+        if(entry.size > data_size_ - entry.offset)
+            break;
+
+        index_.push_back(entry);
+        offset = entry.offset + entry.size;
+    }
+}
+
+std::size_t dccl::LogReader::find_time(int64 time) const
+{
+    if(times_in_order_)
+    {
+        std::size_t low = 0, high = index_.size();
+        while(low < high)
+        {
+            std::size_t mid = low + (high - low) / 2;
+            if(index_[mid].time < time)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return low;
+    }
+    else
+    {
+        for(std::size_t i = 0, n = index_.size(); i < n; ++i)
+        {
+            if(index_[i].time >= time)
+                return i;
+        }
+        return index_.size();
+    }
+}
+
+std::size_t dccl::LogReader::find_id(uint32 id, std::size_t from /* = 0 */) const
+{
+    std::map<uint32, std::vector<std::size_t> >::const_iterator it = id_index_.find(id);
+    if(it == id_index_.end())
+        return index_.size();
+
+    std::vector<std::size_t>::const_iterator next = std::lower_bound(it->second.begin(), it->second.end(), from);
+    return (next == it->second.end()) ? index_.size() : *next;
+}
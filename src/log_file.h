@@ -0,0 +1,175 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLLOGFILE20261016H
+#define DCCLLOGFILE20261016H
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "codec.h"
+#include "common.h"
+#include "internal/work_stealing.h"
+
+namespace dccl
+{
+    /// \brief Where (and when) one encoded message is stored in a log file
+    struct LogEntry
+    {
+        /// \brief Offset of the encoded message from the start of the file (in bytes)
+        uint64 offset;
+        /// \brief Time given when the message was written (microseconds since the UNIX epoch, unless the writer chose another origin)
+        int64 time;
+        /// \brief DCCL id of the message
+        uint32 id;
+        /// \brief Size of the encoded message (in bytes)
+        uint32 size;
+    };
+
+    /// \brief Writes encoded messages (with the time of each) to a log file that can be read with LogReader.
+    ///
+    /// The file is made up of:
+    /// - an 8 byte header ("DCCLLOG1")
+    /// - for each message: its size (4 bytes), DCCL id (4 bytes) and time (8 bytes), followed by the encoded message
+    /// - an index of all the messages (a LogEntry of 24 bytes for each), written by close()
+    /// - a 24 byte trailer: the offset of the index (8 bytes), the number of messages (8 bytes) and "DCCLIDX1"
+    ///
+    /// All integers are little-endian. A file that was never closed (so has no index) can still be read: LogReader then finds the messages by reading them in order.
+    class LogWriter
+    {
+      public:
+        /// \brief Create (or replace) a log file
+        /// \throw Exception if the file cannot be created
+        explicit LogWriter(const std::string& path);
+
+        /// \brief Calls close()
+        ~LogWriter();
+
+        /// \brief Write one encoded message
+        ///
+        /// \param bytes Encoded message (as given by Codec::encode())
+        /// \param id DCCL id of the message
+        /// \param time Time of the message (microseconds since the UNIX epoch is recommended)
+        void write(const std::string& bytes, uint32 id, int64 time);
+
+        /// \brief Encode a message and write it
+        void write(Codec* codec, const google::protobuf::Message& msg, int64 time)
+        {
+            std::string bytes;
+            codec->encode(&bytes, msg);
+            write(bytes, codec->id(msg.GetDescriptor()), time);
+        }
+
+        /// \brief Write out any buffered messages (without the index)
+        void flush();
+        
+        /// \brief Write the index and close the file. Nothing more may be written after this.
+        void close();
+
+      private:
+        LogWriter(const LogWriter&);
+        LogWriter& operator=(const LogWriter&);
+
+        std::ofstream file_;
+        uint64 offset_;
+        std::vector<LogEntry> index_;
+    };
+
+    /// \brief Reads a log file written by LogWriter, which is mapped into memory (so the messages are not copied).
+    ///
+    /// For example, to decode all the messages of one type after a given time:
+    /// \code
+    /// dccl::LogReader log("vehicle.dccllog");
+    /// for(std::size_t i = log.find_id(codec.id<Status>(), log.find_time(start)); i < log.size(); i = log.find_id(codec.id<Status>(), i + 1))
+    /// {
+    ///     Status status;
+    ///     codec.decode(log.data(i), log.data(i) + log.entry(i).size, &status);
+    /// }
+    /// \endcode
+    class LogReader
+    {
+      public:
+        /// \brief Open and map a log file
+        /// \throw Exception if the file cannot be opened or is not a log file
+        explicit LogReader(const std::string& path);
+        ~LogReader();
+
+        /// \brief Number of messages in the log
+        std::size_t size() const
+        { return index_.size(); }
+
+        /// \brief Where the `i`th message is stored, and its time and id
+        const LogEntry& entry(std::size_t i) const
+        { return index_[i]; }
+
+        /// \brief The `i`th encoded message (which is entry(i).size bytes long)
+        const char* data(std::size_t i) const
+        { return data_ + index_[i].offset; }
+
+        /// \brief A copy of the `i`th encoded message
+        std::string bytes(std::size_t i) const
+        { return std::string(data(i), index_[i].size); }
+
+        /// \brief Index of the first message (in the order written) with a time at or after `time`, or size() if there is none.
+        ///
+        /// This is a binary search when the times are in order (as they usually are), and otherwise a search from the start.
+        std::size_t find_time(int64 time) const;
+
+        /// \brief Index of the first message (starting at `from`) with DCCL id `id`, or size() if there is none
+        std::size_t find_id(uint32 id, std::size_t from = 0) const;
+
+        /// \brief Calls `f(i)` for each message index i in [first, last), spread over several threads.
+        ///
+        /// Each thread works through a contiguous part of the log (taking part of another thread's when done), so `f` must be safe to call from several threads at once (e.g. by decoding with one Codec, see Codec::decode_batch(), and writing only to the i'th element of a result). `f` must not throw.
+        /// \param f Function (or similar) taking the index of a message
+        /// \param num_threads Number of threads to use, including the calling thread (0 for one per hardware thread)
+        /// \param first Index of the first message
+        /// \param last Past-the-end index (limited to size())
+        template<typename Function>
+            void scan(Function f, unsigned num_threads = 0, std::size_t first = 0, std::size_t last = std::string::npos) const
+        {
+            last = std::min(last, size());
+            if(first >= last)
+                return;
+            internal::parallel_for(last - first, num_threads, [&f, first](std::size_t i) { f(first + i); });
+        }
+        
+      private:
+        LogReader(const LogReader&);
+        LogReader& operator=(const LogReader&);
+
+        // reads the index written by LogWriter::close(), returning false if there isn't a valid one
+        bool read_index();
+        // finds the messages by reading them in order (as for a file that was never closed)
+        void recover_index();
+        
+        const char* data_;
+        std::size_t data_size_;
+        std::vector<LogEntry> index_;
+        // for find_id(): indices of the messages with each id
+        std::map<uint32, std::vector<std::size_t> > id_index_;
+        bool times_in_order_;
+    };
+}
+
+#endif
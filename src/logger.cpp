@@ -19,29 +19,215 @@
 //
 // You should have received a copy of the GNU Lesser General Public License
 // along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <condition_variable>
 #include <ctime>
+#include <sstream>
+#include <thread>
+
+#include <boost/lockfree/queue.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include "dccl/logger.h"
 
 dccl::Logger dccl::dlog;
 
-int dccl::internal::LogBuffer::sync() {
-    // all but last one
-    while(buffer_.size() > 1) {
-        display(buffer_.front());
-        buffer_.pop_front();
+namespace dccl
+{
+    namespace internal
+    {
+        // a line queued for the background thread
+        struct LogRecord
+        {
+            LogRecord(const std::string& s, logger::Verbosity verbosity, logger::Group group)
+                : s(s), verbosity(verbosity), group(group) { }
+            std::string s;
+            logger::Verbosity verbosity;
+            logger::Group group;
+        };
+
+        // passes queued lines to the LogBuffer's slots from a background thread
+        class AsyncLogSink
+        {
+          public:
+            explicit AsyncLogSink(LogBuffer* log) : log_(log), queue_(1024), stop_(false) { }
+            ~AsyncLogSink() { drain(); }
+
+            void start()
+            {
+                stop_ = false;
+                thread_ = std::thread(&AsyncLogSink::run, this);
+            }
+            
+            void stop()
+            {
+                stop_ = true;
+                wake_.notify_one();
+                thread_.join();
+                // anything queued after the thread's last look
+                drain();
+            }
+            
+            void push(LogRecord* record)
+            {
+                queue_.push(record);
+                wake_.notify_one();
+            }
+
+            // passes on the queued lines, holding the LogBuffer's display_mutex_ from taking each line until it has been displayed so that a thread writing directly (after stop_async()) cannot overtake its own earlier lines
+            void drain()
+            {
+                std::lock_guard<std::recursive_mutex> lock(log_->display_mutex_);
+                LogRecord* record;
+                while(queue_.pop(record))
+                {
+                    log_->display(record->s, record->verbosity, record->group);
+                    delete record;
+                }
+            }
+            
+          private:
+            void run()
+            {
+                while(!stop_)
+                {
+                    drain();
+                    // a wakeup between drain() and wait_for() is missed, so don't wait long
+                    std::unique_lock<std::mutex> lock(wake_mutex_);
+                    wake_.wait_for(lock, std::chrono::milliseconds(10));
+                }
+                drain();
+            }
+            
+            LogBuffer* log_;
+            boost::lockfree::queue<LogRecord*> queue_;
+            std::atomic<bool> stop_;
+            std::thread thread_;
+            std::mutex wake_mutex_;
+            std::condition_variable wake_;
+        };
+        
+        // the calling thread's buffer and stream for dccl::dlog
+        struct ThreadLog
+        {
+            explicit ThreadLog(LogBuffer* log) : buf(log), os(&buf) { }
+            ThreadLogBuffer buf;
+            std::ostream os;
+        };
+
+        ThreadLog& thread_log(LogBuffer* log)
+        {
+            static thread_local boost::scoped_ptr<ThreadLog> thread_log;
+            if(!thread_log || thread_log->buf.log() != log)
+                thread_log.reset(new ThreadLog(log));
+            return *thread_log;
+        }
+    }
+}
+
+int dccl::internal::ThreadLogBuffer::sync() {
+    pending_.append(pbase(), pptr());
+    setp(put_area_, put_area_ + sizeof(put_area_));
+
+    // all complete lines
+    std::string::size_type begin = 0, end;
+    while((end = pending_.find('\n', begin)) != std::string::npos)
+    {
+        log_->dispatch(pending_.substr(begin, end - begin), verbosity_, group_);
+        begin = end + 1;
     }
+    pending_.erase(0, begin);
+    
     verbosity_ = logger::INFO;
     group_ = logger::GENERAL;
     
     return 0;
 }
 
+int dccl::internal::ThreadLogBuffer::overflow(int c) {
+    pending_.append(pbase(), pptr());
+    setp(put_area_, put_area_ + sizeof(put_area_));
+    
+    if(c != EOF)
+    {
+        *pptr() = c;
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+dccl::internal::LogBuffer::~LogBuffer()
+{
+    stop_async();
+    delete sink_.load();
+}
+
+dccl::internal::ThreadLogBuffer& dccl::internal::LogBuffer::thread_buffer()
+{
+    return thread_log(this).buf;
+}
+
+std::ostream& dccl::internal::LogBuffer::thread_stream()
+{
+    return thread_log(this).os;
+}
+
+void dccl::internal::LogBuffer::dispatch(const std::string& s, logger::Verbosity verbosity, logger::Group group)
+{
+    // counted only once async_ has been seen set, and async_ read again after, so that stop_async() (which clears async_ before waiting for the count to reach zero) cannot miss a push (all sequentially consistent), yet need not wait for threads that keep logging after it cleared async_
+    if(async_.load())
+    {
+        pushes_in_flight_.fetch_add(1);
+        if(async_.load())
+        {
+            sink_.load()->push(new LogRecord(s, verbosity, group));
+            pushes_in_flight_.fetch_sub(1);
+            return;
+        }
+        pushes_in_flight_.fetch_sub(1);
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(display_mutex_);
+    // lines this thread queued before stop_async() go first
+    if(AsyncLogSink* sink = sink_.load())
+        sink->drain();
+    display(s, verbosity, group);
+}
+
+void dccl::internal::LogBuffer::start_async()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(async_) return;
+
+    if(!sink_) sink_ = new AsyncLogSink(this);
+    sink_.load()->start();
+    async_.store(true, std::memory_order_release);
+}
+
+void dccl::internal::LogBuffer::stop_async()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(!async_) return;
+
+    async_.store(false);
+    // threads that saw async_ set may still be pushing to the queue (at most one dispatch() each, as the next sees async_ cleared)
+    while(pushes_in_flight_.load())
+        std::this_thread::yield();
+    sink_.load()->stop();
+}
+
+int dccl::internal::LogBuffer::sync() {
+    return thread_buffer().pubsync();
+}
+
 int dccl::internal::LogBuffer::overflow(int c) {
-    if (c == EOF) { return c; }
-    else if(c == '\n') { buffer_.push_back(std::string()); }
-    else { buffer_.back().push_back(c); }
-    return c;
+    if(c == EOF)
+        return traits_type::not_eof(c);
+    else
+        return thread_buffer().sputc(c);
+}
+
+std::streamsize dccl::internal::LogBuffer::xsputn(const char* s, std::streamsize n) {
+    return thread_buffer().sputn(s, n);
 }
 
 void dccl::to_ostream(const std::string& msg, dccl::logger::Verbosity vrb,
@@ -58,19 +244,30 @@ void dccl::to_ostream(const std::string& msg, dccl::logger::Verbosity vrb,
         case logger::SIZE: grp_str = "{size}: "; break;
     }
     
-    std::time_t now = std::time(0);
-    std::tm* t = std::gmtime(&now);
-
     if(add_timestamp)
     {
-        *os << "[ " << (t->tm_year+1900) << "-"
-            << std::setw(2) << std::setfill('0') << (t->tm_mon+1) << "-"
-            << std::setw(2) << t->tm_mday
-            << " "
-            << std::setw(2) << t->tm_hour << ":"
-            << std::setw(2) << t->tm_min << ":"
-            << std::setw(2) << t->tm_sec << " ]: "
-            << std::setfill(' ');
+        // formatted at most once a second (per thread)
+        static thread_local std::time_t timestamp_time = -1;
+        static thread_local std::string timestamp;
+
+        std::time_t now = std::time(0);
+        if(now != timestamp_time)
+        {
+            std::tm t;
+            gmtime_r(&now, &t);
+        
+            std::ostringstream ss;
+            ss << "[ " << (t.tm_year+1900) << "-"
+               << std::setw(2) << std::setfill('0') << (t.tm_mon+1) << "-"
+               << std::setw(2) << t.tm_mday
+               << " "
+               << std::setw(2) << t.tm_hour << ":"
+               << std::setw(2) << t.tm_min << ":"
+               << std::setw(2) << t.tm_sec << " ]: ";
+            timestamp = ss.str();
+            timestamp_time = now;
+        }
+        *os << timestamp;
     }
     
     *os << grp_str << msg << std::endl;
@@ -22,13 +22,19 @@
 #ifndef DCCLLOGGER20121009H
 #define DCCLLOGGER20121009H
 
+#include <atomic>
 #include <iostream>
 #include <string>
-#include <deque>
 #include <iomanip>
+#include <mutex>
 #include <boost/signals2.hpp>
 #include <cstdio>
 
+/// \brief The most verbose dccl::dlog statements that are compiled in: statements of a higher verbosity (e.g. DEBUG2 and DEBUG3 for -DDCCL_LOG_LEVEL=DEBUG1) are removed entirely by the compiler.
+#ifndef DCCL_LOG_LEVEL
+#define DCCL_LOG_LEVEL DEBUG3
+#endif
+
 namespace dccl {
     namespace logger {
         /// Verbosity levels used by the Logger
@@ -47,7 +53,9 @@ namespace dccl {
         };
         enum Group 
         { GENERAL, ENCODE, DECODE, SIZE };
-  
+
+        /// Mask of the verbosities compiled in (see DCCL_LOG_LEVEL)
+        const int COMPILED_VERBOSITIES = DCCL_LOG_LEVEL | (DCCL_LOG_LEVEL - 1);
     }
 
     
@@ -57,25 +65,61 @@ namespace dccl {
     
     namespace internal
     {
+        class LogBuffer;
+        class AsyncLogSink;
+        
+        /// \brief Collects the messages written to dccl::dlog by one thread, passing each complete line on to the LogBuffer at the next std::flush or std::endl
+        class ThreadLogBuffer : public std::streambuf
+        {
+          public:
+            explicit ThreadLogBuffer(LogBuffer* log)
+                : log_(log), verbosity_(logger::INFO), group_(logger::GENERAL)
+            { setp(put_area_, put_area_ + sizeof(put_area_)); }
+
+            /// sets the verbosity level until the next sync()
+            void set_verbosity(logger::Verbosity verbosity)
+            { verbosity_ = verbosity; }
+
+            void set_group(logger::Group group)
+            { group_ = group; }
+
+            LogBuffer* log() { return log_; }
+            
+          private:
+            int sync();
+            int overflow(int c = EOF);
+            
+          private:
+            LogBuffer* log_;
+            logger::Verbosity verbosity_;
+            logger::Group group_;
+            char put_area_[256];
+            // text from the put area that does not yet make up a complete line
+            std::string pending_;
+        };
+        
+        /// \brief Sends the messages written to dccl::dlog (by any thread) to the connected slots
         class LogBuffer : public std::streambuf
         {
           public:
-          LogBuffer() : verbosity_(logger::INFO), group_(logger::GENERAL), buffer_(1) { }
-            ~LogBuffer() { }
+            LogBuffer() : enabled_verbosities_(0), async_(false), pushes_in_flight_(0), sink_(0) { }
+            ~LogBuffer();
 
             /// connect a signal to a slot (function pointer or similar)
             template <typename Slot>
                 void connect(int verbosity_mask, Slot slot) {
-                enabled_verbosities_ |= verbosity_mask;
+                std::lock_guard<std::mutex> lock(mutex_);
                 if(verbosity_mask & logger::WARN) warn_signal.connect(slot);
                 if(verbosity_mask & logger::INFO) info_signal.connect(slot);
                 if(verbosity_mask & logger::DEBUG1) debug1_signal.connect(slot);
                 if(verbosity_mask & logger::DEBUG2) debug2_signal.connect(slot);
                 if(verbosity_mask & logger::DEBUG3) debug3_signal.connect(slot);
+                enabled_verbosities_.fetch_or(verbosity_mask);
             }
      
             void disconnect(int verbosity_mask) {
-                enabled_verbosities_ &= ~verbosity_mask;
+                std::lock_guard<std::mutex> lock(mutex_);
+                enabled_verbosities_.fetch_and(~verbosity_mask);
                 if(verbosity_mask & logger::WARN) warn_signal.disconnect_all_slots();
                 if(verbosity_mask & logger::INFO) info_signal.disconnect_all_slots();
                 if(verbosity_mask & logger::DEBUG1) debug1_signal.disconnect_all_slots();
@@ -83,75 +127,107 @@ namespace dccl {
                 if(verbosity_mask & logger::DEBUG3) debug3_signal.disconnect_all_slots();
             }
  
-            /// sets the verbosity level until the next sync()
-            void set_verbosity(logger::Verbosity verbosity)
-            { verbosity_ = verbosity; }
+            bool contains(logger::Verbosity verbosity) const
+            { return verbosity & enabled_verbosities_.load(std::memory_order_relaxed); }
 
-            void set_group(logger::Group group)
-            { group_ = group; }
-        
-  
-            bool contains(logger::Verbosity verbosity)
-            { return verbosity & enabled_verbosities_; }
- 
-     
+            /// the calling thread's buffer
+            ThreadLogBuffer& thread_buffer();
+            /// the calling thread's stream (writing to thread_buffer())
+            std::ostream& thread_stream();
+
+            /// send a complete line to the slots for `verbosity`
+            void dispatch(const std::string& s, logger::Verbosity verbosity, logger::Group group);
+
+            void start_async();
+            void stop_async();
+            
           private:
-            /// virtual inherited from std::streambuf.
-            /// Called when std::endl or std::flush is inserted into the stream
+            // what is written directly to dccl::dlog as a std::ostream goes to the calling thread's buffer
             int sync();
-
-            /// virtual inherited from std::streambuf. Called when something is inserted into the stream
-            /// Called when std::endl or std::flush is inserted into the stream
             int overflow(int c = EOF);
+            std::streamsize xsputn(const char* s, std::streamsize n);
      
-
-            void display(const std::string& s) {
-                if(verbosity_ & logger::WARN) warn_signal(s, logger::WARN, group_);
-                if(verbosity_ & logger::INFO) info_signal(s, logger::INFO, group_);
-                if(verbosity_ & logger::DEBUG1) debug1_signal(s, logger::DEBUG1, group_);
-                if(verbosity_ & logger::DEBUG2) debug2_signal(s, logger::DEBUG2, group_);
-                if(verbosity_ & logger::DEBUG3) debug3_signal(s, logger::DEBUG3, group_);
+            void display(const std::string& s, logger::Verbosity verbosity, logger::Group group) {
+                if(verbosity & logger::WARN) warn_signal(s, logger::WARN, group);
+                if(verbosity & logger::INFO) info_signal(s, logger::INFO, group);
+                if(verbosity & logger::DEBUG1) debug1_signal(s, logger::DEBUG1, group);
+                if(verbosity & logger::DEBUG2) debug2_signal(s, logger::DEBUG2, group);
+                if(verbosity & logger::DEBUG3) debug3_signal(s, logger::DEBUG3, group);
             }
 
+            friend class AsyncLogSink;
+            
           private:
-            logger::Verbosity verbosity_;
-            logger::Group group_;
-            std::deque<std::string> buffer_;
-            int enabled_verbosities_; // mask of verbosity settings enabled
-
+            std::atomic<int> enabled_verbosities_; // mask of verbosity settings enabled
+            // serializes connect(), disconnect(), start_async() and stop_async()
+            std::mutex mutex_;
+            // serializes display() (recursive in case a slot itself writes to dlog)
+            std::recursive_mutex display_mutex_;
+            std::atomic<bool> async_;
+            // number of dispatch() calls that have seen async_ set and not yet finished (or given up) their push to sink_
+            std::atomic<int> pushes_in_flight_;
+            // created by the first start_async(), and kept until destruction as other threads may still be using it
+            std::atomic<AsyncLogSink*> sink_;
+            
             typedef boost::signals2::signal<void (const std::string& msg, logger::Verbosity vrb, logger::Group grp)>
                 LogSignal;
                                               
             LogSignal warn_signal, info_signal, debug1_signal, debug2_signal, debug3_signal;
         
         };
+
+        // inserts `value` into `os`, finding the operator<< from here rather than from within Logger (whose own operator<< would hide the others)
+        template<typename T>
+            std::ostream& log_insert(std::ostream& os, const T& value)
+        { return os << value; }
     }
 
-    /// The DCCL Logger class. Do not instantiate this class directly. Rather, use the dccl::dlog object. 
+    /// \brief The DCCL Logger class. Do not instantiate this class directly. Rather, use the dccl::dlog object. 
+    ///
+    /// Each thread writes to a buffer of its own, so dlog may be used by several threads at once. Each line is passed to the connected slots whole, either by the thread that wrote it or (after start_async()) by a background thread.
     class Logger : public std::ostream {
       public:
       Logger() : std::ostream(&buf_) { }
         virtual ~Logger() { }
 
-        /// \brief Indicates the verbosity of the Logger until the next std::flush or std::endl. The boolean return is used to take advantage of short-circuit evaluation of && to avoid spending CPU time generating log files that if they are not used.
+        /// \brief Indicates the verbosity of the Logger (for the calling thread) until the next std::flush or std::endl. The boolean return is used to take advantage of short-circuit evaluation of && to avoid spending CPU time generating log files that if they are not used.
         ///
         /// The typical usage is
         /// \code
         /// dlog.is(INFO) && dlog << "Something of interest." << std::endl;
         /// dlog.is(WARN, ENCODE) && dlog << "Something bad happened while encoding." << std::endl;
         /// \endcode
+        /// Statements more verbose than DCCL_LOG_LEVEL are removed at compile time.
         /// \param verbosity The verbosity level to tag the following message with. These levels are used to direct the output of dlog to different logs or omit them completely.
         /// \param group The group that this message belongs to.
         bool is(logger::Verbosity verbosity, logger::Group group = logger::GENERAL) {
-            if (!buf_.contains(verbosity)) {
+            if (!(verbosity & logger::COMPILED_VERBOSITIES) || !buf_.contains(verbosity)) {
                 return false;
             } else {
-                buf_.set_verbosity(verbosity);
-                buf_.set_group(group);
+                internal::ThreadLogBuffer& thread_buf = buf_.thread_buffer();
+                thread_buf.set_verbosity(verbosity);
+                thread_buf.set_group(group);
                 return true;
             }
         }     
-     
+
+        /// \brief Write to the calling thread's log message
+        template<typename T>
+            std::ostream& operator<<(const T& value)
+        { return internal::log_insert(buf_.thread_stream(), value); }
+
+        /// \brief Apply a manipulator (e.g. std::endl) to the calling thread's log message
+        std::ostream& operator<<(std::ostream& (*manip)(std::ostream&))
+        { return manip(buf_.thread_stream()); }
+
+        /// \brief Apply a manipulator (e.g. std::hex) to the calling thread's log message
+        std::ostream& operator<<(std::ios_base& (*manip)(std::ios_base&))
+        {
+            std::ostream& os = buf_.thread_stream();
+            manip(os);
+            return os;
+        }
+        
         /// \brief Connect the output of one or more given verbosities to a slot (function pointer or similar)
         ///
         /// \param verbosity_mask A bitmask representing the verbosity or verbosities to send to this slot. For example, you can use connect(WARN | INFO, slot) to send both WARN and INFO messages to slot.
@@ -188,6 +264,16 @@ namespace dccl {
         /// \brief Disconnect all slots for one or more given verbosities
         void disconnect(int verbosity_mask)
         { buf_.disconnect(verbosity_mask); }
+
+        /// \brief Pass log messages to the slots from a background thread, so that the threads writing them only have to queue them (on a lock-free queue).
+        ///
+        /// Slots are then called from the background thread (one message at a time).
+        void start_async()
+        { buf_.start_async(); }
+        
+        /// \brief Stop the background thread started by start_async(), once it has passed on the messages already queued. Slots are then called from the thread writing each message again.
+        void stop_async()
+        { buf_.stop_async(); }
         
       private:
         internal::LogBuffer buf_;
@@ -0,0 +1,176 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "dccl/stream_decoder.h"
+
+dccl::StreamDecoder::StreamDecoder(Codec* codec, const char* begin, const char* end)
+    : codec_(codec),
+      buffer_begin_(begin),
+      is_(0),
+      fd_(-1),
+      input_end_(true),
+      cursor_(0),
+      end_(end - begin),
+      offset_(0),
+      lookahead_(0),
+      lookahead_loaded_(0)
+{
+}
+
+dccl::StreamDecoder::StreamDecoder(Codec* codec, std::istream* is)
+    : codec_(codec),
+      buffer_begin_(0),
+      is_(is),
+      fd_(-1),
+      input_end_(false),
+      cursor_(0),
+      end_(0),
+      offset_(0),
+      lookahead_(0),
+      lookahead_loaded_(0)
+{
+}
+
+dccl::StreamDecoder::StreamDecoder(Codec* codec, int fd)
+    : codec_(codec),
+      buffer_begin_(0),
+      is_(0),
+      fd_(fd),
+      input_end_(false),
+      cursor_(0),
+      end_(0),
+      offset_(0),
+      lookahead_(0),
+      lookahead_loaded_(0)
+{
+}
+
+bool dccl::StreamDecoder::next(google::protobuf::Message* msg)
+{
+    fill(lookahead());
+    if(cursor_ == end_)
+        return false;
+
+    const char* begin = data() + cursor_;
+    const char* actual_end = codec_->decode(begin, data() + end_, msg);
+    cursor_ += actual_end - begin;
+    return true;
+}
+
+std::size_t dccl::StreamDecoder::skip(std::size_t bytes)
+{
+    std::size_t skipped = 0;
+    while(skipped < bytes)
+    {
+        // no more than a block at a time, so the buffer is not grown to `bytes`
+        fill(std::min(bytes - skipped, std::max<std::size_t>(lookahead(), 1 << 16)));
+        std::size_t n = std::min(bytes - skipped, end_ - cursor_);
+        if(n == 0)
+            break;
+        cursor_ += n;
+        skipped += n;
+    }
+    return skipped;
+}
+
+bool dccl::StreamDecoder::at_end()
+{
+    fill(lookahead());
+    return cursor_ == end_;
+}
+
+void dccl::StreamDecoder::fill(std::size_t bytes)
+{
+    if(input_end_ || end_ - cursor_ >= bytes)
+        return;
+
+    // keep only what has not been decoded yet (which is shorter than one message), so each byte is moved at most once or twice
+    if(cursor_ > 0)
+    {
+        std::memmove(&buffer_[0], &buffer_[cursor_], end_ - cursor_);
+        offset_ += cursor_;
+        end_ -= cursor_;
+        cursor_ = 0;
+    }
+
+    // read in large blocks, to make few read calls
+    const std::size_t min_read = 1 << 16;
+    if(buffer_.size() < std::max(bytes, min_read))
+        buffer_.resize(std::max(bytes, min_read));
+    
+    while(end_ < bytes)
+    {
+        std::size_t bytes_read = read(&buffer_[end_], buffer_.size() - end_);
+        if(bytes_read == 0)
+        {
+            input_end_ = true;
+            break;
+        }
+        end_ += bytes_read;
+    }
+}
+
+std::size_t dccl::StreamDecoder::read(char* buffer, std::size_t max_bytes)
+{
+    if(is_)
+    {
+        // read only what is available now, and otherwise block for the next byte (as for a file descriptor), so as not to wait for a whole block on a live stream
+        std::streamsize bytes_read = is_->rdbuf()->sgetn(buffer, std::min<std::streamsize>(std::max<std::streamsize>(is_->rdbuf()->in_avail(), 1), max_bytes));
+        if(bytes_read <= 0)
+            is_->setstate(std::ios::eofbit);
+        return std::max<std::streamsize>(bytes_read, 0);
+    }
+    else
+    {
+        for(;;)
+        {
+            ssize_t bytes_read = ::read(fd_, buffer, max_bytes);
+            if(bytes_read >= 0)
+                return bytes_read;
+            else if(errno != EINTR)
+                throw(Exception(std::string("Failed to read encoded messages: ") + std::strerror(errno)));
+        }
+    }
+}
+
+std::size_t dccl::StreamDecoder::lookahead()
+{
+    if(input_end_)
+        return 0;
+    
+    const std::map<int32, const google::protobuf::Descriptor*>& loaded = codec_->loaded();
+    if(loaded.size() != lookahead_loaded_)
+    {
+        lookahead_ = 0;
+        for(std::map<int32, const google::protobuf::Descriptor*>::const_iterator it = loaded.begin(),
+                end = loaded.end(); it != end; ++it)
+            lookahead_ = std::max<std::size_t>(lookahead_, codec_->max_size(it->second));
+        lookahead_loaded_ = loaded.size();
+    }
+    // at least enough to tell if there is another message
+    return std::max<std::size_t>(lookahead_, 1);
+}
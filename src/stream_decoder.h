@@ -0,0 +1,148 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLSTREAMDECODER20261016H
+#define DCCLSTREAMDECODER20261016H
+
+#include <istream>
+#include <memory>
+#include <vector>
+
+#include "codec.h"
+
+namespace dccl
+{
+    /// \brief Decodes messages encoded back to back (e.g. a log of messages, or what has been received over a link), one at a time.
+    ///
+    /// A cursor is moved past each message as it is decoded, so the encoded messages are neither copied nor removed from the front of a buffer (as Codec::decode(std::string*) does). For example:
+    /// \code
+    /// dccl::StreamDecoder decoder(&codec, bytes.data(), bytes.data() + bytes.size());
+    /// while(boost::shared_ptr<google::protobuf::Message> msg = decoder.next<boost::shared_ptr<google::protobuf::Message> >())
+    ///     std::cout << msg->ShortDebugString() << std::endl;
+    /// \endcode
+    /// When reading from a std::istream or file descriptor, the bytes are read (in large blocks from a file descriptor) into a buffer that is kept at least as long as the largest loaded message, or until the end of the stream is reached.
+    class StreamDecoder
+    {
+      public:
+        /// \brief Decode the messages in a contiguous buffer, which must remain valid (and unchanged) while this StreamDecoder is used
+        ///
+        /// \param codec Codec with all the messages in the buffer loaded
+        /// \param begin First byte of the first message
+        /// \param end Past-the-end of the last message
+        StreamDecoder(Codec* codec, const char* begin, const char* end);
+
+        /// \brief Decode the messages read from a stream (until the end of the stream)
+        ///
+        /// \param codec Codec with all the messages in the stream loaded
+        /// \param is Stream of encoded messages (opened in binary mode)
+        StreamDecoder(Codec* codec, std::istream* is);
+
+        /// \brief Decode the messages read from a file descriptor (until end of file)
+        ///
+        /// \param codec Codec with all the messages read loaded
+        /// \param fd Open file descriptor (e.g. a file, pipe or socket), which is not closed by this StreamDecoder
+        StreamDecoder(Codec* codec, int fd);
+        
+        /// \brief Decode the next message, when its type is known.
+        ///
+        /// \param msg The decoded message will be written here
+        /// \throw Exception if the message cannot be decoded (the cursor is then not moved, see skip())
+        /// \return false (leaving `msg` unchanged) if there are no more messages
+        bool next(google::protobuf::Message* msg);
+
+        /// \brief Decode the next message, whose type is any loaded message.
+        ///
+        /// \tparam GoogleProtobufMessagePointer anything that acts like a pointer (has operator*) to a google::protobuf::Message (smart pointers like boost::shared_ptr included)
+        /// \throw Exception if the message cannot be decoded (the cursor is then not moved, see skip())
+        /// \return pointer to the decoded message (which you are responsible for deleting), or a null pointer if there are no more messages
+        template<typename GoogleProtobufMessagePointer>
+            GoogleProtobufMessagePointer next()
+        {
+            if(at_end())
+                return GoogleProtobufMessagePointer();
+
+            const char* begin = data() + cursor_;
+            const char* end = data() + end_;
+            unsigned this_id = codec_->id(begin, end);
+            std::map<int32, const google::protobuf::Descriptor*>::const_iterator it = codec_->loaded().find(this_id);
+            if(it == codec_->loaded().end())
+                throw(Exception("Message id " + boost::lexical_cast<std::string>(this_id) + " has not been loaded. Call load() before decoding this type."));
+
+            // owned here until it is decoded, so it is not leaked if decoding throws
+            std::unique_ptr<google::protobuf::Message> msg(DynamicProtobufManager::new_protobuf_message<google::protobuf::Message*>(it->second));
+            next(msg.get());
+            return GoogleProtobufMessagePointer(msg.release());
+        }
+
+        /// \brief Skip over bytes without decoding them, e.g. to resynchronize after a message that cannot be decoded (next() throws and does not move the cursor).
+        ///
+        /// As messages are not delimited, the only way to find the next one after a corrupt message is to skip forward one byte at a time until next() succeeds (which may also decode garbage that happens to be valid).
+        /// \param bytes Number of bytes to skip
+        /// \return The number of bytes skipped, which is less than `bytes` only if the end of the input was reached
+        std::size_t skip(std::size_t bytes);
+
+        /// \brief Whether all the messages have been decoded (this may read from the stream or file descriptor)
+        bool at_end();
+
+        /// \brief Number of bytes decoded so far
+        std::size_t position() const
+        { return offset_ + cursor_; }
+        
+      private:
+        StreamDecoder(const StreamDecoder&);
+        StreamDecoder& operator=(const StreamDecoder&);
+
+        const char* data() const
+        { return buffer_begin_ ? buffer_begin_ : (buffer_.empty() ? 0 : &buffer_[0]); }
+        
+        // reads until there are at least `bytes` bytes after the cursor, or the end of the input
+        void fill(std::size_t bytes);
+        
+        // reads up to `max_bytes` into `buffer`, returning the number of bytes read (0 at the end of the input)
+        std::size_t read(char* buffer, std::size_t max_bytes);
+
+        // maximum encoded size of the loaded messages
+        std::size_t lookahead();
+        
+      private:
+        Codec* codec_;
+
+        // the caller's buffer, if given
+        const char* buffer_begin_;
+        // otherwise bytes read from is_ or fd_
+        std::vector<char> buffer_;
+        std::istream* is_;
+        int fd_;
+        bool input_end_;
+
+        // bytes of data() before the cursor, and up to the end of the bytes available
+        std::size_t cursor_;
+        std::size_t end_;
+        // bytes discarded from the front of buffer_ so far
+        std::size_t offset_;
+
+        // lookahead() for the messages loaded when it was computed
+        std::size_t lookahead_;
+        std::size_t lookahead_loaded_;
+    };
+}
+
+#endif
@@ -22,9 +22,12 @@
 #include <iostream>
 #include <cassert>
 #include <utility>
+#include <algorithm>
 
 #include "dccl/binary.h"
 #include "dccl/bitset.h"
+#include "dccl/bitreader.h"
+#include "dccl/bitwriter.h"
 
 using dccl::Bitset;
 
@@ -158,7 +161,255 @@ int main()
         assert(grandparent.to_ulong() == 0xD);
     }
 
-    
+    // bitsets spanning multiple storage words
+    {
+        std::cout << std::endl;
+        const std::string hex = "0123456789abcdeffedcba9876543210a5";
+        Bitset big;
+        big.from_byte_string(dccl::hex_decode(hex));
+        std::cout << big.size() << ": " << big << std::endl;
+        assert(big.size() == 136);
+        assert(dccl::hex_encode(big.to_byte_string()) == hex);
+
+        // append across a word boundary that is not byte aligned
+        Bitset joined(3, 0x5);
+        joined.append(big);
+        assert(joined.size() == 139);
+        for(Bitset::size_type i = 0; i < big.size(); ++i)
+            assert(joined[i+3] == big[i]);
+        assert(joined.to_string() == big.to_string() + "101");
+
+        joined.prepend(Bitset(61, 0));
+        assert(joined.size() == 200);
+        assert(joined.to_string().substr(0, 139) == big.to_string() + "101");
+        assert(joined.to_string().substr(139) == std::string(61, '0'));
+
+        // push/pop at both ends
+        Bitset edge(63, 0);
+        edge.push_back(true);
+        edge.push_back(true);
+        assert(edge.size() == 65);
+        edge.push_front(true);
+        assert(edge.size() == 66);
+        assert(edge.front() && edge[64] && edge.back() && !edge[63]);
+        edge.pop_front();
+        edge.pop_back();
+        assert(edge.size() == 64);
+        assert(edge.to<dccl::uint64>() == (static_cast<dccl::uint64>(1) << 63));
+
+        // resize keeps bits beyond size() clear
+        edge.resize(130, true);
+        edge.resize(70);
+        edge.resize(128);
+        assert(edge.to_string().substr(0, 58) == std::string(58, '0'));
+        assert(edge.to_string().substr(58) == std::string(7, '1') + std::string(63, '0'));
+
+        // word-wise logic and comparison
+        Bitset a(big), b(big);
+        assert(a == b);
+        b.flip(134);
+        assert(a != b);
+        assert(a < b);
+        assert((a ^ b).to_string() == "01" + std::string(134, '0'));
+        assert((a & b) == Bitset(a).reset(134));
+        assert((a | b) == Bitset(a).set(134));
+
+        // iterators
+        const std::string big_str = big.to_string();
+        assert(std::count(big.begin(), big.end(), true) ==
+               std::count(big_str.begin(), big_str.end(), '1'));
+        std::string reversed;
+        for(Bitset::const_reverse_iterator it = big.rbegin(), end = big.rend(); it != end; ++it)
+            reversed += *it ? '1' : '0';
+        assert(reversed == big_str);
+
+        // shifts by less than, equal to, and more than one word
+        const unsigned shifts[] = { 0, 1, 7, 63, 64, 65, 100, 135, 136, 200 };
+        for(unsigned i = 0; i < sizeof(shifts)/sizeof(unsigned); ++i)
+        {
+            const unsigned n = shifts[i];
+            const std::string zeros(std::min<unsigned>(n, big.size()), '0');
+
+            std::string expected_left = big_str.substr(zeros.size()) + zeros;
+            std::string expected_right = zeros + big_str.substr(0, big.size() - zeros.size());
+
+            assert((big << n).to_string() == expected_left);
+            assert((big >> n).to_string() == expected_right);
+
+            Bitset shifted(big);
+            shifted <<= n;
+            assert(shifted.to_string() == expected_left);
+            shifted = big;
+            shifted >>= n;
+            assert(shifted.to_string() == expected_right);
+
+            if(n <= big.size())
+            {
+                Bitset truncated(big);
+                truncated.shift_and_truncate(n);
+                assert(truncated.size() == big.size() - n);
+                assert(truncated.to_string() == big_str.substr(0, big.size() - n));
+            }
+        }
+
+        Bitset too_short(8, 0xFF);
+        bool caught = false;
+        try { too_short.shift_and_truncate(9); }
+        catch(dccl::Exception&) { caught = true; }
+        assert(caught);
+
+        // get_more_bits across multiple words
+        Bitset parent(big);
+        Bitset child(&parent);
+        child.get_more_bits(70);
+        assert(child.size() == 70);
+        assert(parent.size() == 66);
+        assert(child.to_string() == big_str.substr(66));
+        assert(parent.to_string() == big_str.substr(0, 66));
+    }
+
+    // arbitrary offset integer access
+    {
+        Bitset bits(150);
+        bits.write_bits(0, 5, 0x15);
+        bits.write_bits(60, 10, 0x3a5); // spans a word boundary
+        bits.write_bits(86, 64, 0xfedcba9876543210ull);
+        bits.write_bits(70, 16, 0xffffffff); // higher bits ignored
+
+        assert(bits.read_bits(0, 5) == 0x15);
+        assert(bits.read_bits(60, 10) == 0x3a5);
+        assert(bits.read_bits(70, 16) == 0xffff);
+        assert(bits.read_bits(86, 64) == 0xfedcba9876543210ull);
+        assert(bits.read_bits(5, 55) == 0);
+        assert(bits.read_bits(62, 3) == 0x1);
+        assert(bits.read_bits(0, 0) == 0);
+
+        // overwrite clears the old value
+        bits.write_bits(60, 10, 0x0);
+        assert(bits.read_bits(56, 20) == 0xfc000);
+
+        std::string expected = bits.to_string();
+        for(unsigned i = 0; i < 150; ++i)
+            assert(bits.read_bits(i, 1) == (expected[149-i] == '1' ? 1u : 0u));
+
+        bool caught = false;
+        try { bits.read_bits(100, 51); }
+        catch(dccl::Exception&) { caught = true; }
+        assert(caught);
+
+        caught = false;
+        try { bits.write_bits(0, 65, 0); }
+        catch(dccl::Exception&) { caught = true; }
+        assert(caught);
+
+        Bitset word;
+        word.from<dccl::uint64>(0x8000000000000001ull);
+        assert(word.size() == 64);
+        assert(word.to<dccl::uint64>() == 0x8000000000000001ull);
+    }
+
+    // reading in place from a byte buffer
+    {
+        const std::string bytes = dccl::hex_decode("d10212a5ff0123456789abcdef");
+        dccl::BitReader reader(bytes.data(), bytes.data() + bytes.size());
+        assert(reader.size() == bytes.size()*8);
+
+        assert(reader.read(4) == 0x1);
+        assert(reader.read(8) == 0x2d);
+        reader.skip(4);
+        assert(reader.position() == 16);
+        assert(reader.read(12) == 0x512);
+
+        // hierarchy rooted at the reader: empty intermediate Bitsets pass bits straight through
+        Bitset root(&reader);
+        Bitset message(&root);
+        Bitset field(&message);
+        field.get_more_bits(12);
+        assert(field.to_ulong() == 0xffa);
+        assert(root.empty() && message.empty());
+
+        Bitset big_field(&message);
+        big_field.get_more_bits(64);
+        assert(dccl::hex_encode(big_field.to_byte_string()) == "0123456789abcdef");
+        assert(big_field.size() == 64);
+        assert(reader.remaining() == 0);
+
+        bool caught = false;
+        try { field.get_more_bits(1); }
+        catch(dccl::Exception&) { caught = true; }
+        assert(caught);
+    }
+
+    // writing into a byte buffer
+    {
+        std::string buffer(9, '\xff'); // writer does not need a zeroed buffer
+        dccl::BitWriter writer(&buffer[0], &buffer[0] + buffer.size());
+        writer.write(0x1, 4);
+        writer.write(0x2d, 8);
+        writer.write_zeros(4);
+        assert(writer.size() == 16);
+        writer.write(Bitset(12, 0xa12));
+        writer.pad_to_byte();
+        assert(writer.byte_size() == 4);
+        assert(dccl::hex_encode(buffer.substr(0, writer.byte_size())) == "d102120a");
+
+        writer.write(0x0123456789abcdefull, 36);
+        writer.write(0x0, 0);
+        assert(writer.byte_size() == 9);
+        assert(dccl::hex_encode(buffer.substr(4)) == "efcdab8907");
+
+        bool caught = false;
+        try { writer.write(0x0, 5); }
+        catch(std::length_error&) { caught = true; }
+        assert(caught);
+    }
+
+    // bulk byte copies, at aligned and unaligned bit offsets
+    {
+        std::string bytes;
+        for(int i = 0; i < 21; ++i)
+            bytes += static_cast<char>(i * 37 + 5);
+
+        for(unsigned offset = 0; offset < 17; ++offset)
+        {
+            Bitset bits(offset, 0x1a5a5);
+            bits.append_bytes(bytes.data(), bytes.size());
+            assert(bits.size() == offset + bytes.size() * 8);
+
+            // same as appending bit by bit
+            Bitset expected(offset, 0x1a5a5);
+            Bitset byte_bits;
+            byte_bits.from_byte_string(bytes);
+            for(Bitset::size_type i = 0; i < byte_bits.size(); ++i)
+                expected.push_back(byte_bits[i]);
+            assert(bits == expected);
+
+            std::string out(bytes.size(), 0);
+            bits.copy_bytes(offset, &out[0], out.size());
+            assert(out == bytes);
+
+            std::string buffer(bytes.size() + 3, 0);
+            dccl::BitWriter writer(&buffer[0], &buffer[0] + buffer.size());
+            writer.write(0x1a5a5, offset);
+            writer.write_bytes(bytes.data(), bytes.size());
+            writer.pad_to_byte();
+            assert(buffer.substr(0, writer.byte_size()) == bits.to_byte_string());
+
+            dccl::BitWriter bitset_writer(&buffer[0], &buffer[0] + buffer.size());
+            bitset_writer.write(bits);
+            assert(buffer.substr(0, bitset_writer.byte_size()) == bits.to_byte_string());
+        }
+
+        bool caught = false;
+        try
+        {
+            std::string out(3, 0);
+            Bitset(20).copy_bytes(1, &out[0], 3);
+        }
+        catch(dccl::Exception&) { caught = true; }
+        assert(caught);
+    }
+
     std::cout << "all tests passed" << std::endl;
     
     return 0;
@@ -131,6 +131,19 @@ int main(int argc, char* argv[])
     std::string bytes;
     codec.encode(&bytes, msg_in);
     std::cout << "... got bytes (hex): " << dccl::hex_encode(bytes) << std::endl;
+    assert(codec.size(msg_in) == bytes.size());
+
+    // encode directly into a caller supplied buffer
+    {
+        std::vector<char> buffer(bytes.size());
+        size_t len = codec.encode(&buffer[0], buffer.size(), msg_in);
+        assert(std::string(buffer.begin(), buffer.begin() + len) == bytes);
+
+        bool too_small = false;
+        try { codec.encode(&buffer[0], buffer.size() - 1, msg_in); }
+        catch(std::length_error&) { too_small = true; }
+        assert(too_small);
+    }
 
     std::cout << "Try decode..." << std::endl;
     decode_check(bytes);
@@ -0,0 +1,217 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests all protobuf types with _default codecs, repeat and non repeat
+// counts heap allocations made while encoding to check that the fields are encoded without any (the per-field Bitsets stay inline)
+
+#include <new>
+#include <cstdlib>
+#include <cassert>
+
+#include "dccl/codec.h"
+#include "dccl/binary.h"
+#include "test.pb.h"
+using namespace dccl::test;
+
+namespace
+{
+    bool counting = false;
+    unsigned allocations = 0;
+
+    void* counted_malloc(std::size_t size)
+    {
+        void* p = std::malloc(size ? size : 1);
+        if(!p)
+            throw std::bad_alloc();
+        return p;
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    if(counting)
+        ++allocations;
+    return counted_malloc(size);
+}
+
+void operator delete(void* p)
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t)
+{
+    std::free(p);
+}
+
+void* operator new[](std::size_t size)
+{
+    if(counting)
+        ++allocations;
+    return counted_malloc(size);
+}
+
+void operator delete[](void* p)
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t)
+{
+    std::free(p);
+}
+
+void start_count()
+{
+    allocations = 0;
+    counting = true;
+}
+
+unsigned stop_count()
+{
+    counting = false;
+    return allocations;
+}
+
+int main(int argc, char* argv[])
+{
+    // short (inline) Bitsets
+    {
+        start_count();
+        dccl::Bitset a(20, 0xABCDE);
+        dccl::Bitset b(100);
+        b.set(99);
+        a.append(b);
+        dccl::Bitset c(a);
+        c <<= 7;
+        c >>= 3;
+        c.push_front(true);
+        c.pop_back();
+        c ^= a;
+        a.swap(c);
+        c.from_byte_string(std::string("0123456789abcde"));
+        unsigned n = stop_count();
+        std::cout << "128 bit Bitset operations: " << n << " allocations" << std::endl;
+        assert(n == 0);
+    }
+
+    // long Bitsets spill to the heap, and swap correctly between inline and heap storage
+    {
+        dccl::Bitset small(10, 0x3FF);
+        dccl::Bitset large(300);
+        large.set(299);
+        large.set(0);
+        dccl::Bitset large_copy(large), small_copy(small);
+        small.swap(large);
+        assert(small == large_copy);
+        assert(large == small_copy);
+        small.swap(large);
+        assert(small == small_copy);
+        assert(large == large_copy);
+        large.resize(64);
+        assert(large.to_ulong() == 1);
+    }
+
+    dccl::Codec codec;
+    codec.load<TestMsg>();
+
+    TestMsg msg;
+    int i = 0;
+    msg.set_double_default_optional(++i + 0.1);
+    msg.set_int32_default_optional(++i);
+    msg.set_int64_default_optional(-++i);
+    msg.set_uint32_default_optional(++i);
+    msg.set_sint32_default_optional(-++i);
+    msg.set_fixed64_default_optional(++i);
+    msg.set_bool_default_optional(true);
+    msg.set_string_default_optional("abc123");
+    msg.set_bytes_default_optional(dccl::hex_decode("00112233aabbcc1234"));
+    msg.set_enum_default_optional(ENUM_C);
+    msg.mutable_msg_default_optional()->set_val(++i + 0.3);
+
+    msg.set_double_default_required(++i + 0.1);
+    msg.set_float_default_required(++i + 0.2);
+    msg.set_int32_default_required(++i);
+    msg.set_int64_default_required(-++i);
+    msg.set_uint32_default_required(++i);
+    msg.set_uint64_default_required(++i);
+    msg.set_sint32_default_required(-++i);
+    msg.set_sint64_default_required(++i);
+    msg.set_fixed32_default_required(++i);
+    msg.set_fixed64_default_required(++i);
+    msg.set_sfixed32_default_required(++i);
+    msg.set_sfixed64_default_required(-++i);
+    msg.set_bool_default_required(true);
+    msg.set_string_default_required("abc123");
+    msg.set_bytes_default_required(dccl::hex_decode("00112233aabbcc1234"));
+    msg.set_enum_default_required(ENUM_C);
+    msg.mutable_msg_default_required()->set_val(++i + 0.3);
+    msg.mutable_msg_default_required()->mutable_msg()->set_val(++i);
+
+    std::vector<char> buffer(512);
+
+    // warm up any lazily grown internal state
+    codec.size(msg);
+    codec.encode(&buffer[0], buffer.size(), msg);
+
+    start_count();
+    std::size_t len = codec.encode(&buffer[0], buffer.size(), msg);
+    unsigned encode_allocations = stop_count();
+    std::cout << "encode(): " << encode_allocations << " allocations" << std::endl;
+
+    // every field Bitset is short enough to be stored inline, so the number of allocations does not depend on how many
+    // primitive fields are set: leaving ten of them out makes no difference
+    {
+        TestMsg sparse_msg(msg);
+        sparse_msg.clear_double_default_optional();
+        sparse_msg.clear_int32_default_optional();
+        sparse_msg.clear_int64_default_optional();
+        sparse_msg.clear_uint32_default_optional();
+        sparse_msg.clear_sint32_default_optional();
+        sparse_msg.clear_fixed64_default_optional();
+        sparse_msg.clear_bool_default_optional();
+        sparse_msg.clear_string_default_optional();
+        sparse_msg.clear_bytes_default_optional();
+        sparse_msg.clear_enum_default_optional();
+        std::vector<char> sparse_buffer(512);
+        codec.encode(&sparse_buffer[0], sparse_buffer.size(), sparse_msg);
+        start_count();
+        codec.encode(&sparse_buffer[0], sparse_buffer.size(), sparse_msg);
+        unsigned sparse_allocations = stop_count();
+        assert(sparse_allocations == encode_allocations);
+    }
+
+    // whereas a long string spills to the heap (once)
+    {
+        dccl::Bitset long_bits;
+        std::string long_string(100, 'a');
+        start_count();
+        long_bits.from_byte_string(long_string);
+        unsigned n = stop_count();
+        assert(n == 1);
+    }
+
+    TestMsg msg_out;
+    codec.decode(std::string(buffer.begin(), buffer.begin() + len), &msg_out);
+    assert(msg.SerializeAsString() == msg_out.SerializeAsString());
+
+    std::cout << "all tests passed" << std::endl;
+}
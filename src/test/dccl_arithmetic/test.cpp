@@ -21,6 +21,8 @@
 // along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
 // tests arithmetic encoder
 
+#include <thread>
+
 #include <google/protobuf/descriptor.pb.h>
 
 #include "dccl/codec.h"
@@ -67,9 +69,13 @@ void run_test(dccl::arith::protobuf::ArithmeticModel& model,
 
     
     std::cout << "Try encode..." << std::endl;
+    unsigned size = codec.size(msg_in);
     std::string bytes;
     codec.encode(&bytes, msg_in);
     std::cout << "... got bytes (hex): " << dccl::hex_encode(bytes) << std::endl;
+    // adaptive models are updated symbol by symbol while encoding, so size() is only exact for static models
+    if(!model.is_adaptive())
+        assert(size == bytes.size());
 
     std::cout << "Try decode..." << std::endl;
 
@@ -82,6 +88,27 @@ void run_test(dccl::arith::protobuf::ArithmeticModel& model,
     ++i;
 }
 
+// encodes and decodes `count` messages on one link, returning the encoded messages
+std::vector<std::string> run_link(dccl::Codec* codec, dccl::arith::ModelContext* link, int first, int count)
+{
+    std::vector<std::string> all_bytes;
+    for(int i = first; i < first + count; ++i)
+    {
+        ArithmeticDouble3TestMsg msg_in;
+        for(int j = 0; j < i % 4 + 1; ++j)
+            msg_in.add_value((i + j) % 3 == 0 ? 1 : 0);
+
+        dccl::arith::ModelContext::Scope scope(link);
+        std::string bytes;
+        codec->encode(&bytes, msg_in);
+        ArithmeticDouble3TestMsg msg_out;
+        codec->decode(bytes, &msg_out);
+        assert(msg_in.SerializeAsString() == msg_out.SerializeAsString());
+        all_bytes.push_back(bytes);
+    }
+    return all_bytes;
+}
+
 
 // usage: dccl_test10 [boolean: verbose]
 int main(int argc, char* argv[])
@@ -274,6 +301,83 @@ int main(int argc, char* argv[])
 
     }
 
+    // version 2 repeated field followed by another field (the arithmetic codec has its own repeated layout, so must be given only min_size_repeated() bits up front)
+    {        
+        dccl::arith::protobuf::ArithmeticModel model;
+        
+        model.set_eof_frequency(1);
+
+        model.add_value_bound(0);
+        model.add_frequency(1); 
+    
+        model.add_value_bound(1);
+        model.add_frequency(1); 
+    
+        model.add_value_bound(2);
+
+        model.set_out_of_range_frequency(1);
+    
+        // fewer values use fewer bits than max_repeat times min_size()
+        for(int n = 0; n <= 4; ++n)
+        {
+            ArithmeticV2TestMsg msg_in;
+            for(int j = 0; j < n; ++j)
+                msg_in.add_value(j % 2);
+            msg_in.set_after(200);
+        
+            run_test(model, msg_in);
+        }
+    }
+    
+    // adaptive models adapt separately for each link (ModelContext), so the messages of one link do not change how those of another are encoded
+    {
+        dccl::arith::protobuf::ArithmeticModel model;
+        model.set_name("model");
+        model.set_eof_frequency(1);
+        model.add_value_bound(0);
+        model.add_frequency(1); 
+        model.add_value_bound(1);
+        model.add_frequency(1); 
+        model.add_value_bound(2);
+        model.set_out_of_range_frequency(1);
+        model.set_is_adaptive(true);
+        dccl::arith::ModelManager::set_model(model);
+        codec.load<ArithmeticDouble3TestMsg>();
+
+        dccl::arith::ModelContext link_a, link_b;
+        std::vector<std::string> a_alone = run_link(&codec, &link_a, 0, 20);
+        std::vector<std::string> b_alone = run_link(&codec, &link_b, 100, 20);
+        // the model has adapted by now
+        std::vector<std::string> a_adapted = run_link(&codec, &link_a, 0, 20);
+        assert(a_alone != a_adapted);
+
+        // interleaved
+        link_a.reset();
+        link_b.reset();
+        for(int i = 0; i < 20; ++i)
+        {
+            std::vector<std::string> a_bytes = run_link(&codec, &link_a, i, 1);
+            std::vector<std::string> b_bytes = run_link(&codec, &link_b, 100 + i, 1);
+            assert(a_bytes.front() == a_alone[i]);
+            assert(b_bytes.front() == b_alone[i]);
+        }
+
+        // concurrently
+        link_a.reset();
+        link_b.reset();
+        std::vector<std::string> a_threaded, b_threaded;
+        std::thread thread_a([&]() { a_threaded = run_link(&codec, &link_a, 0, 20); });
+        std::thread thread_b([&]() { b_threaded = run_link(&codec, &link_b, 100, 20); });
+        thread_a.join();
+        thread_b.join();
+        assert(a_threaded == a_alone);
+        assert(b_threaded == b_alone);
+
+        // a new model replaces any adaptation
+        dccl::arith::ModelManager::set_model(model);
+        std::vector<std::string> a_reset = run_link(&codec, &link_a, 0, 20);
+        assert(a_reset == a_alone);
+    }
     
     // test case from Arithmetic Coding revealed: A guided tour from theory to praxis Sable Technical Report No. 2007-5 Eric Bodden
 
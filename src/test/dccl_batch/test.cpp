@@ -0,0 +1,185 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests encoding and decoding batches of messages on several threads, and prints how well this scales
+
+#include <cassert>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "dccl/codec.h"
+#include "test.pb.h"
+using namespace dccl::test;
+
+boost::shared_ptr<google::protobuf::Message> make_message(int i)
+{
+    if(i % 3)
+    {
+        boost::shared_ptr<Position> msg(new Position);
+        msg->set_time(1500000000 + i);
+        msg->set_vehicle(i % 256);
+        msg->set_lat(-90 + (i % 180000) * 1e-3);
+        msg->set_lon(-180 + (i % 360000) * 1e-3);
+        return msg;
+    }
+    else
+    {
+        boost::shared_ptr<Status> msg(new Status);
+        msg->set_vehicle(i % 256);
+        for(int j = 0, n = i % 33; j < n; ++j)
+            msg->add_sensor((i + j) % 4096);
+        if(i % 2)
+            msg->set_note("status " + boost::lexical_cast<std::string>(i));
+        return msg;
+    }
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::Codec codec;
+    codec.load<Position>();
+    codec.load<Status>();
+
+    std::vector<boost::shared_ptr<google::protobuf::Message> > originals;
+    std::vector<const google::protobuf::Message*> msgs;
+    for(int i = 0; i < 3000; ++i)
+    {
+        originals.push_back(make_message(i));
+        msgs.push_back(originals.back().get());
+    }
+    
+    // batches give the same bytes, in the same order, as encoding one at a time
+    std::vector<std::string> bytes, errors;
+    std::size_t failed = codec.encode_batch(msgs, &bytes, 4, &errors);
+    assert(failed == 0);
+    assert(bytes.size() == msgs.size() && errors.size() == msgs.size());
+    for(int i = 0, n = msgs.size(); i < n; ++i)
+    {
+        std::string expected;
+        codec.encode(&expected, *msgs[i]);
+        assert(bytes[i] == expected);
+        assert(errors[i].empty());
+    }
+
+    std::vector<boost::shared_ptr<google::protobuf::Message> > decoded;
+    failed = codec.decode_batch(bytes, &decoded, 4, &errors);
+    assert(failed == 0);
+    assert(decoded.size() == bytes.size());
+    // the decoded values are rounded, so compare with decoding one at a time
+    std::vector<std::string> expected;
+    for(int i = 0, n = bytes.size(); i < n; ++i)
+    {
+        expected.push_back(codec.decode<boost::shared_ptr<google::protobuf::Message> >(bytes[i])->SerializeAsString());
+        assert(decoded[i]->SerializeAsString() == expected[i]);
+    }
+
+    // a bad message only fails itself
+    std::vector<std::string> bad_bytes(bytes.begin(), bytes.begin() + 10);
+    bad_bytes[3] = ""; // no id
+    bad_bytes[7] = std::string(1, static_cast<char>(125 << 1)); // id 125 is not loaded
+    failed = codec.decode_batch(bad_bytes, &decoded, 2, &errors);
+    assert(failed == 2);
+    for(int i = 0; i < 10; ++i)
+    {
+        if(i == 3 || i == 7)
+        {
+            assert(!decoded[i]);
+            assert(!errors[i].empty());
+        }
+        else
+        {
+            assert(decoded[i]->SerializeAsString() == expected[i]);
+            assert(errors[i].empty());
+        }
+    }
+    
+    Position invalid;
+    invalid.set_vehicle(1); // missing required fields
+    std::vector<const google::protobuf::Message*> bad_msgs(msgs.begin(), msgs.begin() + 10);
+    bad_msgs[5] = &invalid;
+    failed = codec.encode_batch(bad_msgs, &bytes, 3, &errors);
+    assert(failed == 1);
+    for(int i = 0; i < 10; ++i)
+    {
+        assert(bytes[i].empty() == (i == 5));
+        assert(errors[i].empty() == (i != 5));
+    }
+    
+    // without errors
+    failed = codec.encode_batch(msgs, &bytes);
+    assert(failed == 0);
+    failed = codec.decode_batch(bytes, &decoded);
+    assert(failed == 0);
+
+    // batches started at once from several threads (all but one of which run without the pool's threads)
+    {
+        std::vector<std::vector<std::string> > results(3);
+        std::vector<std::size_t> failures(results.size());
+        std::vector<std::thread> callers;
+        for(int t = 0, n = results.size(); t < n; ++t)
+            callers.push_back(std::thread([&, t]() { failures[t] = codec.encode_batch(msgs, &results[t], 4); }));
+        for(int t = 0, n = callers.size(); t < n; ++t)
+        {
+            callers[t].join();
+            assert(failures[t] == 0);
+            assert(results[t] == bytes);
+        }
+    }
+
+    // empty batches
+    failed = codec.encode_batch(std::vector<const google::protobuf::Message*>(), &bytes, 4, &errors);
+    assert(failed == 0);
+    assert(bytes.empty() && errors.empty());
+    
+    // how well decoding scales with the number of threads (not checked, as this depends on the machine)
+    for(int i = 3000; i < 30000; ++i)
+    {
+        originals.push_back(make_message(i));
+        msgs.push_back(originals.back().get());
+    }
+    codec.encode_batch(msgs, &bytes);
+
+    // at least up to 4 threads, so the work stealing is exercised on small machines too
+    unsigned max_threads = std::max(4u, std::thread::hardware_concurrency());
+    double single_thread = 0;
+    std::cout << "decoding " << bytes.size() << " messages:" << std::endl;
+    for(unsigned num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        failed = codec.decode_batch(bytes, &decoded, num_threads);
+        double elapsed = seconds_since(start);
+        assert(failed == 0);
+        if(num_threads == 1) single_thread = elapsed;
+        
+        std::cout << std::setw(4) << num_threads << " thread(s): "
+                  << std::setw(9) << static_cast<long>(bytes.size() / elapsed) << " messages/s, speedup "
+                  << std::setprecision(2) << std::fixed << single_thread / elapsed << std::endl;
+    }
+    
+    std::cout << "all tests passed" << std::endl;
+}
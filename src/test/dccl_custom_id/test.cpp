@@ -109,6 +109,9 @@ int main(int argc, char* argv[])
         codec.encode(&encoded, mini_owtt_in);
         std::cout << "OWTT as hex: " << dccl::hex_encode(encoded) << std::endl;
         
+        // not the default id codec, so decoded by the id codec
+        assert(codec.peek_id(encoded.data(), encoded.size()) == codec.id<MiniOWTT>());
+        
         codec.decode(encoded, &mini_owtt_out);
         assert(mini_owtt_out.SerializeAsString() == mini_owtt_in.SerializeAsString());
         
@@ -121,6 +124,27 @@ int main(int argc, char* argv[])
         codec.encode(&encoded, mini_abort_in);
         codec.decode(encoded, &mini_abort_out);
         assert(mini_abort_out.SerializeAsString() == mini_abort_in.SerializeAsString());
+
+        // ids outside the dense id table: decode without knowing the type, unload and reload
+        boost::shared_ptr<google::protobuf::Message> decoded =
+            codec.decode<boost::shared_ptr<google::protobuf::Message> >(encoded);
+        assert(decoded->GetDescriptor() == MiniAbort::descriptor());
+        assert(decoded->SerializeAsString() == mini_abort_in.SerializeAsString());
+
+        codec.unload<MiniAbort>();
+        try
+        {
+            codec.decode(encoded, &mini_abort_out);
+            assert(false);
+        }
+        catch(dccl::Exception& e)
+        {
+            // expected: no longer loaded
+        }
+        codec.load<MiniAbort>();
+        mini_abort_out.Clear();
+        codec.decode(encoded, &mini_abort_out);
+        assert(mini_abort_out.SerializeAsString() == mini_abort_in.SerializeAsString());
     }
 
     std::cout << "all tests passed" << std::endl;
@@ -0,0 +1,129 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests decoding single fields of an encoded message with Codec::decode_field()
+
+#include <cassert>
+
+#include "dccl/codec.h"
+#include "test.pb.h"
+using namespace dccl::test;
+
+template<typename T>
+void check_throws(dccl::Codec& codec, const std::string& bytes, const std::string& field_name)
+{
+    try
+    {
+        codec.decode_field<T>(bytes, field_name);
+        assert(false);
+    }
+    catch(dccl::Exception& e)
+    {
+        std::cout << "expected exception: " << e.what() << std::endl;
+    }
+}
+
+void check_fixed_status(dccl::Codec& codec)
+{
+    FixedStatus msg_in;
+    msg_in.set_time(3600);
+    msg_in.set_vehicle(12);
+    msg_in.set_depth(123.45);
+    msg_in.set_mode(MODE_SURVEY);
+    msg_in.set_survey_complete(true);
+    msg_in.mutable_target()->set_value(200.1);
+    msg_in.set_battery(87);
+
+    std::string bytes;
+    codec.encode(&bytes, msg_in);
+
+    FixedStatus msg_out;
+    codec.decode(bytes, &msg_out);
+
+    assert(codec.decode_field<dccl::uint32>(bytes, "time") == msg_out.time());
+    assert(codec.decode_field<dccl::int32>(bytes, "vehicle") == msg_out.vehicle());
+    assert(codec.decode_field<double>(bytes, "depth") == msg_out.depth());
+    // not set: default value
+    assert(codec.decode_field<double>(bytes, "heading") == 90);
+    assert(codec.decode_field<const google::protobuf::EnumValueDescriptor*>(bytes, "mode")->number() == MODE_SURVEY);
+    assert(codec.decode_field<bool>(bytes, "survey_complete") == true);
+    assert(codec.decode_field<float>(bytes, "battery") == msg_out.battery());
+    
+    // wrong type
+    check_throws<float>(codec, bytes, "depth");
+    // message field
+    check_throws<double>(codec, bytes, "target");
+    // no such field
+    check_throws<double>(codec, bytes, "altitude");
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::dlog.connect(dccl::logger::ALL, &std::cerr);
+    
+    {
+        dccl::Codec codec;
+        codec.load<FixedStatus>();
+        codec.load<VariableStatus>();
+        check_fixed_status(codec);
+
+        VariableStatus msg_in;
+        msg_in.set_depth(30.2);
+        msg_in.set_note("hello");
+        msg_in.set_speed(1.5);
+        msg_in.add_history(3);
+
+        std::string bytes;
+        codec.encode(&bytes, msg_in);
+
+        // before the variable size field
+        assert(codec.decode_field<double>(bytes, "depth") == 30.2);
+        // at or after the variable size field
+        check_throws<std::string>(codec, bytes, "note");
+        check_throws<double>(codec, bytes, "speed");
+        // repeated
+        check_throws<dccl::int32>(codec, bytes, "history");
+
+        // not loaded
+        codec.unload<FixedStatus>();
+        FixedStatus msg;
+        msg.set_time(0);
+        msg.set_depth(0);
+        msg.set_mode(MODE_IDLE);
+        msg.set_survey_complete(false);
+        msg.mutable_target()->set_value(0);
+        dccl::Codec other_codec;
+        other_codec.load<FixedStatus>();
+        std::string unloaded_bytes;
+        other_codec.encode(&unloaded_bytes, msg);
+        check_throws<double>(codec, unloaded_bytes, "depth");
+    }
+
+    // encrypted body
+    {
+        dccl::Codec codec;
+        codec.set_crypto_passphrase("my_passphrase!");
+        codec.load<FixedStatus>();
+        check_fixed_status(codec);
+    }
+    
+    std::cout << "all tests passed" << std::endl;
+}
@@ -53,7 +53,17 @@ int main(int argc, char* argv[])
         assert(codec.size(long_id_msg) == 2);
         codec.encode(&encoded, long_id_msg);
         assert(codec.id(encoded) == 10000);
+        assert(codec.peek_id(encoded.data(), encoded.size()) == 10000);
         codec.decode(encoded, &long_id_msg);
+
+        // long form id needs both bytes
+        try
+        {
+            codec.peek_id(encoded.data(), 1);
+            assert(false);
+        }
+        catch(dccl::Exception& e)
+        { }
     }
     
     {
@@ -64,6 +74,7 @@ int main(int argc, char* argv[])
         assert(codec.size(short_id_edge_msg) == 1);
         codec.encode(&encoded, short_id_edge_msg);
         assert(codec.id(encoded) == 127);
+        assert(codec.peek_id(encoded.data(), encoded.size()) == 127);
         codec.decode(encoded, &short_id_edge_msg);
     }
     
@@ -74,6 +85,7 @@ int main(int argc, char* argv[])
         codec.info(long_id_edge_msg.GetDescriptor(), &dccl::dlog);
         codec.encode(&encoded, long_id_edge_msg);
         assert(codec.id(encoded) == 128);
+        assert(codec.peek_id(encoded.data(), encoded.size()) == 128);
         codec.decode(encoded, &long_id_edge_msg);
         assert(codec.size(long_id_edge_msg) == 2);
     }
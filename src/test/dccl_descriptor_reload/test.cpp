@@ -0,0 +1,153 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests that a message whose descriptor pool has been rebuilt with different options is encoded with the new options (its new descriptors may be at the addresses of the destroyed ones)
+
+#include <cassert>
+
+#include <google/protobuf/descriptor_database.h>
+
+#include "dccl/codec.h"
+#include "dccl/field_codec_fixed.h"
+
+namespace dccl
+{
+    namespace test
+    {
+        class Fixed32Codec : public dccl::TypedFixedFieldCodec<dccl::int32>
+        {
+          private:
+            unsigned size() { return 32; }
+            Bitset encode() { return Bitset(size()); }
+            Bitset encode(const dccl::int32& wire_value)
+            { return Bitset(size(), static_cast<unsigned long>(wire_value)); }
+            dccl::int32 decode(Bitset* bits)
+            { return bits->to_ulong(); }
+            void validate() { }
+        };
+        
+        // passes lookups on to one of several databases, so the same file can be given different contents
+        class SwitchableDatabase : public google::protobuf::DescriptorDatabase
+        {
+          public:
+            SwitchableDatabase() : current_(0) { }
+            void set(google::protobuf::DescriptorDatabase* database)
+            { current_ = database; }
+            
+            bool FindFileByName(const std::string& filename,
+                                google::protobuf::FileDescriptorProto* output)
+            { return current_->FindFileByName(filename, output); }
+            bool FindFileContainingSymbol(const std::string& symbol_name,
+                                          google::protobuf::FileDescriptorProto* output)
+            { return current_->FindFileContainingSymbol(symbol_name, output); }
+            bool FindFileContainingExtension(const std::string& containing_type,
+                                             int field_number,
+                                             google::protobuf::FileDescriptorProto* output)
+            { return current_->FindFileContainingExtension(containing_type, field_number, output); }
+          private:
+            google::protobuf::DescriptorDatabase* current_;
+        };
+    }
+}
+
+using namespace dccl::test;
+
+// dccl.test.Reload, with `value` bounded by [0, max] and using `codec` (if given)
+google::protobuf::FileDescriptorProto make_file(int max, const std::string& codec)
+{
+    google::protobuf::FileDescriptorProto file;
+    file.set_name("dccl/test/dccl_descriptor_reload/reload.proto");
+    file.set_package("dccl.test");
+    file.add_dependency(dccl::DCCLFieldOptions::descriptor()->file()->name());
+
+    google::protobuf::DescriptorProto* msg = file.add_message_type();
+    msg->set_name("Reload");
+    dccl::DCCLMessageOptions* msg_options = msg->mutable_options()->MutableExtension(dccl::msg);
+    msg_options->set_id(10);
+    msg_options->set_max_bytes(32);
+    msg_options->set_codec_version(3);
+
+    google::protobuf::FieldDescriptorProto* field = msg->add_field();
+    field->set_name("value");
+    field->set_number(1);
+    field->set_label(google::protobuf::FieldDescriptorProto::LABEL_REQUIRED);
+    field->set_type(google::protobuf::FieldDescriptorProto::TYPE_INT32);
+    dccl::DCCLFieldOptions* field_options = field->mutable_options()->MutableExtension(dccl::field);
+    field_options->set_min(0);
+    field_options->set_max(max);
+    if(!codec.empty())
+        field_options->set_codec(codec);
+    return file;
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::FieldCodecManager::add<Fixed32Codec>("test.fixed32");
+    
+    // id (8 bits) + value (7 bits)
+    google::protobuf::SimpleDescriptorDatabase small;
+    small.Add(make_file(100, ""));
+    const unsigned small_size = 2;
+    // id (8 bits) + value (32 bits)
+    google::protobuf::SimpleDescriptorDatabase large;
+    large.Add(make_file(1000, "test.fixed32"));
+    const unsigned large_size = 5;
+    
+    SwitchableDatabase database;
+    database.set(&small);
+    dccl::DynamicProtobufManager::add_database(&database);
+
+    // adding a database is what rebuilds the pool
+    google::protobuf::SimpleDescriptorDatabase empty;
+    
+    dccl::Codec codec;
+    for(int i = 0; i < 20; ++i)
+    {
+        bool use_large = i % 2;
+        
+        const google::protobuf::Descriptor* desc = dccl::DynamicProtobufManager::find_descriptor("dccl.test.Reload");
+        assert(desc);
+        codec.load(desc);
+        
+        boost::shared_ptr<google::protobuf::Message> msg = dccl::DynamicProtobufManager::new_protobuf_message(desc);
+        msg->GetReflection()->SetInt32(msg.get(), desc->FindFieldByName("value"), 50);
+
+        unsigned size = codec.size(*msg);
+        assert(size == (use_large ? large_size : small_size));
+        
+        std::string bytes;
+        codec.encode(&bytes, *msg);
+        assert(bytes.size() == size);
+
+        boost::shared_ptr<google::protobuf::Message> decoded = codec.decode<boost::shared_ptr<google::protobuf::Message> >(bytes);
+        assert(decoded->SerializeAsString() == msg->SerializeAsString());
+
+        // the messages must not outlive their descriptors
+        msg.reset();
+        decoded.reset();
+        codec.unload(desc);
+        
+        database.set(use_large ? &small : &large);
+        dccl::DynamicProtobufManager::add_database(&empty);
+    }
+    
+    std::cout << "all tests passed" << std::endl;
+}
@@ -0,0 +1,159 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests decoding only some of the fields of a message (with a dccl::FieldMask)
+
+#include <cassert>
+
+#include "dccl/codec.h"
+#include "test.pb.h"
+using namespace dccl::test;
+
+Report full_report()
+{
+    Report msg;
+    msg.set_source(3);
+    msg.set_destination(17);
+    msg.set_note("hello world");
+    msg.add_counts(10);
+    msg.add_counts(999);
+    msg.mutable_position()->set_lat(41.5);
+    msg.mutable_position()->set_lon(-70.25);
+    msg.mutable_position()->set_label("home");
+    Position* wp = msg.add_waypoints();
+    wp->set_lat(1);
+    wp->set_lon(2);
+    wp = msg.add_waypoints();
+    wp->set_lat(-3);
+    wp->set_lon(-4);
+    wp->set_label("two");
+    msg.set_data("\x01\x02\x03\x04");
+    msg.add_tags("a");
+    msg.add_tags("bcdef");
+    msg.set_depth(123.4);
+    return msg;
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::dlog.connect(dccl::logger::ALL, &std::cerr);
+    
+    dccl::Codec codec;
+    codec.load<Report>();
+    codec.load<ReportV2>();
+
+    Report report_in = full_report();
+    std::string bytes;
+    codec.encode(&bytes, report_in);
+
+    Report full;
+    codec.decode(bytes, &full);
+    assert(full.SerializeAsString() == report_in.SerializeAsString());
+    
+    // a field after all the variable size fields
+    {
+        Report msg;
+        codec.decode(bytes, &msg, dccl::FieldMask().add_path("depth"));
+        Report expected;
+        expected.set_depth(full.depth());
+        assert(msg.SerializePartialAsString() == expected.SerializePartialAsString());
+    }
+    
+    // header fields, part of an embedded message, and repeated fields
+    {
+        Report msg;
+        codec.decode(bytes, &msg, dccl::FieldMask().add_path("destination").add_path("position.lon").add_path("waypoints.label").add_path("tags"));
+        Report expected;
+        expected.set_destination(full.destination());
+        expected.mutable_position()->set_lon(full.position().lon());
+        // the first waypoint has no label, so it is decoded empty
+        expected.add_waypoints();
+        expected.add_waypoints()->set_label("two");
+        expected.mutable_tags()->CopyFrom(full.tags());
+        assert(msg.SerializePartialAsString() == expected.SerializePartialAsString());
+    }
+    
+    // an entire embedded message; fields that are not set
+    {
+        Report sparse;
+        sparse.set_source(1);
+        sparse.set_destination(2);
+        sparse.set_depth(5);
+        std::string sparse_bytes;
+        codec.encode(&sparse_bytes, sparse);
+
+        Report msg;
+        codec.decode(sparse_bytes, &msg, dccl::FieldMask().add_path("position").add_path("note").add_path("depth"));
+        Report expected;
+        expected.set_depth(5);
+        assert(msg.SerializePartialAsString() == expected.SerializePartialAsString());
+
+        codec.decode(bytes, &msg, dccl::FieldMask().add_path("position").add_path("data"));
+        expected.Clear();
+        expected.mutable_position()->CopyFrom(full.position());
+        expected.set_data(full.data());
+        expected.set_depth(5); // decode merges
+        assert(msg.SerializePartialAsString() == expected.SerializePartialAsString());
+    }
+
+    // empty mask: nothing is decoded
+    {
+        Report msg;
+        codec.decode(bytes, &msg, dccl::FieldMask());
+        assert(msg.SerializePartialAsString().empty());
+    }
+
+    // copies of masks do not share changes
+    {
+        dccl::FieldMask a;
+        a.add_path("position.lat");
+        dccl::FieldMask b(a);
+        b.add_path("position.lon");
+        assert(a.find("position")->find("lon") == 0);
+        assert(b.find("position")->find("lon") != 0);
+        b.add_path("position");
+        assert(b.find("position")->all());
+        assert(!a.find("position")->all());
+    }
+
+    // DCCL2 message
+    {
+        ReportV2 v2_in;
+        v2_in.set_note("v2 note");
+        v2_in.set_data("abcd");
+        v2_in.mutable_position()->set_lat(10);
+        v2_in.mutable_position()->set_lon(20);
+        v2_in.add_counts(7);
+        v2_in.set_depth(42);
+        std::string v2_bytes;
+        codec.encode(&v2_bytes, v2_in);
+
+        ReportV2 full_v2, msg;
+        codec.decode(v2_bytes, &full_v2);
+        codec.decode(v2_bytes, &msg, dccl::FieldMask().add_path("depth").add_path("position.lon"));
+        ReportV2 expected;
+        expected.mutable_position()->set_lon(full_v2.position().lon());
+        expected.set_depth(full_v2.depth());
+        assert(msg.SerializePartialAsString() == expected.SerializePartialAsString());
+    }
+    
+    std::cout << "all tests passed" << std::endl;
+}
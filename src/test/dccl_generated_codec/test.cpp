@@ -0,0 +1,198 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests that a generated codec (written into test.pb.cc by protoc-gen-dccl) is used in place of the default codecs and is wire compatible with them
+
+#include <cassert>
+#include <cstdlib>
+
+#include <google/protobuf/dynamic_message.h>
+
+#include "dccl/codec.h"
+#include "dccl/binary.h"
+#include "test.pb.h"
+using namespace dccl::test;
+
+std::vector<Status> test_messages()
+{
+    std::vector<Status> msgs;
+
+    // all fields set
+    {
+        Status msg;
+        msg.set_time(1476624000);
+        msg.set_vehicle(12);
+        msg.mutable_position()->set_lat(41.523456);
+        msg.mutable_position()->set_lon(-70.671234);
+        msg.mutable_position()->set_depth(25.5);
+        msg.mutable_position()->mutable_fix()->set_satellites(9);
+        msg.mutable_position()->mutable_fix()->set_differential(true);
+        msg.mutable_waypoint()->set_lat(-41.5);
+        msg.mutable_waypoint()->set_lon(170.25);
+        msg.set_mode(MODE_TRANSIT);
+        msg.set_previous_mode(MODE_ABORT);
+        msg.add_mode_history(MODE_IDLE);
+        msg.add_mode_history(MODE_SURVEY);
+        msg.add_mode_history(MODE_ABORT);
+        msg.set_payload_on(false);
+        msg.add_thrusters_ok(true);
+        msg.add_thrusters_ok(false);
+        msg.set_altitude(-1230);
+        msg.add_temperature(12.34);
+        msg.add_temperature(-4.99);
+        msg.add_counts(1000);
+        msgs.push_back(msg);
+    }
+
+    // only required fields
+    {
+        Status msg;
+        msg.set_time(0);
+        msg.mutable_position()->set_lat(0);
+        msg.mutable_position()->set_lon(0);
+        msg.set_mode(MODE_IDLE);
+        msgs.push_back(msg);
+    }
+
+    // out of range values, more than max_repeat values and omitted fields
+    {
+        Status msg;
+        msg.set_time(10);
+        msg.set_vehicle(31);
+        msg.mutable_position()->set_lat(95);
+        msg.mutable_position()->set_lon(-180);
+        msg.mutable_position()->set_depth(-1);
+        msg.mutable_position()->mutable_fix()->set_satellites(32);
+        msg.mutable_position()->mutable_fix()->set_differential(false);
+        msg.set_mode(MODE_SURVEY);
+        for(int i = 0; i < 6; ++i)
+        {
+            msg.add_mode_history(MODE_TRANSIT);
+            msg.add_thrusters_ok(i % 2);
+            msg.add_temperature(i * 10);
+            msg.add_counts(i * 300);
+        }
+        msg.set_altitude(10001);
+        msg.set_not_sent(4);
+        msgs.push_back(msg);
+    }
+
+    return msgs;
+}
+
+struct Encoded
+{
+    std::string bytes;
+    unsigned size;
+    std::string decoded;
+};
+
+Encoded encode(dccl::Codec& codec, const Status& msg)
+{
+    Encoded encoded;
+    codec.encode(&encoded.bytes, msg);
+    encoded.size = codec.size(msg);
+    assert(encoded.size == encoded.bytes.size());
+
+    Status msg_out;
+    codec.decode(encoded.bytes, &msg_out);
+    std::cout << msg_out.ShortDebugString() << std::endl;
+    encoded.decoded = msg_out.SerializeAsString();
+    return encoded;
+}
+
+// the decoded message, or the exception thrown
+std::string decode(dccl::Codec& codec, const std::string& bytes)
+{
+    try
+    {
+        Status msg_out;
+        codec.decode(bytes, &msg_out);
+        return msg_out.SerializeAsString();
+    }
+    catch(dccl::Exception& e)
+    {
+        return e.what();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::dlog.connect(dccl::logger::ALL, &std::cerr);
+
+    std::vector<Status> msgs = test_messages();
+    
+    dccl::Codec codec;
+    codec.load<Status>();
+    assert(codec.uses_generated_codec(Status::descriptor()));
+    codec.info<Status>();
+
+    std::vector<Encoded> generated;
+    for(std::vector<Status>::const_iterator it = msgs.begin(), end = msgs.end(); it != end; ++it)
+        generated.push_back(encode(codec, *it));
+
+    std::vector<std::string> junk;
+    for(unsigned i = 0; i < 100; ++i)
+    {
+        std::string random = generated[i % generated.size()].bytes;
+        random[(rand() % (random.size()-1)+1)] = rand() % 256;
+        junk.push_back(random);
+    }
+    
+    // messages loaded from now on use the default codecs
+    dccl::Codec::remove_generated_codec("dccl.test.Status");
+    dccl::Codec reference_codec;
+    reference_codec.load<Status>();
+    assert(!reference_codec.uses_generated_codec(Status::descriptor()));
+    assert(codec.uses_generated_codec(Status::descriptor()));
+
+    for(std::vector<Status>::size_type i = 0, n = msgs.size(); i < n; ++i)
+    {
+        Encoded reference = encode(reference_codec, msgs[i]);
+        assert(reference.bytes == generated[i].bytes);
+        assert(reference.size == generated[i].size);
+        assert(reference.decoded == generated[i].decoded);
+    }
+
+    for(std::vector<std::string>::const_iterator it = junk.begin(), end = junk.end(); it != end; ++it)
+        assert(decode(reference_codec, *it) == decode(codec, *it));
+    
+    // messages that aren't of the generated type (e.g. DynamicMessage) use the default codecs
+    {
+        google::protobuf::DynamicMessageFactory factory;
+        boost::shared_ptr<google::protobuf::Message> dynamic_msg(factory.GetPrototype(Status::descriptor())->New());
+        dynamic_msg->ParseFromString(msgs[0].SerializeAsString());
+
+        std::string bytes;
+        codec.encode(&bytes, *dynamic_msg);
+        assert(bytes == generated[0].bytes);
+
+        dynamic_msg->Clear();
+        codec.decode(bytes, dynamic_msg.get());
+        assert(dynamic_msg->SerializeAsString() == generated[0].decoded);
+    }
+
+    // the generated codec is no longer used once reloaded
+    codec.load<Status>();
+    assert(!codec.uses_generated_codec(Status::descriptor()));
+    
+    std::cout << "all tests passed" << std::endl;
+}
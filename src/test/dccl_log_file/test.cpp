@@ -0,0 +1,213 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests writing and reading indexed log files
+
+#include <atomic>
+#include <cassert>
+#include <fstream>
+#include <iterator>
+
+#include <unistd.h>
+
+#include "dccl/log_file.h"
+#include "test.pb.h"
+using namespace dccl::test;
+
+typedef boost::shared_ptr<google::protobuf::Message> MessagePtr;
+
+const int NUM_MESSAGES = 10000;
+const dccl::int64 START_TIME = 1476600000000000LL;
+
+MessagePtr make_message(int i)
+{
+    if(i % 3)
+    {
+        boost::shared_ptr<Status> msg(new Status);
+        msg->set_a(i);
+        return msg;
+    }
+    else
+    {
+        boost::shared_ptr<Report> msg(new Report);
+        msg->set_a(i);
+        msg->set_s(std::string(i % 40 + 1, 'x'));
+        return msg;
+    }
+}
+
+dccl::int64 message_time(int i)
+{ return START_TIME + i * 1000; }
+
+std::string read_file(const std::string& path)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string& path, const std::string& contents)
+{
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(contents.data(), contents.size());
+}
+
+// checks that the first `n` messages in `log` are the first `n` of `msgs`
+void check_log(dccl::Codec* codec, const dccl::LogReader& log, const std::vector<MessagePtr>& msgs, std::size_t n)
+{
+    assert(log.size() == n);
+    for(std::size_t i = 0; i < n; ++i)
+    {
+        assert(log.entry(i).time == message_time(i));
+        assert(log.entry(i).id == codec->id(msgs[i]->GetDescriptor()));
+        MessagePtr msg = codec->decode<MessagePtr>(log.bytes(i));
+        assert(msg->SerializeAsString() == msgs[i]->SerializeAsString());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::Codec codec;
+    codec.load<Status>();
+    codec.load<Report>();
+
+    std::string path = "dccl_test_log_file_" + std::to_string(getpid()) + ".dccllog";
+    std::string unclosed_path = path + ".unclosed";
+    
+    std::vector<MessagePtr> msgs;
+    {
+        dccl::LogWriter writer(path);
+        for(int i = 0; i < NUM_MESSAGES; ++i)
+        {
+            msgs.push_back(make_message(i));
+            writer.write(&codec, *msgs.back(), message_time(i));
+        }
+        // a copy without the index
+        writer.flush();
+        write_file(unclosed_path, read_file(path));
+    }
+
+    {
+        dccl::LogReader log(path);
+        check_log(&codec, log, msgs, NUM_MESSAGES);
+        
+        // seek by time
+        assert(log.find_time(0) == 0);
+        assert(log.find_time(message_time(1234)) == 1234);
+        assert(log.find_time(message_time(1234) - 1) == 1234);
+        assert(log.find_time(message_time(NUM_MESSAGES)) == log.size());
+        
+        // seek by id
+        assert(log.find_id(codec.id<Report>()) == 0);
+        assert(log.find_id(codec.id<Status>()) == 1);
+        assert(log.find_id(codec.id<Report>(), 1) == 3);
+        assert(log.find_id(codec.id<Report>(), log.find_time(message_time(1000))) == 1002);
+        assert(log.find_id(12345) == log.size());
+        
+        std::size_t num_reports = 0;
+        for(std::size_t i = log.find_id(codec.id<Report>()); i < log.size(); i = log.find_id(codec.id<Report>(), i + 1))
+            ++num_reports;
+        assert(num_reports == (NUM_MESSAGES + 2) / 3);
+
+        // decode everything in parallel
+        std::vector<std::string> decoded(log.size());
+        std::atomic<int> count(0);
+        log.scan([&](std::size_t i)
+                 {
+                     decoded[i] = codec.decode<MessagePtr>(log.bytes(i))->SerializeAsString();
+                     ++count;
+                 }, 4);
+        assert(count == NUM_MESSAGES);
+        for(int i = 0; i < NUM_MESSAGES; ++i)
+            assert(decoded[i] == msgs[i]->SerializeAsString());
+
+        // part of the log
+        count = 0;
+        log.scan([&](std::size_t i) { assert(i >= 100 && i < 200); ++count; }, 2, 100, 200);
+        assert(count == 100);
+    }
+
+    // without the index (never closed)
+    {
+        dccl::LogReader log(unclosed_path);
+        check_log(&codec, log, msgs, NUM_MESSAGES);
+    }
+    
+    // with an index entry count so large that its size overflows: the index is recovered from the messages instead
+    {
+        std::string closed = read_file(path);
+        std::string corrupt = read_file(unclosed_path);
+        // trailer: [index offset (no entries follow)][count][magic]
+        unsigned long long index_offset = corrupt.size(), count = 1ull << 61;
+        for(int i = 0; i < 8; ++i)
+            corrupt.push_back(static_cast<char>((index_offset >> (8 * i)) & 0xFF));
+        for(int i = 0; i < 8; ++i)
+            corrupt.push_back(static_cast<char>((count >> (8 * i)) & 0xFF));
+        corrupt.append(closed.substr(closed.size() - 8));
+
+        std::string corrupt_path = path + ".corrupt";
+        write_file(corrupt_path, corrupt);
+        {
+            dccl::LogReader log(corrupt_path);
+            check_log(&codec, log, msgs, NUM_MESSAGES);
+        }
+        unlink(corrupt_path.c_str());
+    }
+    
+    // with a partly written last message
+    {
+        std::string unclosed = read_file(unclosed_path);
+        write_file(unclosed_path, unclosed.substr(0, unclosed.size() - 1));
+        dccl::LogReader log(unclosed_path);
+        check_log(&codec, log, msgs, NUM_MESSAGES - 1);
+    }
+
+    // times out of order
+    {
+        dccl::LogWriter writer(unclosed_path);
+        writer.write(&codec, *msgs[0], 30);
+        writer.write(&codec, *msgs[1], 10);
+        writer.write(&codec, *msgs[2], 20);
+        writer.close();
+
+        dccl::LogReader log(unclosed_path);
+        assert(log.size() == 3);
+        assert(log.find_time(15) == 0);
+        assert(log.find_time(25) == 0);
+        assert(log.find_time(31) == 3);
+    }
+
+    // not a log file
+    {
+        write_file(unclosed_path, "not a log");
+        try
+        {
+            dccl::LogReader log(unclosed_path);
+            assert(false);
+        }
+        catch(dccl::Exception& e)
+        { }
+    }
+    
+    unlink(path.c_str());
+    unlink(unclosed_path.c_str());
+    
+    std::cout << "all tests passed" << std::endl;
+}
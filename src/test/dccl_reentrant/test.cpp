@@ -0,0 +1,186 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests encoding and decoding from within a field codec (which itself uses a Codec), and from several threads at once (while codecs are being added and removed)
+
+#include <atomic>
+#include <cassert>
+#include <thread>
+
+#include "dccl/codec.h"
+#include "dccl/field_codec_fixed.h"
+#include "test.pb.h"
+using namespace dccl::test;
+
+dccl::Codec* inner_codec = 0;
+
+namespace dccl
+{
+    namespace test
+    {
+        // checks that the state of the outer call survives a nested call to inner_codec
+        class ReentrantCodec : public dccl::TypedFixedFieldCodec<dccl::int32>
+        {
+          private:
+            unsigned size() { return 10; }
+            Bitset encode() { return Bitset(size()); }
+            Bitset encode(const dccl::int32& wire_value)
+            {
+                round_trip(wire_value);
+                return Bitset(size(), static_cast<unsigned long>(wire_value));
+            }
+            
+            dccl::int32 decode(Bitset* bits)
+            {
+                dccl::int32 value = bits->to_ulong();
+                round_trip(value);
+                return value;
+            }
+            
+            void validate() { }
+
+            void round_trip(dccl::int32 value)
+            {
+                MessagePart outer_part = part();
+                
+                Inner inner;
+                inner.set_x(value);
+                std::string bytes;
+                inner_codec->encode(&bytes, inner);
+                Inner inner_out;
+                inner_codec->decode(bytes, &inner_out);
+                assert(inner_out.x() == value);
+
+                assert(this_field() && this_field()->name() == "nested");
+                assert(this_descriptor() == Outer::descriptor());
+                assert(root_descriptor() == Outer::descriptor());
+                assert(part() == outer_part);
+            }
+        };
+    }
+}
+
+Outer make_outer(int i)
+{
+    Outer msg;
+    msg.set_a(i % 100);
+    msg.set_nested(i % 1000);
+    msg.set_b((i % 200) - 100);
+    for(int j = 0, n = i % 5; j < n; ++j)
+        msg.add_c((i + j) % 256);
+    if(i % 2)
+        msg.set_s("thread");
+    return msg;
+}
+
+// adds and removes a codec (that nothing uses) until `done`
+// never matches the message's sizes, so is never used in place of the default codecs
+class UnusedGeneratedCodec : public dccl::GeneratedMessageCodec
+{
+    bool encode(dccl::BitWriter* writer, const google::protobuf::Message& msg, dccl::MessagePart part) { return false; }
+    bool size(unsigned* bit_size, const google::protobuf::Message& msg, dccl::MessagePart part) { return false; }
+    bool decode(dccl::Bitset* bits, google::protobuf::Message* msg, dccl::MessagePart part) { return false; }
+    unsigned max_size(dccl::MessagePart part) { return 0; }
+    unsigned min_size(dccl::MessagePart part) { return 0; }
+};
+
+void churn_codecs(std::atomic<bool>* done, int* changes)
+{
+    *changes = 0;
+    while(!done->load())
+    {
+        dccl::FieldCodecManager::add<dccl::test::ReentrantCodec>("unused_codec");
+        dccl::FieldCodecManager::remove<dccl::test::ReentrantCodec>("unused_codec");
+        dccl::Codec::add_generated_codec("dccl.test.Inner", boost::shared_ptr<dccl::GeneratedMessageCodec>(new UnusedGeneratedCodec));
+        dccl::Codec::remove_generated_codec("dccl.test.Inner");
+        ++*changes;
+    }
+}
+
+void encode_decode(dccl::Codec* codec, int first, int count, bool* ok)
+{
+    *ok = true;
+    // loading looks up the generated codecs
+    codec->load<Inner>();
+    for(int i = first, end = first + count; i < end; ++i)
+    {
+        Outer msg_in = make_outer(i);
+        std::string bytes;
+        codec->encode(&bytes, msg_in);
+        Outer msg_out;
+        codec->decode(bytes, &msg_out);
+        if(msg_in.SerializeAsString() != msg_out.SerializeAsString())
+            *ok = false;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::FieldCodecManager::add<dccl::test::ReentrantCodec>("reentrant_codec");
+
+    dccl::Codec inner;
+    inner.load<Inner>();
+    inner_codec = &inner;
+    
+    // nested calls on one thread
+    {
+        dccl::Codec codec;
+        codec.load<Outer>();
+
+        bool ok = false;
+        encode_decode(&codec, 0, 10, &ok);
+        assert(ok);
+    }
+
+    // separate codecs on separate threads, while the codecs registered with FieldCodecManager (and the generated codecs) change
+    {
+        const int num_threads = 4;
+        const int count = 2000;
+        std::vector<dccl::Codec*> codecs;
+        for(int t = 0; t < num_threads; ++t)
+        {
+            codecs.push_back(new dccl::Codec);
+            codecs.back()->load<Outer>();
+        }
+
+        std::atomic<bool> done(false);
+        int changes = 0;
+        std::thread churn(churn_codecs, &done, &changes);
+        
+        bool ok[num_threads];
+        std::vector<std::thread> threads;
+        for(int t = 0; t < num_threads; ++t)
+            threads.push_back(std::thread(encode_decode, codecs[t], t*count, count, &ok[t]));
+
+        for(int t = 0; t < num_threads; ++t)
+        {
+            threads[t].join();
+            assert(ok[t]);
+            delete codecs[t];
+        }
+
+        done = true;
+        churn.join();
+        std::cout << "registry changed " << changes << " times while encoding and decoding" << std::endl;
+    }
+    
+    std::cout << "all tests passed" << std::endl;
+}
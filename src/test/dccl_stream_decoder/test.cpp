@@ -0,0 +1,236 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests decoding messages encoded back to back from a buffer, a std::istream and a file descriptor
+
+#include <cassert>
+#include <deque>
+#include <list>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "dccl/stream_decoder.h"
+#include "test.pb.h"
+using namespace dccl::test;
+
+typedef boost::shared_ptr<google::protobuf::Message> MessagePtr;
+
+MessagePtr make_message(int i)
+{
+    if(i % 2)
+    {
+        boost::shared_ptr<Fixed> msg(new Fixed);
+        msg->set_a(i);
+        return msg;
+    }
+    else
+    {
+        boost::shared_ptr<Variable> msg(new Variable);
+        msg->set_a(i);
+        for(int j = 0, n = i % 41; j < n; ++j)
+            msg->add_b((i + j) % 256);
+        if(i % 3)
+            msg->set_s(std::string(i % 40 + 1, 'x'));
+        return msg;
+    }
+}
+
+// checks that `decoder` gives back all of `msgs`
+void check_decoder(dccl::StreamDecoder* decoder, const std::vector<MessagePtr>& msgs, std::size_t total_bytes)
+{
+    for(int i = 0, n = msgs.size(); i < n; ++i)
+    {
+        assert(!decoder->at_end());
+        MessagePtr msg = decoder->next<MessagePtr>();
+        assert(msg);
+        assert(msg->SerializeAsString() == msgs[i]->SerializeAsString());
+    }
+    assert(decoder->at_end());
+    MessagePtr past_end = decoder->next<MessagePtr>();
+    assert(!past_end);
+    assert(decoder->position() == total_bytes);
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::Codec codec;
+    codec.load<Fixed>();
+    codec.load<Variable>();
+
+    std::vector<MessagePtr> msgs;
+    std::string bytes;
+    // where each message begins
+    std::vector<std::size_t> offsets;
+    for(int i = 0; i < 20000; ++i)
+    {
+        msgs.push_back(make_message(i));
+        std::string encoded;
+        codec.encode(&encoded, *msgs.back());
+        offsets.push_back(bytes.size());
+        bytes += encoded;
+    }
+
+    // contiguous buffer
+    {
+        dccl::StreamDecoder decoder(&codec, bytes.data(), bytes.data() + bytes.size());
+        check_decoder(&decoder, msgs, bytes.size());
+    }
+
+    // known types
+    {
+        dccl::StreamDecoder decoder(&codec, bytes.data(), bytes.data() + bytes.size());
+        Fixed fixed;
+        Variable variable;
+        bool decoded = decoder.next(&variable);
+        assert(decoded);
+        assert(variable.SerializeAsString() == msgs[0]->SerializeAsString());
+        decoded = decoder.next(&fixed);
+        assert(decoded);
+        assert(fixed.SerializeAsString() == msgs[1]->SerializeAsString());
+    }
+    
+    // empty buffer
+    {
+        dccl::StreamDecoder decoder(&codec, bytes.data(), bytes.data());
+        Fixed fixed;
+        assert(decoder.at_end());
+        bool decoded = decoder.next(&fixed);
+        assert(!decoded);
+    }
+    
+    // stream
+    {
+        std::istringstream is(bytes);
+        dccl::StreamDecoder decoder(&codec, &is);
+        check_decoder(&decoder, msgs, bytes.size());
+    }
+
+    // file descriptor, written to a few bytes at a time
+    {
+        int fds[2];
+        int result = pipe(fds);
+        assert(result == 0);
+        std::thread writer([&]()
+            {
+                for(std::size_t i = 0; i < bytes.size(); i += 1000)
+                {
+                    std::size_t n = std::min<std::size_t>(1000, bytes.size() - i);
+                    ssize_t written = write(fds[1], bytes.data() + i, n);
+                    assert(written == static_cast<ssize_t>(n));
+                }
+                close(fds[1]);
+            });
+        
+        dccl::StreamDecoder decoder(&codec, fds[0]);
+        check_decoder(&decoder, msgs, bytes.size());
+        writer.join();
+        close(fds[0]);
+    }
+
+    // an unloaded message does not move the cursor
+    {
+        std::string unknown(1, static_cast<char>(125 << 1));
+        dccl::StreamDecoder decoder(&codec, unknown.data(), unknown.data() + unknown.size());
+        try
+        {
+            decoder.next<MessagePtr>();
+            assert(false);
+        }
+        catch(dccl::Exception& e)
+        {
+            assert(decoder.position() == 0);
+        }
+    }
+
+    // skipping past a corrupt message to the ones after it
+    {
+        std::string corrupt = std::string(1, static_cast<char>(125 << 1)) + bytes.substr(0, offsets[2]);
+        dccl::StreamDecoder decoder(&codec, corrupt.data(), corrupt.data() + corrupt.size());
+        try
+        {
+            decoder.next<google::protobuf::Message*>();
+            assert(false);
+        }
+        catch(dccl::Exception& e)
+        { }
+        assert(decoder.skip(1) == 1);
+        boost::scoped_ptr<google::protobuf::Message> msg(decoder.next<google::protobuf::Message*>());
+        assert(msg->SerializeAsString() == msgs[0]->SerializeAsString());
+        // only as far as the end
+        assert(decoder.skip(corrupt.size()) == offsets[2] - offsets[1]);
+        assert(decoder.at_end());
+    }
+
+    // skipping further than is buffered from a stream
+    {
+        std::istringstream is(bytes);
+        dccl::StreamDecoder decoder(&codec, &is);
+        assert(decoder.skip(offsets[15000]) == offsets[15000]);
+        MessagePtr msg = decoder.next<MessagePtr>();
+        assert(msg->SerializeAsString() == msgs[15000]->SerializeAsString());
+    }
+    
+    // the Codec's own decoding of back to back messages
+    {
+        std::string remaining = bytes.substr(0, offsets[50]);
+        for(int i = 0; i < 50; ++i)
+        {
+            MessagePtr msg = codec.decode<MessagePtr>(&remaining);
+            assert(msg->SerializeAsString() == msgs[i]->SerializeAsString());
+        }
+        assert(remaining.empty());
+        
+        remaining = bytes.substr(0, offsets[50]);
+        Variable variable;
+        codec.decode(&remaining, &variable);
+        assert(remaining == bytes.substr(offsets[1], offsets[50] - offsets[1]));
+    }
+    
+    // iterators over storage that is not contiguous
+    {
+        std::deque<char> deque_bytes(bytes.begin(), bytes.begin() + offsets[50]);
+        std::list<char> list_bytes(deque_bytes.begin(), deque_bytes.end());
+        assert(codec.id(deque_bytes.begin(), deque_bytes.end()) == codec.id<Variable>());
+        assert(codec.id(list_bytes.begin(), list_bytes.end()) == codec.id<Variable>());
+
+        std::deque<char>::iterator deque_it = deque_bytes.begin();
+        std::list<char>::const_iterator list_it = list_bytes.begin();
+        for(int i = 0; i < 50; ++i)
+        {
+            Fixed fixed;
+            Variable variable;
+            google::protobuf::Message* msg = (i % 2) ? static_cast<google::protobuf::Message*>(&fixed) : &variable;
+            deque_it = codec.decode(deque_it, deque_bytes.end(), msg);
+            assert(msg->SerializeAsString() == msgs[i]->SerializeAsString());
+            msg->Clear();
+            list_it = codec.decode(list_it, list_bytes.cend(), msg);
+            assert(msg->SerializeAsString() == msgs[i]->SerializeAsString());
+        }
+        assert(deque_it == deque_bytes.end());
+        assert(list_it == list_bytes.cend());
+    }
+    
+    std::cout << "all tests passed" << std::endl;
+}
@@ -0,0 +1,156 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests writing to dlog from several threads at once (directly and through the background thread), and removing statements at compile time
+
+// DEBUG2 and DEBUG3 statements are compiled out
+#define DCCL_LOG_LEVEL DEBUG1
+
+#include <cassert>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "dccl/logger.h"
+
+/// asserts false if called - used for testing proper short-circuiting of logger calls
+inline std::ostream& stream_assert(std::ostream & os)
+{
+    bool failed_to_short_circuit_logging_statement = false;
+    assert(failed_to_short_circuit_logging_statement);
+    return os;
+}
+
+std::mutex lines_mutex;
+std::vector<std::string> lines;
+std::thread::id slot_thread;
+
+void collect(const std::string& log_message,
+             dccl::logger::Verbosity verbosity,
+             dccl::logger::Group group)
+{
+    std::lock_guard<std::mutex> lock(lines_mutex);
+    lines.push_back(log_message);
+    slot_thread = std::this_thread::get_id();
+}
+
+const int num_threads = 4;
+const int num_lines = 2000;
+
+void write_lines(int thread)
+{
+    using dccl::dlog;
+    using namespace dccl::logger;
+    for(int i = 0; i < num_lines; ++i)
+    {
+        // written in several pieces, so the threads' pieces would interleave if they shared a buffer
+        dlog.is(DEBUG1, ENCODE) && dlog << "thread " << thread << " line " << i << std::endl;
+        dlog.is(DEBUG3) && dlog << stream_assert << std::endl;
+    }
+}
+
+// checks that each thread's lines were all received whole and in order
+void check_lines()
+{
+    std::map<int, int> next_line;
+    for(int i = 0, n = lines.size(); i < n; ++i)
+    {
+        std::istringstream ss(lines[i]);
+        std::string thread_word, line_word;
+        int thread = -1, line = -1;
+        ss >> thread_word >> thread >> line_word >> line;
+        assert(thread_word == "thread" && line_word == "line");
+        assert(line == next_line[thread]);
+        ++next_line[thread];
+    }
+    assert(next_line.size() == num_threads);
+    for(int t = 0; t < num_threads; ++t)
+        assert(next_line[t] == num_lines);
+}
+
+void run_threads()
+{
+    std::vector<std::thread> threads;
+    for(int t = 0; t < num_threads; ++t)
+        threads.push_back(std::thread(write_lines, t));
+    for(int t = 0; t < num_threads; ++t)
+        threads[t].join();
+}
+
+int main(int argc, char* argv[])
+{
+    using dccl::dlog;
+    using namespace dccl::logger;
+
+    dlog.connect(ALL, &collect);
+
+    // compiled out, even though connected
+    dlog.is(DEBUG3) && dlog << stream_assert << std::endl;
+    dlog.is(DEBUG2) && dlog << stream_assert << std::endl;
+    dlog.is(DEBUG1) && dlog << "debug1 ok" << std::endl;
+    assert(lines.size() == 1 && lines[0] == "debug1 ok");
+    lines.clear();
+
+    // a line is only passed on once complete
+    dlog.is(INFO) && dlog << "first half, ";
+    assert(lines.empty());
+    dlog.is(INFO) && dlog << "second half" << std::endl;
+    assert(lines.size() == 1 && lines[0] == "first half, second half");
+    lines.clear();
+    
+    // slots are called by the writing threads
+    run_threads();
+    check_lines();
+    lines.clear();
+
+    // slots are called by the background thread
+    dlog.start_async();
+    run_threads();
+    dlog.stop_async();
+    check_lines();
+    assert(slot_thread != std::this_thread::get_id());
+    lines.clear();
+
+    // switching to and from the background thread while the threads write: stop_async() passes on every queued line before returning, so none are out of order
+    {
+        std::thread writers(run_threads);
+        for(int i = 0; i < 200; ++i)
+        {
+            dlog.start_async();
+            std::this_thread::yield();
+            dlog.stop_async();
+        }
+        writers.join();
+        check_lines();
+        lines.clear();
+    }
+    
+    // and by the writing thread again
+    dlog.is(WARN) && dlog << "sync again" << std::endl;
+    assert(lines.size() == 1 && slot_thread == std::this_thread::get_id());
+    
+    dlog.disconnect(ALL);
+    dlog.is(WARN) && dlog << stream_assert << std::endl;
+    
+    std::cout << "All tests passed." << std::endl;
+}